@@ -0,0 +1,103 @@
+#include "elfObjectExport.hpp"
+#include "cppCodeGenerator.hpp"
+#include "ostreamScannerMessageReporter.hpp"
+#include "ostreamParserMessageReporter.hpp"
+#include "ostreamIrCompilerMessageReporter.hpp"
+#include "utils/fileIo.hpp"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Compiles expressions into an ELF object file that can be linked into a program.
+// aotCompiler -o <output.o> -s <symbol> [-v <variable>]... [-u <uniform variable>]... [--columns] [--cpp] [--] <source>...
+// Each source is an output of the function. The arguments after -- are sources even if they start with - like "-x".
+// With --cpp a C++ source file using intrinsics is written instead of the object file. See CppCodeGenerator.
+
+static void printUsage() {
+	std::cerr << "usage: aotCompiler -o <output.o> -s <symbol> [-v <variable>]... [-u <uniform variable>]... [--columns] [--cpp] [--] <source>...\n";
+}
+
+int main(int argc, char** argv) {
+	std::string outputPath;
+	std::string symbolName;
+	std::vector<std::string> variableNames;
+	std::vector<bool> variableIsUniform;
+	std::vector<std::string_view> sources;
+	auto inputLayout = InputLayout::BLOCKS;
+	bool outputCpp = false;
+	bool parsingOptions = true;
+
+	for (int i = 1; i < argc; i++) {
+		const std::string_view argument = argv[i];
+		const auto hasValue = i + 1 < argc;
+		if (!parsingOptions) {
+			sources.push_back(argument);
+		} else if (argument == "--") {
+			parsingOptions = false;
+		} else if (argument == "-o" && hasValue) {
+			outputPath = argv[++i];
+		} else if (argument == "-s" && hasValue) {
+			symbolName = argv[++i];
+		} else if ((argument == "-v" || argument == "-u") && hasValue) {
+			variableNames.push_back(argv[++i]);
+			variableIsUniform.push_back(argument == "-u");
+		} else if (argument == "--columns") {
+			inputLayout = InputLayout::COLUMNS;
+		} else if (argument == "--cpp") {
+			outputCpp = true;
+		} else if (argument.starts_with("-")) {
+			printUsage();
+			return EXIT_FAILURE;
+		} else {
+			sources.push_back(argument);
+		}
+	}
+	if (outputPath.empty() || symbolName.empty() || sources.empty()) {
+		printUsage();
+		return EXIT_FAILURE;
+	}
+
+	std::vector<Variable> variables;
+	for (usize i = 0; i < variableNames.size(); i++) {
+		variables.push_back(Variable{ .name = variableNames[i], .isUniform = variableIsUniform[i] });
+	}
+
+	OstreamScannerMessageReporter scannerReporter(std::cerr, std::string_view());
+	OstreamParserMessageReporter parserReporter(std::cerr, std::string_view());
+	OstreamIrCompilerMessageReporter irCompilerReporter(std::cerr, std::string_view());
+	Runtime runtime(scannerReporter, parserReporter, irCompilerReporter);
+
+	// Compiled separately first so the errors are printed with the right source.
+	bool compiled = true;
+	for (const auto& source : sources) {
+		scannerReporter.source = source;
+		parserReporter.source = source;
+		irCompilerReporter.source = source;
+		compiled &= runtime.compileToIr(source, variables).has_value();
+	}
+	if (!compiled) {
+		return EXIT_FAILURE;
+	}
+
+	if (outputCpp) {
+		const auto irCode = runtime.compileToIr(sources, variables);
+		std::ofstream file(outputPath);
+		if (irCode.has_value()) {
+			CppCodeGenerator codeGenerator;
+			codeGenerator.compile(file, *irCode, runtime.functions, variables, symbolName, inputLayout);
+		}
+		if (!irCode.has_value() || !file.good()) {
+			std::cerr << "failed to write " << outputPath << '\n';
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
+	const auto object = compileToElfObject(runtime, sources, variables, symbolName, inputLayout);
+	if (!object.has_value() || !outputToFile(outputPath.c_str(), *object)) {
+		std::cerr << "failed to write " << outputPath << '\n';
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -1,5 +1,6 @@
 #include "assemblyCode.hpp"
 #include "utils/overloaded.hpp"
+#include <bit>
 
 void AssemblyCode::reset() {
 	nextInstructionLabel = std::nullopt;
@@ -32,6 +33,10 @@ void AssemblyCode::cmp(Reg64 lhs, Reg64 rhs, i64 offset) {
 	insert(CmpR64R64{ .lhs = lhs, .rhs = rhs }, offset);
 }
 
+void AssemblyCode::cmp(Reg64 lhs, u32 rhs, i64 offset) {
+	insert(CmpR64Imm{ .lhs = lhs, .rhs = rhs }, offset);
+}
+
 void AssemblyCode::xor_(Reg64 lhs, Reg64 rhs, i64 offset) {
 	insert(XorR64R64{ .lhs = lhs, .rhs = rhs }, offset);
 }
@@ -48,6 +53,18 @@ void AssemblyCode::sub(Reg64 lhs, u32 rhs, i64 offset) {
 	insert(SubR64Imm{ .lhs = lhs, .rhs = rhs }, offset);
 }
 
+void AssemblyCode::add(Reg64 lhs, Reg64 rhs, i64 offset) {
+	insert(AddR64R64{ .lhs = lhs, .rhs = rhs }, offset);
+}
+
+void AssemblyCode::sub(Reg64 lhs, Reg64 rhs, i64 offset) {
+	insert(SubR64R64{ .lhs = lhs, .rhs = rhs }, offset);
+}
+
+void AssemblyCode::shl(Reg64 lhs, u8 rhs, i64 offset) {
+	insert(ShlR64Imm{ .lhs = lhs, .rhs = rhs }, offset);
+}
+
 void AssemblyCode::inc(Reg64 reg, i64 offset) {
 	insert(Inc64{ .reg = reg }, offset);
 }
@@ -64,6 +81,22 @@ void AssemblyCode::vmovaps(Reg64 destinationAddressReg, i32 addressOffset, RegYm
 	insert(VmovapsMemYmm{ .destinationAddressReg = destinationAddressReg, .addressOffset = addressOffset, .source = source }, offset);
 }
 
+void AssemblyCode::vmovups(RegYmm destiation, Reg64 sourceAddressReg, i32 addressOffset, i64 offset) {
+	insert(VmovupsYmmMem{ .destination = destiation, .sourceAddressReg = sourceAddressReg, .addressOffset = addressOffset }, offset);
+}
+
+void AssemblyCode::vmovups(Reg64 destinationAddressReg, i32 addressOffset, RegYmm source, i64 offset) {
+	insert(VmovupsMemYmm{ .destinationAddressReg = destinationAddressReg, .addressOffset = addressOffset, .source = source }, offset);
+}
+
+void AssemblyCode::vmaskmovps(RegYmm destiation, RegYmm mask, Reg64 sourceAddressReg, i32 addressOffset, i64 offset) {
+	insert(VmaskmovpsYmmMem{ .destination = destiation, .mask = mask, .sourceAddressReg = sourceAddressReg, .addressOffset = addressOffset }, offset);
+}
+
+void AssemblyCode::vmaskmovps(Reg64 destinationAddressReg, i32 addressOffset, RegYmm mask, RegYmm source, i64 offset) {
+	insert(VmaskmovpsMemYmm{ .destinationAddressReg = destinationAddressReg, .addressOffset = addressOffset, .mask = mask, .source = source }, offset);
+}
+
 void AssemblyCode::vaddps(RegYmm destination, RegYmm lhs, RegYmm rhs, i64 offset) {
 	insert(VaddpsYmmYmmYmm{ .destination = destination, .lhs = lhs, .rhs = rhs }, OFFSET_LAST);
 }
@@ -80,10 +113,50 @@ void AssemblyCode::vdivps(RegYmm destination, RegYmm lhs, RegYmm rhs, i64 offset
 	insert(VdivpsYmmYmmYmm{ .destination = destination, .lhs = lhs, .rhs = rhs }, OFFSET_LAST);
 }
 
+void AssemblyCode::vaddpd(RegYmm destination, RegYmm lhs, RegYmm rhs, i64 offset) {
+	insert(VaddpdYmmYmmYmm{ .destination = destination, .lhs = lhs, .rhs = rhs }, offset);
+}
+
+void AssemblyCode::vsubpd(RegYmm destination, RegYmm lhs, RegYmm rhs, i64 offset) {
+	insert(VsubpdYmmYmmYmm{ .destination = destination, .lhs = lhs, .rhs = rhs }, offset);
+}
+
+void AssemblyCode::vmulpd(RegYmm destination, RegYmm lhs, RegYmm rhs, i64 offset) {
+	insert(VmulpdYmmYmmYmm{ .destination = destination, .lhs = lhs, .rhs = rhs }, offset);
+}
+
+void AssemblyCode::vdivpd(RegYmm destination, RegYmm lhs, RegYmm rhs, i64 offset) {
+	insert(VdivpdYmmYmmYmm{ .destination = destination, .lhs = lhs, .rhs = rhs }, offset);
+}
+
 void AssemblyCode::vxorps(RegYmm destination, RegYmm lhs, RegYmm rhs, i64 offset) {
 	insert(VxorpsYmmYmmYmm{ .destination = destination, .lhs = lhs, .rhs = rhs }, OFFSET_LAST);
 }
 
+void AssemblyCode::vandps(RegYmm destination, RegYmm lhs, RegYmm rhs, i64 offset) {
+	insert(VandpsYmmYmmYmm{ .destination = destination, .lhs = lhs, .rhs = rhs }, offset);
+}
+
+void AssemblyCode::vminps(RegYmm destination, RegYmm lhs, RegYmm rhs, i64 offset) {
+	insert(VminpsYmmYmmYmm{ .destination = destination, .lhs = lhs, .rhs = rhs }, offset);
+}
+
+void AssemblyCode::vmaxps(RegYmm destination, RegYmm lhs, RegYmm rhs, i64 offset) {
+	insert(VmaxpsYmmYmmYmm{ .destination = destination, .lhs = lhs, .rhs = rhs }, offset);
+}
+
+void AssemblyCode::vcmpps(RegYmm destination, RegYmm lhs, RegYmm rhs, CmpPredicate predicate, i64 offset) {
+	insert(VcmppsYmmYmmYmm{ .destination = destination, .lhs = lhs, .rhs = rhs, .predicate = predicate }, offset);
+}
+
+void AssemblyCode::vblendvps(RegYmm destination, RegYmm lhs, RegYmm rhs, RegYmm mask, i64 offset) {
+	insert(VblendvpsYmmYmmYmmYmm{ .destination = destination, .lhs = lhs, .rhs = rhs, .mask = mask }, offset);
+}
+
+void AssemblyCode::vpaddd(RegYmm destination, RegYmm lhs, RegYmm rhs, i64 offset) {
+	insert(VpadddYmmYmmYmm{ .destination = destination, .lhs = lhs, .rhs = rhs }, offset);
+}
+
 void AssemblyCode::jmp(InstructionLabel label, i64 offset) {
 	insert(JmpLbl{ .type = JmpType::UNCONDITONAL, .label = label }, offset);
 }
@@ -92,6 +165,14 @@ void AssemblyCode::jl(InstructionLabel label, i64 offset) {
 	insert(JmpLbl{ .type = JmpType::SIGNED_LESS, .label = label }, offset);
 }
 
+void AssemblyCode::jle(InstructionLabel label, i64 offset) {
+	insert(JmpLbl{ .type = JmpType::SIGNED_LESS_OR_EQUAL, .label = label }, offset);
+}
+
+void AssemblyCode::jge(InstructionLabel label, i64 offset) {
+	insert(JmpLbl{ .type = JmpType::SIGNED_GREATER_OR_EQUAL, .label = label }, offset);
+}
+
 void AssemblyCode::mov(Reg64 destination, Reg64 source, i64 offset) {
 	insert(MovR64R64{ .destination = destination, .source = source }, offset);
 }
@@ -100,10 +181,90 @@ void AssemblyCode::mov(Reg64 destination, u64 immediate, i64 offset) {
 	insert(MovR64Imm64{ .destination = destination, .immediate = immediate }, offset);
 }
 
+void AssemblyCode::movFunctionAddress(Reg64 destination, u64 address, i64 functionIndex, i64 offset) {
+	insert(MovR64Imm64{ .destination = destination, .immediate = address, .functionIndex = functionIndex }, offset);
+}
+
+void AssemblyCode::movFromMemory(Reg64 destination, Reg64 sourceAddressReg, i32 addressOffset, i64 offset) {
+	insert(MovR64Mem{ .destination = destination, .sourceAddressReg = sourceAddressReg, .addressOffset = addressOffset }, offset);
+}
+
+void AssemblyCode::vbroadcastss(RegYmm destination, Reg64 sourceAddressReg, i32 addressOffset, i64 offset) {
+	insert(VbroadcastssYmmMem{ .destination = destination, .sourceAddressReg = sourceAddressReg, .addressOffset = addressOffset }, offset);
+}
+
+void AssemblyCode::lea(Reg64 destination, DataLabel source, i64 offset) {
+	insert(LeaR64Lbl{ .destination = destination, .source = source }, offset);
+}
+
+void AssemblyCode::lea(Reg64 destination, Reg64 base, Reg64 index, u8 scale, i64 offset) {
+	insert(LeaR64Sib{ .destination = destination, .base = base, .index = index, .scale = scale }, offset);
+}
+
 void AssemblyCode::vbroadcastss(RegYmm destination, DataLabel source, i64 offset) {
 	insert(VbroadcastssLbl{ .destination = destination, .source = source }, offset);
 }
 
+void AssemblyCode::vbroadcastsd(RegYmm destination, DataLabel source, i64 offset) {
+	insert(VbroadcastsdLbl{ .destination = destination, .source = source }, offset);
+}
+
+void AssemblyCode::vbroadcastsd(RegYmm destination, Reg64 sourceAddressReg, i32 addressOffset, i64 offset) {
+	insert(VbroadcastsdYmmMem{ .destination = destination, .sourceAddressReg = sourceAddressReg, .addressOffset = addressOffset }, offset);
+}
+
+void AssemblyCode::vcvtdq2ps(RegYmm destination, RegYmm source, i64 offset) {
+	insert(Vcvtdq2psYmmYmm{ .destination = destination, .source = source }, offset);
+}
+
+void AssemblyCode::vcvtps2dq(RegYmm destination, RegYmm source, i64 offset) {
+	insert(Vcvtps2dqYmmYmm{ .destination = destination, .source = source }, offset);
+}
+
+void AssemblyCode::vpmovzxbd(RegYmm destination, Reg64 sourceAddressReg, i32 addressOffset, i64 offset) {
+	insert(VpmovzxbdYmmMem{ .destination = destination, .sourceAddressReg = sourceAddressReg, .addressOffset = addressOffset }, offset);
+}
+
+void AssemblyCode::vcvtph2ps(RegYmm destination, Reg64 sourceAddressReg, i32 addressOffset, i64 offset) {
+	insert(Vcvtph2psYmmMem{ .destination = destination, .sourceAddressReg = sourceAddressReg, .addressOffset = addressOffset }, offset);
+}
+
+void AssemblyCode::vcvtps2ph(Reg64 destinationAddressReg, i32 addressOffset, RegYmm source, i64 offset) {
+	insert(Vcvtps2phMemYmm{ .destinationAddressReg = destinationAddressReg, .addressOffset = addressOffset, .source = source }, offset);
+}
+
+void AssemblyCode::vcvtpd2ps(RegYmm destination, Reg64 sourceAddressReg, i32 addressOffset, i64 offset) {
+	insert(Vcvtpd2psXmmMem{ .destination = destination, .sourceAddressReg = sourceAddressReg, .addressOffset = addressOffset }, offset);
+}
+
+void AssemblyCode::vcvtps2pd(RegYmm destination, RegYmm source, i64 offset) {
+	insert(Vcvtps2pdYmmXmm{ .destination = destination, .source = source }, offset);
+}
+
+void AssemblyCode::vinsertf128(RegYmm destination, RegYmm lhs, RegYmm rhs, u8 index, i64 offset) {
+	insert(Vinsertf128YmmYmmXmm{ .destination = destination, .lhs = lhs, .rhs = rhs, .index = index }, offset);
+}
+
+void AssemblyCode::vextractf128(RegYmm destination, RegYmm source, u8 index, i64 offset) {
+	insert(Vextractf128XmmYmm{ .destination = destination, .source = source, .index = index }, offset);
+}
+
+void AssemblyCode::vpackusdw(RegYmm destination, RegYmm lhs, RegYmm rhs, i64 offset) {
+	insert(VpackusdwYmmYmmYmm{ .destination = destination, .lhs = lhs, .rhs = rhs }, offset);
+}
+
+void AssemblyCode::vpermq(RegYmm destination, RegYmm source, u8 selector, i64 offset) {
+	insert(VpermqYmmYmmImm{ .destination = destination, .source = source, .selector = selector }, offset);
+}
+
+void AssemblyCode::vpackuswb(RegYmm destination, RegYmm lhs, RegYmm rhs, i64 offset) {
+	insert(VpackuswbXmmXmmXmm{ .destination = destination, .lhs = lhs, .rhs = rhs }, offset);
+}
+
+void AssemblyCode::vmovq(Reg64 destinationAddressReg, i32 addressOffset, RegYmm source, i64 offset) {
+	insert(VmovqMemXmm{ .destinationAddressReg = destinationAddressReg, .addressOffset = addressOffset, .source = source }, offset);
+}
+
 void AssemblyCode::vzeroupper(i64 offset) {
 	insert(Vzeroupper{}, offset);
 }
@@ -137,6 +298,21 @@ DataLabel AssemblyCode::allocateData(float value) {
 	return label;
 }
 
+DataLabel AssemblyCode::allocateData(std::span<const float> values) {
+	const DataLabel label = i32(dataEntries.size());
+	for (const auto value : values) {
+		dataEntries.push_back(DataEntry{ .value = value });
+	}
+	return label;
+}
+
+DataLabel AssemblyCode::allocateData(double value) {
+	// Little endian so the low half goes first.
+	const auto bits = std::bit_cast<u64>(value);
+	const float halves[] = { std::bit_cast<float>(u32(bits)), std::bit_cast<float>(u32(bits >> 32)) };
+	return allocateData(halves);
+}
+
 u8 regIndex(Reg64 reg) {
 	return u8(reg);
 }
@@ -3,6 +3,7 @@
 #include "assemblyInstruction.hpp"
 #include <vector>
 #include <optional>
+#include <span>
 
 struct AssemblyCode {
 	static constexpr i64 OFFSET_LAST = -1;
@@ -18,34 +19,83 @@ struct AssemblyCode {
 	void pop(Reg64 reg, i64 offset = OFFSET_LAST);
 
 	void cmp(Reg64 lhs, Reg64 rhs, i64 offset = OFFSET_LAST);
+	void cmp(Reg64 lhs, u32 rhs, i64 offset = OFFSET_LAST);
 
 	void xor_(Reg64 lhs, Reg64 rhs, i64 offset = OFFSET_LAST);
 	void and_(Reg8 lhs, u8 rhs, i64 offset = OFFSET_LAST);
 
 	void add(Reg64 lhs, u32 rhs, i64 offset = OFFSET_LAST);
+	void add(Reg64 lhs, Reg64 rhs, i64 offset = OFFSET_LAST);
 	void sub(Reg64 lhs, u32 rhs, i64 offset = OFFSET_LAST);
+	void sub(Reg64 lhs, Reg64 rhs, i64 offset = OFFSET_LAST);
+
+	void shl(Reg64 lhs, u8 rhs, i64 offset = OFFSET_LAST);
 
 	void inc(Reg64 reg, i64 offset = OFFSET_LAST);
 
 	void mov(Reg64 destination, Reg64 source, i64 offset = OFFSET_LAST);
 	void mov(Reg64 destination, u64 immediate, i64 offset = OFFSET_LAST);
+	void movFunctionAddress(Reg64 destination, u64 address, i64 functionIndex, i64 offset = OFFSET_LAST);
+	// mov destination, [sourceAddressReg + addressOffset]
+	void movFromMemory(Reg64 destination, Reg64 sourceAddressReg, i32 addressOffset, i64 offset = OFFSET_LAST);
+
+	void lea(Reg64 destination, DataLabel source, i64 offset = OFFSET_LAST);
+	// lea destination, [base + index * scale]
+	void lea(Reg64 destination, Reg64 base, Reg64 index, u8 scale, i64 offset = OFFSET_LAST);
 
 	void vbroadcastss(RegYmm destination, DataLabel source, i64 offset = OFFSET_LAST);
+	void vbroadcastss(RegYmm destination, Reg64 sourceAddressReg, i32 addressOffset, i64 offset = OFFSET_LAST);
+
+	void vbroadcastsd(RegYmm destination, DataLabel source, i64 offset = OFFSET_LAST);
+	void vbroadcastsd(RegYmm destination, Reg64 sourceAddressReg, i32 addressOffset, i64 offset = OFFSET_LAST);
 
 	void vmovaps(RegYmm destiation, RegYmm source, i64 offset = OFFSET_LAST);
 	void vmovaps(RegYmm destiation, Reg64 sourceAddressReg, i32 addressOffset, i64 offset = OFFSET_LAST);
 	void vmovaps(Reg64 destinationAddressReg, i32 addressOffset, RegYmm source, i64 offset = OFFSET_LAST);
 
+	void vmovups(RegYmm destiation, Reg64 sourceAddressReg, i32 addressOffset, i64 offset = OFFSET_LAST);
+	void vmovups(Reg64 destinationAddressReg, i32 addressOffset, RegYmm source, i64 offset = OFFSET_LAST);
+
+	void vmaskmovps(RegYmm destiation, RegYmm mask, Reg64 sourceAddressReg, i32 addressOffset, i64 offset = OFFSET_LAST);
+	void vmaskmovps(Reg64 destinationAddressReg, i32 addressOffset, RegYmm mask, RegYmm source, i64 offset = OFFSET_LAST);
+
 	void vaddps(RegYmm destination, RegYmm lhs, RegYmm rhs, i64 offset = OFFSET_LAST);
 	void vsubps(RegYmm destination, RegYmm lhs, RegYmm rhs, i64 offset = OFFSET_LAST);
 	void vmulps(RegYmm destination, RegYmm lhs, RegYmm rhs, i64 offset = OFFSET_LAST);
 	void vdivps(RegYmm destination, RegYmm lhs, RegYmm rhs, i64 offset = OFFSET_LAST);
 
+	void vaddpd(RegYmm destination, RegYmm lhs, RegYmm rhs, i64 offset = OFFSET_LAST);
+	void vsubpd(RegYmm destination, RegYmm lhs, RegYmm rhs, i64 offset = OFFSET_LAST);
+	void vmulpd(RegYmm destination, RegYmm lhs, RegYmm rhs, i64 offset = OFFSET_LAST);
+	void vdivpd(RegYmm destination, RegYmm lhs, RegYmm rhs, i64 offset = OFFSET_LAST);
+
 	void vxorps(RegYmm destination, RegYmm lhs, RegYmm rhs, i64 offset = OFFSET_LAST);
+	void vandps(RegYmm destination, RegYmm lhs, RegYmm rhs, i64 offset = OFFSET_LAST);
+	void vminps(RegYmm destination, RegYmm lhs, RegYmm rhs, i64 offset = OFFSET_LAST);
+	void vmaxps(RegYmm destination, RegYmm lhs, RegYmm rhs, i64 offset = OFFSET_LAST);
+	void vcmpps(RegYmm destination, RegYmm lhs, RegYmm rhs, CmpPredicate predicate, i64 offset = OFFSET_LAST);
+	void vblendvps(RegYmm destination, RegYmm lhs, RegYmm rhs, RegYmm mask, i64 offset = OFFSET_LAST);
+	void vpaddd(RegYmm destination, RegYmm lhs, RegYmm rhs, i64 offset = OFFSET_LAST);
+
+	void vcvtdq2ps(RegYmm destination, RegYmm source, i64 offset = OFFSET_LAST);
+	void vcvtps2dq(RegYmm destination, RegYmm source, i64 offset = OFFSET_LAST);
+	void vpmovzxbd(RegYmm destination, Reg64 sourceAddressReg, i32 addressOffset, i64 offset = OFFSET_LAST);
+	void vcvtph2ps(RegYmm destination, Reg64 sourceAddressReg, i32 addressOffset, i64 offset = OFFSET_LAST);
+	void vcvtps2ph(Reg64 destinationAddressReg, i32 addressOffset, RegYmm source, i64 offset = OFFSET_LAST);
+	void vcvtpd2ps(RegYmm destination, Reg64 sourceAddressReg, i32 addressOffset, i64 offset = OFFSET_LAST);
+	void vcvtps2pd(RegYmm destination, RegYmm source, i64 offset = OFFSET_LAST);
+	void vinsertf128(RegYmm destination, RegYmm lhs, RegYmm rhs, u8 index, i64 offset = OFFSET_LAST);
+	void vextractf128(RegYmm destination, RegYmm source, u8 index, i64 offset = OFFSET_LAST);
+	void vpackusdw(RegYmm destination, RegYmm lhs, RegYmm rhs, i64 offset = OFFSET_LAST);
+	void vpermq(RegYmm destination, RegYmm source, u8 selector, i64 offset = OFFSET_LAST);
+	void vpackuswb(RegYmm destination, RegYmm lhs, RegYmm rhs, i64 offset = OFFSET_LAST);
+	void vmovq(Reg64 destinationAddressReg, i32 addressOffset, RegYmm source, i64 offset = OFFSET_LAST);
 
 	void jmp(InstructionLabel label, i64 offset = OFFSET_LAST);
 	// siged less
 	void jl(InstructionLabel label, i64 offset = OFFSET_LAST);
+	void jle(InstructionLabel label, i64 offset = OFFSET_LAST);
+	void jge(InstructionLabel label, i64 offset = OFFSET_LAST);
 
 	void vzeroupper(i64 offset = OFFSET_LAST);
 
@@ -58,6 +108,10 @@ struct AssemblyCode {
 	i32 allocatedLabelsCount = 0;
 
 	DataLabel allocateData(float value);
+	// Consecutively allocated data is placed next to each other in memory.
+	DataLabel allocateData(std::span<const float> values);
+	// Takes up 2 entries.
+	DataLabel allocateData(double value);
 
 	std::vector<LabeledInstruction> instructions;
 
@@ -56,7 +56,9 @@ struct Pop64 {
 
 enum class JmpType {
 	UNCONDITONAL,
-	SIGNED_LESS
+	SIGNED_LESS,
+	SIGNED_LESS_OR_EQUAL,
+	SIGNED_GREATER_OR_EQUAL,
 };
 
 struct JmpLbl {
@@ -79,11 +81,26 @@ struct AddR64Imm {
 	u32 rhs;
 };
 
+struct AddR64R64 {
+	Reg64 lhs;
+	Reg64 rhs;
+};
+
 struct SubR64Imm {
 	Reg64 lhs;
 	u32 rhs;
 };
 
+struct SubR64R64 {
+	Reg64 lhs;
+	Reg64 rhs;
+};
+
+struct ShlR64Imm {
+	Reg64 lhs;
+	u8 rhs;
+};
+
 struct Inc64 {
 	Reg64 reg;
 };
@@ -93,14 +110,41 @@ struct CmpR64R64 {
 	Reg64 rhs;
 };
 
+struct CmpR64Imm {
+	Reg64 lhs;
+	u32 rhs;
+};
+
 struct MovR64R64 {
 	Reg64 destination;
 	Reg64 source;
 };
 
+struct MovR64Mem {
+	Reg64 destination;
+	Reg64 sourceAddressReg;
+	i32 addressOffset;
+};
+
 struct MovR64Imm64 {
 	Reg64 destination;
 	u64 immediate;
+	// If the immediate is the address of a function this is its index in the function table, so the code can be relocated. Otherwise -1.
+	i64 functionIndex = -1;
+};
+
+// Loads the address of the data.
+struct LeaR64Lbl {
+	Reg64 destination;
+	DataLabel source;
+};
+
+// lea destination, [base + index * scale]. The scale is 1, 2, 4 or 8 and the index can't be RSP.
+struct LeaR64Sib {
+	Reg64 destination;
+	Reg64 base;
+	Reg64 index;
+	u8 scale;
 };
 
 // https://stackoverflow.com/questions/10665547/how-to-load-a-single-32-bit-floating-point-into-all-eight-positions-within-an-av
@@ -109,6 +153,24 @@ struct VbroadcastssLbl {
 	DataLabel source;
 };
 
+struct VbroadcastssYmmMem {
+	RegYmm destination;
+	Reg64 sourceAddressReg;
+	i32 addressOffset;
+};
+
+// Broadcasts a 64-bit double into the 4 elements.
+struct VbroadcastsdLbl {
+	RegYmm destination;
+	DataLabel source;
+};
+
+struct VbroadcastsdYmmMem {
+	RegYmm destination;
+	Reg64 sourceAddressReg;
+	i32 addressOffset;
+};
+
 struct VmovapsYmmYmm {
 	RegYmm destination;
 	RegYmm source;
@@ -126,6 +188,33 @@ struct VmovapsMemYmm {
 	RegYmm source;
 };
 
+struct VmovupsYmmMem {
+	RegYmm destination;
+	Reg64 sourceAddressReg;
+	i32 addressOffset;
+};
+
+struct VmovupsMemYmm {
+	Reg64 destinationAddressReg;
+	i32 addressOffset;
+	RegYmm source;
+};
+
+// Only loads the elements that have the highest bit of the mask element set. The rest are zeroed. Memory that isn't loaded isn't accessed so it doesn't cause faults.
+struct VmaskmovpsYmmMem {
+	RegYmm destination;
+	RegYmm mask;
+	Reg64 sourceAddressReg;
+	i32 addressOffset;
+};
+
+struct VmaskmovpsMemYmm {
+	Reg64 destinationAddressReg;
+	i32 addressOffset;
+	RegYmm mask;
+	RegYmm source;
+};
+
 struct VaddpsYmmYmmYmm {
 	RegYmm destination;
 	RegYmm lhs;
@@ -150,12 +239,172 @@ struct VdivpsYmmYmmYmm {
 	RegYmm rhs;
 };
 
+struct VaddpdYmmYmmYmm {
+	RegYmm destination;
+	RegYmm lhs;
+	RegYmm rhs;
+};
+
+struct VsubpdYmmYmmYmm {
+	RegYmm destination;
+	RegYmm lhs;
+	RegYmm rhs;
+};
+
+struct VmulpdYmmYmmYmm {
+	RegYmm destination;
+	RegYmm lhs;
+	RegYmm rhs;
+};
+
+struct VdivpdYmmYmmYmm {
+	RegYmm destination;
+	RegYmm lhs;
+	RegYmm rhs;
+};
+
 struct VxorpsYmmYmmYmm {
 	RegYmm destination;
 	RegYmm lhs;
 	RegYmm rhs;
 };
 
+struct VandpsYmmYmmYmm {
+	RegYmm destination;
+	RegYmm lhs;
+	RegYmm rhs;
+};
+
+// If only one of the operands is NaN then rhs is returned.
+struct VminpsYmmYmmYmm {
+	RegYmm destination;
+	RegYmm lhs;
+	RegYmm rhs;
+};
+
+struct VmaxpsYmmYmmYmm {
+	RegYmm destination;
+	RegYmm lhs;
+	RegYmm rhs;
+};
+
+enum class CmpPredicate : u8 {
+	// Ordered and non signaling so comparisons with NaN are false.
+	LESS = 0x11,
+	GREATER = 0x1E,
+	// True if neither of the operands is NaN.
+	ORDERED = 0x07,
+};
+
+struct VcmppsYmmYmmYmm {
+	RegYmm destination;
+	RegYmm lhs;
+	RegYmm rhs;
+	CmpPredicate predicate;
+};
+
+// Selects rhs if the highest bit of the mask element is set and lhs otherwise.
+struct VblendvpsYmmYmmYmmYmm {
+	RegYmm destination;
+	RegYmm lhs;
+	RegYmm rhs;
+	RegYmm mask;
+};
+
+// Adds 32 bit integers.
+struct VpadddYmmYmmYmm {
+	RegYmm destination;
+	RegYmm lhs;
+	RegYmm rhs;
+};
+
+// The conversions used for the columns with element types other than f32. The operands named Xmm are the lower halves of the YMM registers.
+struct Vcvtdq2psYmmYmm {
+	RegYmm destination;
+	RegYmm source;
+};
+
+// Rounds to nearest. NaN and the values outside the range of i32 become INT32_MIN.
+struct Vcvtps2dqYmmYmm {
+	RegYmm destination;
+	RegYmm source;
+};
+
+// Zero extends 8 bytes into 8 dwords.
+struct VpmovzxbdYmmMem {
+	RegYmm destination;
+	Reg64 sourceAddressReg;
+	i32 addressOffset;
+};
+
+// Converts 8 halfs into floats.
+struct Vcvtph2psYmmMem {
+	RegYmm destination;
+	Reg64 sourceAddressReg;
+	i32 addressOffset;
+};
+
+// Converts 8 floats into halfs rounding to nearest.
+struct Vcvtps2phMemYmm {
+	Reg64 destinationAddressReg;
+	i32 addressOffset;
+	RegYmm source;
+};
+
+// Converts 4 doubles into the lower half of the destination and zeroes the upper half.
+struct Vcvtpd2psXmmMem {
+	RegYmm destination;
+	Reg64 sourceAddressReg;
+	i32 addressOffset;
+};
+
+struct Vcvtps2pdYmmXmm {
+	RegYmm destination;
+	RegYmm source;
+};
+
+// Copies lhs into the destination and replaces the half with the index with the lower half of rhs.
+struct Vinsertf128YmmYmmXmm {
+	RegYmm destination;
+	RegYmm lhs;
+	RegYmm rhs;
+	u8 index;
+};
+
+struct Vextractf128XmmYmm {
+	RegYmm destination;
+	RegYmm source;
+	u8 index;
+};
+
+// In each 128 bit lane packs the dwords of lhs followed by the dwords of rhs into words with unsigned saturation.
+struct VpackusdwYmmYmmYmm {
+	RegYmm destination;
+	RegYmm lhs;
+	RegYmm rhs;
+};
+
+// The 2 bit field i of the selector is the index of the qword of the source placed at the position i.
+struct VpermqYmmYmmImm {
+	RegYmm destination;
+	RegYmm source;
+	u8 selector;
+};
+
+// Packs the words of lhs followed by the words of rhs into bytes with unsigned saturation.
+struct VpackuswbXmmXmmXmm {
+	RegYmm destination;
+	RegYmm lhs;
+	RegYmm rhs;
+};
+
+// Stores the lowest qword.
+struct VmovqMemXmm {
+	Reg64 destinationAddressReg;
+	i32 addressOffset;
+	RegYmm source;
+};
+
 struct Vzeroupper {};
 
 using Instruction = std::variant<
@@ -168,20 +417,57 @@ using Instruction = std::variant<
 	XorR64R64,
 	AndR8Imm,
 	AddR64Imm,
+	AddR64R64,
 	SubR64Imm,
+	SubR64R64,
+	ShlR64Imm,
 	Inc64,
 	CmpR64R64,
+	CmpR64Imm,
 	MovR64R64,
+	MovR64Mem,
 	MovR64Imm64,
+	LeaR64Lbl,
+	LeaR64Sib,
 	VbroadcastssLbl,
+	VbroadcastssYmmMem,
+	VbroadcastsdLbl,
+	VbroadcastsdYmmMem,
 	VmovapsYmmYmm,
 	VmovapsYmmMem,
 	VmovapsMemYmm,
+	VmovupsYmmMem,
+	VmovupsMemYmm,
+	VmaskmovpsYmmMem,
+	VmaskmovpsMemYmm,
 	VaddpsYmmYmmYmm,
 	VsubpsYmmYmmYmm,
 	VmulpsYmmYmmYmm,
 	VdivpsYmmYmmYmm,
+	VaddpdYmmYmmYmm,
+	VsubpdYmmYmmYmm,
+	VmulpdYmmYmmYmm,
+	VdivpdYmmYmmYmm,
 	VxorpsYmmYmmYmm,
+	VandpsYmmYmmYmm,
+	VminpsYmmYmmYmm,
+	VmaxpsYmmYmmYmm,
+	VcmppsYmmYmmYmm,
+	VblendvpsYmmYmmYmmYmm,
+	VpadddYmmYmmYmm,
+	Vcvtdq2psYmmYmm,
+	Vcvtps2dqYmmYmm,
+	VpmovzxbdYmmMem,
+	Vcvtph2psYmmMem,
+	Vcvtps2phMemYmm,
+	Vcvtpd2psXmmMem,
+	Vcvtps2pdYmmXmm,
+	Vinsertf128YmmYmmXmm,
+	Vextractf128XmmYmm,
+	VpackusdwYmmYmmYmm,
+	VpermqYmmYmmImm,
+	VpackuswbXmmXmmXmm,
+	VmovqMemXmm,
 	Vzeroupper
 >;
 
@@ -1,6 +1,6 @@
 #include "ast.hpp"
 
-ConstantExpr::ConstantExpr(Real value, i64 start, i64 end)
+ConstantExpr::ConstantExpr(RealConstant value, i64 start, i64 end)
 	: Expr(ExprType::CONSTANT, start, end)
 	, value(value) {}
 
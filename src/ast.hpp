@@ -21,11 +21,13 @@ struct Expr {
 };
 
 using Real = float;
+// The constants are parsed with the highest supported precision and rounded when the code is compiled with a lower one.
+using RealConstant = double;
 
 struct ConstantExpr : public Expr {
-	ConstantExpr(Real value, i64 start, i64 end);
+	ConstantExpr(RealConstant value, i64 start, i64 end);
 
-	Real value;
+	RealConstant value;
 };
 
 enum class BinaryOpType {
@@ -22,6 +22,17 @@ void AstAllocator::reset() {
 	}
 }
 
+i64 AstAllocator::bytesUsed() const {
+	i64 bytes = 0;
+	for (const Block* block = first; block != nullptr; block = block->nextBlock) {
+		bytes += block->nextAvailable - block->data;
+		if (block == current) {
+			break;
+		}
+	}
+	return bytes;
+}
+
 void* AstAllocator::allocate(i64 size, i64 alignment) {
 	if (size > BLOCK_DATA_SIZE) {
 		// TODO: 
@@ -22,6 +22,8 @@ struct AstAllocator {
 	AstAllocator();
 
 	void reset();
+	// Bytes allocated since the last reset including the alignment padding.
+	i64 bytesUsed() const;
 
 	static constexpr i64 BLOCK_DATA_SIZE = 4096;
 	struct Block {
@@ -0,0 +1,102 @@
+#include "asyncCompiler.hpp"
+#include "utils/asserts.hpp"
+
+AsyncFunction::AsyncFunction(Runtime& runtime, std::string_view source, std::vector<IrOp>&& irCode, std::span<const Variable> variables, i64 outputCount)
+	: runtime(runtime)
+	, source(source)
+	, irCode(std::move(irCode))
+	, variables(variables.begin(), variables.end())
+	, outputCount(outputCount)
+	, state(State::PENDING) {}
+
+void AsyncFunction::operator()(const float* input, float* output, i64 elementCount, std::span<const float> uniforms) {
+	if (isCompiled()) {
+		(*compiledFunction)(input, output, elementCount, uniforms);
+		return;
+	}
+	vm.execute(irCode, variables, runtime.functions, input, output, elementCount, uniforms);
+}
+
+void AsyncFunction::operator()(const LoopFunctionArray& input, LoopFunctionArray& output, std::span<const float> uniforms) {
+	if (input.blockCount() != output.blockCount() || output.valuesPerBlock() != outputCount) {
+		ASSERT_NOT_REACHED();
+		return;
+	}
+	operator()(reinterpret_cast<const float*>(input.data()), reinterpret_cast<float*>(output.data()), input.blockCount(), uniforms);
+}
+
+bool AsyncFunction::isCompiled() const {
+	return state.load(std::memory_order_acquire) == State::COMPILED;
+}
+
+bool AsyncFunction::wait() const {
+	state.wait(State::PENDING, std::memory_order_acquire);
+	return isCompiled();
+}
+
+AsyncCompiler::AsyncCompiler(Runtime& runtime)
+	: runtime(runtime)
+	, stopping(false)
+	, worker(&AsyncCompiler::workerLoop, this) {}
+
+AsyncCompiler::~AsyncCompiler() {
+	{
+		std::lock_guard lock(mutex);
+		stopping = true;
+	}
+	workAvailable.notify_all();
+	worker.join();
+
+	// The worker stops without generating the remaining functions so their waiters have to be woken up.
+	for (const auto& queued : queue) {
+		if (const auto function = queued.lock()) {
+			function->state.store(AsyncFunction::State::CANCELLED, std::memory_order_release);
+			function->state.notify_all();
+		}
+	}
+}
+
+std::optional<std::shared_ptr<AsyncFunction>> AsyncCompiler::compileFunction(std::string_view source, std::span<const Variable> variables) {
+	auto irCode = runtime.compileToIr(source, variables);
+	if (!irCode.has_value()) {
+		return std::nullopt;
+	}
+	auto function = std::make_shared<AsyncFunction>(runtime, source, std::move(*irCode), variables, 1);
+	{
+		std::lock_guard lock(mutex);
+		queue.push_back(function);
+	}
+	workAvailable.notify_one();
+	return function;
+}
+
+void AsyncCompiler::workerLoop() {
+	for (;;) {
+		std::shared_ptr<AsyncFunction> function;
+		{
+			std::unique_lock lock(mutex);
+			workAvailable.wait(lock, [this] { return stopping || !queue.empty(); });
+			if (stopping) {
+				return;
+			}
+			function = queue.front().lock();
+			queue.pop_front();
+		}
+		// Skip the functions that were destroyed while waiting.
+		if (function == nullptr) {
+			continue;
+		}
+		generateMachineCode(*function);
+		// If this was the last reference the function is destroyed here, which needs the heap lock so it isn't held.
+	}
+}
+
+void AsyncCompiler::generateMachineCode(AsyncFunction& function) {
+	const auto machineCode = codeGenerator.compile(function.irCode, runtime.functions, function.variables);
+	function.compiledFunction = std::make_unique<Runtime::LoopFunction>(
+		runtime.codeHeap, machineCode, function.variables, InputLayout::BLOCKS, function.outputCount);
+	const std::string_view sources[] = { function.source };
+	function.compiledFunction->registerCode(sources);
+	function.state.store(AsyncFunction::State::COMPILED, std::memory_order_release);
+	function.state.notify_all();
+}
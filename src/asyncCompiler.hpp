@@ -0,0 +1,72 @@
+#pragma once
+
+#include "runtime.hpp"
+#include "irVm.hpp"
+#include <atomic>
+#include <memory>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+struct AsyncCompiler;
+
+// A function whose machine code is generated on a background thread. Until the code is ready the function is evaluated by interpreting its IR 8 elements at a time. When the code is ready the calls switch to it.
+// A single function can only be evaluated by one thread at a time, because the interpreter state is shared.
+// If the compiler is destroyed before the machine code is generated the function keeps being interpreted.
+struct AsyncFunction {
+	AsyncFunction(Runtime& runtime, std::string_view source, std::vector<IrOp>&& irCode, std::span<const Variable> variables, i64 outputCount);
+	AsyncFunction(const AsyncFunction&) = delete;
+	AsyncFunction& operator=(const AsyncFunction&) = delete;
+
+	// The same as the corresponding functions of Runtime::LoopFunction.
+	void operator()(const float* input, float* output, i64 elementCount, std::span<const float> uniforms = {});
+	void operator()(const LoopFunctionArray& input, LoopFunctionArray& output, std::span<const float> uniforms = {});
+	bool isCompiled() const;
+	// Blocks until the machine code is ready or the compiler is destroyed. Returns false if the machine code won't be generated.
+	bool wait() const;
+
+	Runtime& runtime;
+	// Used to name the machine code in the profilers and debuggers.
+	std::string source;
+	std::vector<IrOp> irCode;
+	// Only isUniform is used so the names may dangle.
+	std::vector<Variable> variables;
+	i64 outputCount;
+	VectorIrVm vm;
+
+	enum class State : u8 {
+		PENDING,
+		COMPILED,
+		// The compiler was destroyed before generating the machine code.
+		CANCELLED,
+	};
+	// Written by the background thread before the state is set to COMPILED.
+	std::unique_ptr<Runtime::LoopFunction> compiledFunction;
+	std::atomic<State> state;
+};
+
+// Compiles functions without blocking the calling thread for the time it takes to generate the machine code.
+struct AsyncCompiler {
+	AsyncCompiler(Runtime& runtime);
+	~AsyncCompiler();
+	AsyncCompiler(const AsyncCompiler&) = delete;
+	AsyncCompiler& operator=(const AsyncCompiler&) = delete;
+
+	// The source is compiled to IR on the calling thread so the errors are reported immediately through the reporters of the runtime. Returns std::nullopt if there are errors.
+	// The functions can't outlive the runtime. The machine code is placed in the code heap of the runtime. If a function is destroyed before its machine code is generated, the generation is skipped, so it is cheap to compile a new version of a function each time its source changes.
+	std::optional<std::shared_ptr<AsyncFunction>> compileFunction(std::string_view source, std::span<const Variable> variables);
+
+	void workerLoop();
+	void generateMachineCode(AsyncFunction& function);
+
+	Runtime& runtime;
+	CodeGenerator codeGenerator;
+
+	std::mutex mutex;
+	std::condition_variable workAvailable;
+	std::deque<std::weak_ptr<AsyncFunction>> queue;
+	bool stopping;
+	// Started after all the other members are initialized.
+	std::thread worker;
+};
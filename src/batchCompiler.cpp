@@ -0,0 +1,52 @@
+#include "batchCompiler.hpp"
+#include <chrono>
+
+BatchCompiler::BatchCompiler(Runtime& runtime, ThreadPool& pool)
+	: runtime(runtime)
+	, pool(pool) {}
+
+std::vector<BatchCompiler::Result> BatchCompiler::compile(
+	std::span<const std::string_view> sources,
+	std::span<const Variable> variables,
+	InputLayout inputLayout) {
+	const auto start = std::chrono::steady_clock::now();
+	const auto sourceCount = i64(sources.size());
+
+	std::vector<Result> results(sourceCount);
+	const auto shardCount = std::min(pool.threadCount() * SHARDS_PER_THREAD, sourceCount);
+
+	pool.parallelFor(shardCount, [&](i64 shardIndex) {
+		auto context = contexts.acquire();
+		context->collectStats = collectStats;
+		const auto shardStart = sourceCount * shardIndex / shardCount;
+		const auto shardEnd = sourceCount * (shardIndex + 1) / shardCount;
+		for (i64 i = shardStart; i < shardEnd; i++) {
+			const std::string_view source[] = { sources[i] };
+			auto& result = results[i];
+			// Placing the function records the stats like the compilations of Runtime.
+			result.function = runtime.compileFunction(*context, source, variables, inputLayout);
+			result.scannerErrors = std::move(context->scannerReporter.errors);
+			result.parserErrors = std::move(context->parserReporter.errors);
+			result.irCompilerErrors = std::move(context->irCompilerReporter.errors);
+		}
+	});
+
+	stats = Stats{ .sourceCount = sourceCount };
+	for (const auto& result : results) {
+		if (!result.function.has_value()) {
+			stats.failedCount++;
+			continue;
+		}
+		stats.codeBytes += result.function->size;
+	}
+
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return results;
+}
+
+double BatchCompiler::Stats::functionsPerSecond() const {
+	if (seconds == 0.0) {
+		return 0.0;
+	}
+	return double(sourceCount - failedCount) / seconds;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "runtime.hpp"
+
+// Compiles many functions in parallel. The sources are split into contiguous shards and each task of the pool compiles a shard with a compilation context from the pool. The functions are placed into the code heap of the runtime as soon as they are compiled.
+struct BatchCompiler {
+	BatchCompiler(Runtime& runtime, ThreadPool& pool);
+
+	struct Result {
+		// std::nullopt if there were errors.
+		std::optional<Runtime::LoopFunction> function;
+		std::vector<ScannerError> scannerErrors;
+		std::vector<ParserError> parserErrors;
+		std::vector<IrCompilerError> irCompilerErrors;
+	};
+	// The results are in the same order as the sources. The errors reference the sources so they have to outlive the results.
+	std::vector<Result> compile(
+		std::span<const std::string_view> sources,
+		std::span<const Variable> variables,
+		InputLayout inputLayout = InputLayout::BLOCKS);
+
+	// Stats of the last call to compile.
+	struct Stats {
+		i64 sourceCount = 0;
+		i64 failedCount = 0;
+		// Size of the code and data of the compiled functions.
+		i64 codeBytes = 0;
+		double seconds = 0.0;
+
+		double functionsPerSecond() const;
+	};
+	Stats stats;
+	// Records the stats of each function into compilationStatsHistograms() like the compilations with CompilationContext::collectStats set.
+	bool collectStats = false;
+
+	static constexpr i64 SHARDS_PER_THREAD = 4;
+
+	Runtime& runtime;
+	ThreadPool& pool;
+	// Reused between the calls to compile.
+	CompilationContextPool contexts;
+};
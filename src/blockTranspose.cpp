@@ -0,0 +1,74 @@
+#include "blockTranspose.hpp"
+
+static constexpr i64 ROWS = 8;
+
+// The first count lanes are set.
+static __m256i firstLanesMask(i64 count) {
+	static const i32 maskTable[16] = { -1, -1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0 };
+	return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&maskTable[ROWS - count]));
+}
+
+void transposeRowsToBlocks(const float* rows, i64 valuesPerRow, __m256* blocks) {
+	// With a single value the layouts are the same.
+	if (valuesPerRow == 1) {
+		_mm256_storeu_ps(reinterpret_cast<float*>(blocks), _mm256_loadu_ps(rows));
+		return;
+	}
+	__m256 m[ROWS];
+	i64 group = 0;
+	for (; group + ROWS <= valuesPerRow; group += ROWS) {
+		for (i64 i = 0; i < ROWS; i++) {
+			m[i] = _mm256_loadu_ps(&rows[i * valuesPerRow + group]);
+		}
+		transpose8x8(m);
+		for (i64 i = 0; i < ROWS; i++) {
+			_mm256_storeu_ps(reinterpret_cast<float*>(&blocks[group + i]), m[i]);
+		}
+	}
+
+	const auto remaining = valuesPerRow - group;
+	if (remaining == 0) {
+		return;
+	}
+	const auto mask = firstLanesMask(remaining);
+	for (i64 i = 0; i < ROWS; i++) {
+		m[i] = _mm256_maskload_ps(&rows[i * valuesPerRow + group], mask);
+	}
+	transpose8x8(m);
+	for (i64 i = 0; i < remaining; i++) {
+		_mm256_storeu_ps(reinterpret_cast<float*>(&blocks[group + i]), m[i]);
+	}
+}
+
+void transposeBlocksToRows(const __m256* blocks, i64 valuesPerRow, float* rows) {
+	if (valuesPerRow == 1) {
+		_mm256_storeu_ps(rows, _mm256_loadu_ps(reinterpret_cast<const float*>(blocks)));
+		return;
+	}
+	__m256 m[ROWS];
+	i64 group = 0;
+	for (; group + ROWS <= valuesPerRow; group += ROWS) {
+		for (i64 i = 0; i < ROWS; i++) {
+			m[i] = _mm256_loadu_ps(reinterpret_cast<const float*>(&blocks[group + i]));
+		}
+		transpose8x8(m);
+		for (i64 i = 0; i < ROWS; i++) {
+			_mm256_storeu_ps(&rows[i * valuesPerRow + group], m[i]);
+		}
+	}
+
+	const auto remaining = valuesPerRow - group;
+	if (remaining == 0) {
+		return;
+	}
+	for (i64 i = 0; i < ROWS; i++) {
+		m[i] = i < remaining
+			? _mm256_loadu_ps(reinterpret_cast<const float*>(&blocks[group + i]))
+			: _mm256_setzero_ps();
+	}
+	transpose8x8(m);
+	const auto mask = firstLanesMask(remaining);
+	for (i64 i = 0; i < ROWS; i++) {
+		_mm256_maskstore_ps(&rows[i * valuesPerRow + group], mask, m[i]);
+	}
+}
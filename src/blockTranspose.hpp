@@ -0,0 +1,42 @@
+#pragma once
+
+#include "utils/ints.hpp"
+#include <immintrin.h>
+
+// Conversions between rows (the values of all the variables of an element stored next to each other) and the block layout used by LoopFunctionArray (8 values of the first variable, then 8 values of the second variable and so on).
+// Both functions convert exactly 8 rows. The variables are processed in groups of 8 with an 8x8 register transpose. The last group of a variable count that isn't a multiple of 8 uses masked loads and stores so no memory outside the rows and blocks is accessed.
+
+// blocks has to have space for valuesPerRow vectors.
+void transposeRowsToBlocks(const float* rows, i64 valuesPerRow, __m256* blocks);
+// rows has to have space for 8 * valuesPerRow values.
+void transposeBlocksToRows(const __m256* blocks, i64 valuesPerRow, float* rows);
+
+// The row i of the result is the column i of the input.
+inline void transpose8x8(__m256 m[8]) {
+	const auto t0 = _mm256_unpacklo_ps(m[0], m[1]);
+	const auto t1 = _mm256_unpackhi_ps(m[0], m[1]);
+	const auto t2 = _mm256_unpacklo_ps(m[2], m[3]);
+	const auto t3 = _mm256_unpackhi_ps(m[2], m[3]);
+	const auto t4 = _mm256_unpacklo_ps(m[4], m[5]);
+	const auto t5 = _mm256_unpackhi_ps(m[4], m[5]);
+	const auto t6 = _mm256_unpacklo_ps(m[6], m[7]);
+	const auto t7 = _mm256_unpackhi_ps(m[6], m[7]);
+
+	const auto s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+	const auto s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+	const auto s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+	const auto s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	const auto s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+	const auto s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+	const auto s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+	const auto s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+	m[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+	m[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+	m[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+	m[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+	m[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+	m[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+	m[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+	m[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+// Calling convention used by the functions that are called from the generated code.
+// The default 64 bit windows calling convention passes SIMD values through memory (see callingConventions.txt) so vectorcall has to be used. The System V ABI already passes __m256 values in the ymm registers.
+#ifdef _MSC_VER
+#define SIMD_CALL __vectorcall
+#else
+#define SIMD_CALL
+#endif
+
+enum class CallingConvention {
+	WINDOWS_X64,
+	SYSTEM_V,
+};
+
+#ifdef _WIN32
+constexpr auto HOST_CALLING_CONVENTION = CallingConvention::WINDOWS_X64;
+#else
+constexpr auto HOST_CALLING_CONVENTION = CallingConvention::SYSTEM_V;
+#endif
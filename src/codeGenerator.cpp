@@ -3,42 +3,162 @@
 #include "utils/asserts.hpp"
 #include "floatingPoint.hpp"
 #include <algorithm>
+#include <limits>
+#include <cstddef>
 
-CodeGenerator::CodeGenerator() {
-	initialize(std::span<const Variable>(), std::span<const FunctionInfo>());
+CodeGenerator::CodeGenerator(CallingConvention callingConvention)
+	: callingConvention(callingConvention) {
+	initialize(std::span<const Variable>(), std::span<const FunctionInfo>(), InputLayout::BLOCKS, Reduction::NONE, Precision::F32, std::span<const ElementType>());
 }
 
-void CodeGenerator::initialize(std::span<const Variable> parameters, std::span<const FunctionInfo> functions) {
+void CodeGenerator::initialize(std::span<const Variable> parameters, std::span<const FunctionInfo> functions, InputLayout inputLayout, Reduction reduction, Precision precision, std::span<const ElementType> outputTypes) {
 	registerToLastUsage.clear();
 	virtualRegisterToLocation.clear();
 	for (i64 i = 0; i < i64(std::size(registerAllocations)); i++) {
 		registerAllocations[i] = std::nullopt;
 	}
 	currentInstructionIndex = 0;
+	generatingTail = false;
+	tailMaskLoaded = false;
 	this->parameters = parameters;
+	this->inputLayout = inputLayout;
+	this->reduction = reduction;
+	this->precision = precision;
+	this->outputTypes = outputTypes;
+	hasTypedColumns = std::ranges::any_of(outputTypes, [](ElementType type) { return type != ElementType::F32; });
+	for (const auto& parameter : parameters) {
+		if (!parameter.isUniform && parameter.elementType != ElementType::F32) {
+			hasTypedColumns = true;
+		}
+	}
 	stackMemoryAllocated = 0;
 	stackAllocations.clear();
+	spillCount = 0;
+	spillBytes = 0;
 	this->functions = functions;
 	a.reset();
 }
 
-// TODO: Encoding R12 is different.
-const auto inputArrayRegister = Reg64::RDI;
 const auto inputArrayRegisterArgumentIndex = 0;
-const auto outputArrayRegister = Reg64::R13;
 const auto outputArrayRegisterArgumentIndex = 1;
-const auto arraySizeRegister = Reg64::R14;
 const auto arraySizeRegisterArgumentIndex = 2;
-const auto indexRegister = Reg64::R15;
+const auto uniformsRegisterArgumentIndex = 3;
+
+std::span<const Reg64> CodeGenerator::integerFunctionInputRegisters() const {
+	switch (callingConvention) {
+		using enum CallingConvention;
+	case WINDOWS_X64: return WINDOWS_INTEGER_FUNCTION_INPUT_REGISTERS;
+	case SYSTEM_V: return SYSTEM_V_INTEGER_FUNCTION_INPUT_REGISTERS;
+	}
+	ASSERT_NOT_REACHED();
+	return std::span<const Reg64>();
+}
+
+i64 CodeGenerator::simdArgumentRegisterCount() const {
+	switch (callingConvention) {
+		using enum CallingConvention;
+	case WINDOWS_X64: return VECTORCALL_SIMD_ARGUMENT_REGISTER_COUNT;
+	case SYSTEM_V: return SYSTEM_V_SIMD_ARGUMENT_REGISTER_COUNT;
+	}
+	ASSERT_NOT_REACHED();
+	return 0;
+}
+
+bool CodeGenerator::isCalleeSavedRegister(Reg64 reg) const {
+	switch (reg) {
+		using enum Reg64;
+	case RBX:
+	case RBP:
+	case RSP:
+	case R12:
+	case R13:
+	case R14:
+	case R15:
+		return true;
+	case RDI:
+	case RSI:
+		return callingConvention == CallingConvention::WINDOWS_X64;
+	default:
+		return false;
+	}
+}
+
+void CodeGenerator::chooseLoopRegisters(const std::vector<IrOp>& irCode) {
+	callsFunctions = std::ranges::any_of(irCode, [](const IrOp& op) { return std::holds_alternative<FunctionOp>(op); });
 
-const MachineCode& CodeGenerator::compile(
+	if (!callsFunctions) {
+		const auto inputRegisters = integerFunctionInputRegisters();
+		inputArrayRegister = inputRegisters[inputArrayRegisterArgumentIndex];
+		outputArrayRegister = inputRegisters[outputArrayRegisterArgumentIndex];
+		arraySizeRegister = inputRegisters[arraySizeRegisterArgumentIndex];
+		columnIndexRegister = Reg64::RAX;
+		return;
+	}
+
+	// The values have to survive the function calls so callee saved registers are used.
+	// TODO: Encoding R12 is different.
+	switch (callingConvention) {
+		using enum CallingConvention;
+	case WINDOWS_X64:
+		inputArrayRegister = Reg64::RDI;
+		break;
+	case SYSTEM_V:
+		inputArrayRegister = Reg64::RBX;
+		break;
+	}
+	outputArrayRegister = Reg64::R13;
+	arraySizeRegister = Reg64::R14;
+	columnIndexRegister = Reg64::R15;
+}
+
+MachineCode CodeGenerator::compile(
 	const std::vector<IrOp>& irCode,
 	std::span<const FunctionInfo> functions,
-	std::span<const Variable> parameters) {
-	initialize(parameters, functions);
+	std::span<const Variable> parameters,
+	InputLayout inputLayout,
+	Reduction reduction,
+	Precision precision,
+	std::span<const ElementType> outputTypes) {
+	generateAssembly(irCode, functions, parameters, inputLayout, reduction, precision, outputTypes);
+	MachineCode machineCode;
+	machineCode.generateFrom(a);
+	return machineCode;
+}
+
+void CodeGenerator::generateAssembly(
+	const std::vector<IrOp>& irCode,
+	std::span<const FunctionInfo> functions,
+	std::span<const Variable> parameters,
+	InputLayout inputLayout,
+	Reduction reduction,
+	Precision precision,
+	std::span<const ElementType> outputTypes) {
+	initialize(parameters, functions, inputLayout, reduction, precision, outputTypes);
+	ASSERT(precision == Precision::F32 || (inputLayout != InputLayout::GRID && reduction == Reduction::NONE));
+	ASSERT(!hasTypedColumns || (inputLayout == InputLayout::COLUMNS && precision == Precision::F32 && reduction == Reduction::NONE));
 	computeRegisterLastUsage(irCode);
+	chooseLoopRegisters(irCode);
 
-	a.xor_(indexRegister, indexRegister);
+	assignVariableLocations();
+	outputCount = 0;
+	for (const auto& op : irCode) {
+		if (const auto returnOp = std::get_if<ReturnOp>(&op)) {
+			outputCount = std::max(outputCount, returnOp->outputIndex + 1);
+		}
+	}
+	// The reduction combines the values of a single output.
+	ASSERT(reduction == Reduction::NONE || outputCount == 1);
+	broadcastUniforms();
+	if (gridDimensionCount > 0) {
+		initializeGridCoordinates();
+	}
+	if (reduction != Reduction::NONE) {
+		initializeReduction();
+	}
+
+	if (inputLayout != InputLayout::BLOCKS) {
+		a.xor_(columnIndexRegister, columnIndexRegister);
+	}
 
 	const auto conditionCheckLabel = a.allocateLabel();
 	a.jmp(conditionCheckLabel);
@@ -46,6 +166,187 @@ const MachineCode& CodeGenerator::compile(
 	const auto loopStartLabel = a.allocateLabel();
 	a.setLabelOnNextInstruction(loopStartLabel);
 
+	generateLoopBody(irCode);
+
+	switch (inputLayout) {
+		using enum InputLayout;
+	case BLOCKS:
+		a.add(inputArrayRegister, u32(inputVariableCount * YMM_REGISTER_SIZE));
+		if (reduction == Reduction::NONE) {
+			a.add(outputArrayRegister, u32(outputCount * YMM_REGISTER_SIZE));
+		}
+		break;
+	case COLUMNS:
+		a.add(columnIndexRegister, u32(elementsPerYmm()));
+		break;
+	case GRID:
+		a.add(columnIndexRegister, u32(elementsPerYmm()));
+		if (gridDimensionCount > 0) {
+			advanceGridCoordinates();
+		}
+		break;
+	}
+	a.sub(arraySizeRegister, u32(elementsPerYmm()));
+
+	a.setLabelOnNextInstruction(conditionCheckLabel);
+
+	a.cmp(arraySizeRegister, u32(elementsPerYmm()));
+	a.jge(loopStartLabel);
+
+	if (!hasTypedColumns) {
+		const auto endLabel = a.allocateLabel();
+		a.cmp(arraySizeRegister, 0);
+		a.jle(endLabel);
+
+		emitTailMask();
+		resetRegisterAllocation();
+		generatingTail = true;
+		generateLoopBody(irCode);
+		generatingTail = false;
+
+		a.setLabelOnNextInstruction(endLabel);
+	}
+	if (reduction != Reduction::NONE) {
+		storeReductionPartials();
+	}
+	emitPrologueAndEpilogue();
+}
+
+i64 CodeGenerator::elementsPerYmm() const {
+	return precision == Precision::F32 ? ELEMENTS_PER_YMM : YMM_REGISTER_SIZE / i64(sizeof(double));
+}
+
+ElementType CodeGenerator::outputType(i64 outputIndex) const {
+	return outputIndex < i64(outputTypes.size()) ? outputTypes[outputIndex] : ElementType::F32;
+}
+
+void CodeGenerator::assignVariableLocations() {
+	variableIndexToInputIndex.clear();
+	variableIndexToUniformIndex.clear();
+	variableIndexToGridDimension.clear();
+	gridDimensionCount = 0;
+	inputVariableCount = 0;
+
+	i64 uniformCount = 0;
+	for (const auto& parameter : parameters) {
+		if (parameter.isUniform) {
+			uniformCount++;
+		}
+	}
+	gridFirstUniformIndex = uniformCount;
+
+	uniformCount = 0;
+	for (i64 i = 0; i < i64(parameters.size()); i++) {
+		std::optional<i64> inputIndex;
+		std::optional<i64> uniformIndex;
+		std::optional<i64> gridDimension;
+		if (parameters[i].isUniform) {
+			uniformIndex = uniformCount;
+			uniformCount++;
+		} else if (inputLayout != InputLayout::GRID) {
+			inputIndex = inputVariableCount;
+			inputVariableCount++;
+		} else {
+			gridDimension = gridDimensionCount;
+			gridDimensionCount++;
+		}
+		variableIndexToInputIndex.push_back(inputIndex);
+		variableIndexToUniformIndex.push_back(uniformIndex);
+		variableIndexToGridDimension.push_back(gridDimension);
+	}
+}
+
+void CodeGenerator::broadcastUniforms() {
+	variableIndexToUniformBaseOffset.clear();
+	// The register is only read before the loop so it doesn't need to be saved.
+	const auto uniformsRegister = integerFunctionInputRegisters()[uniformsRegisterArgumentIndex];
+	for (const auto& uniformIndex : variableIndexToUniformIndex) {
+		if (!uniformIndex.has_value()) {
+			variableIndexToUniformBaseOffset.push_back(std::nullopt);
+			continue;
+		}
+		const auto memory = stackAllocate(YMM_REGISTER_SIZE, YMM_REGISTER_ALIGNMENT);
+		if (precision == Precision::F32) {
+			a.vbroadcastss(RegYmm::YMM0, uniformsRegister, i32(*uniformIndex * sizeof(float)));
+		} else {
+			a.vbroadcastsd(RegYmm::YMM0, uniformsRegister, i32(*uniformIndex * sizeof(double)));
+		}
+		a.vmovaps(STACK_BASE_REGISTER, memory.baseOffset, RegYmm::YMM0);
+		variableIndexToUniformBaseOffset.push_back(memory.baseOffset);
+	}
+}
+
+void CodeGenerator::initializeGridCoordinates() {
+	const auto uniformsRegister = integerFunctionInputRegisters()[uniformsRegisterArgumentIndex];
+	const auto uniformOffset = [&](i64 index) {
+		return i32((gridFirstUniformIndex + index) * sizeof(float));
+	};
+	const auto broadcastToStack = [&](i64 uniformIndex) {
+		const auto baseOffset = stackAllocate(YMM_REGISTER_SIZE, YMM_REGISTER_ALIGNMENT).baseOffset;
+		a.vbroadcastss(RegYmm::YMM0, uniformsRegister, uniformOffset(uniformIndex));
+		a.vmovaps(STACK_BASE_REGISTER, baseOffset, RegYmm::YMM0);
+		return baseOffset;
+	};
+
+	gridDimensionLocations.clear();
+	for (i64 dimension = 0; dimension < gridDimensionCount; dimension++) {
+		const auto first = dimension * GRID_UNIFORMS_PER_DIMENSION;
+		GridDimensionLocations locations;
+		locations.origin = broadcastToStack(first);
+		locations.step = broadcastToStack(first + 1);
+		locations.size = broadcastToStack(first + 2);
+		locations.increment = broadcastToStack(first + 3);
+		locations.indices = stackAllocate(YMM_REGISTER_SIZE, YMM_REGISTER_ALIGNMENT).baseOffset;
+		locations.coordinates = stackAllocate(YMM_REGISTER_SIZE, YMM_REGISTER_ALIGNMENT).baseOffset;
+		a.vmovups(RegYmm::YMM0, uniformsRegister, uniformOffset(gridDimensionCount * GRID_UNIFORMS_PER_DIMENSION + dimension * ELEMENTS_PER_YMM));
+		a.vmovaps(STACK_BASE_REGISTER, locations.indices, RegYmm::YMM0);
+		computeGridCoordinates(locations, RegYmm::YMM0, RegYmm::YMM1);
+		gridDimensionLocations.push_back(locations);
+	}
+}
+
+void CodeGenerator::advanceGridCoordinates() {
+	// All the registers are dead at the end of the iteration.
+	// The indices are integers stored as floats. They are less than the sizes of the dimensions so they are exact, and the coordinates are computed from them so the rounding errors don't accumulate.
+	// The increments are less than the sizes so with the carry from the lower dimension an index needs to be wrapped at most once. The last dimension isn't wrapped.
+	const auto oneLabel = a.allocateData(1.0f);
+	const auto indices = RegYmm::YMM0;
+	const auto temp = RegYmm::YMM1;
+	const auto overflow = RegYmm::YMM2;
+	const auto carry = RegYmm::YMM3;
+	for (i64 dimension = 0; dimension < gridDimensionCount; dimension++) {
+		const auto& locations = gridDimensionLocations[dimension];
+		a.vmovaps(indices, STACK_BASE_REGISTER, locations.indices);
+		a.vmovaps(temp, STACK_BASE_REGISTER, locations.increment);
+		a.vaddps(indices, indices, temp);
+		if (dimension > 0) {
+			a.vaddps(indices, indices, carry);
+		}
+		if (dimension < gridDimensionCount - 1) {
+			// overflow = size - 1 < indices
+			a.vmovaps(temp, STACK_BASE_REGISTER, locations.size);
+			a.vbroadcastss(overflow, oneLabel);
+			a.vsubps(overflow, temp, overflow);
+			a.vcmpps(overflow, overflow, indices, CmpPredicate::LESS);
+			a.vandps(temp, overflow, temp);
+			a.vsubps(indices, indices, temp);
+			a.vbroadcastss(carry, oneLabel);
+			a.vandps(carry, overflow, carry);
+		}
+		a.vmovaps(STACK_BASE_REGISTER, locations.indices, indices);
+		computeGridCoordinates(locations, indices, temp);
+	}
+}
+
+void CodeGenerator::computeGridCoordinates(const GridDimensionLocations& locations, RegYmm indices, RegYmm temp) {
+	a.vmovaps(temp, STACK_BASE_REGISTER, locations.step);
+	a.vmulps(indices, indices, temp);
+	a.vmovaps(temp, STACK_BASE_REGISTER, locations.origin);
+	a.vaddps(indices, indices, temp);
+	a.vmovaps(STACK_BASE_REGISTER, locations.coordinates, indices);
+}
+
+void CodeGenerator::generateLoopBody(const std::vector<IrOp>& irCode) {
 	for (i64 i = 0; i < i64(irCode.size()); i++) {
 		const auto& op = irCode[i];
 		currentInstructionIndex = i;
@@ -63,21 +364,335 @@ const MachineCode& CodeGenerator::compile(
 			[&](const ReturnOp& op) { returnOp(op); }
 		}, op);
 	}
+}
 
-	a.add(inputArrayRegister, u32(parameters.size() * YMM_REGISTER_SIZE));
-	a.add(outputArrayRegister, YMM_REGISTER_SIZE);
-	a.inc(indexRegister);
+void CodeGenerator::resetRegisterAllocation() {
+	virtualRegisterToLocation.clear();
+	for (i64 i = 0; i < i64(std::size(registerAllocations)); i++) {
+		registerAllocations[i] = std::nullopt;
+	}
+}
 
-	a.setLabelOnNextInstruction(conditionCheckLabel);
+void CodeGenerator::emitTailMask() {
+	// Loading 8 elements starting at (8 - remainingCount) gives a mask with the first remainingCount elements set. With doubles each element covers 2 entries of the table.
+	static constexpr float maskTable[] = {
+		std::bit_cast<float>(0xFFFFFFFFu), std::bit_cast<float>(0xFFFFFFFFu), std::bit_cast<float>(0xFFFFFFFFu), std::bit_cast<float>(0xFFFFFFFFu),
+		std::bit_cast<float>(0xFFFFFFFFu), std::bit_cast<float>(0xFFFFFFFFu), std::bit_cast<float>(0xFFFFFFFFu), std::bit_cast<float>(0xFFFFFFFFu),
+		0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f,
+	};
+	const auto maskTableLabel = a.allocateData(maskTable);
+	const auto maskTableEnd = DataLabel(maskTableLabel + ELEMENTS_PER_YMM);
+
+	// R10 and R11 are volatile in both calling conventions and aren't used by the loop.
+	const auto scratchRegister = Reg64::R11;
+	a.shl(arraySizeRegister, precision == Precision::F32 ? 2 : 3);
+	a.lea(scratchRegister, maskTableEnd);
+	a.sub(scratchRegister, arraySizeRegister);
+	a.vmovups(tailMaskRegisterLocation(), scratchRegister, 0);
+
+	tailMaskLoaded = true;
+	if (callsFunctions) {
+		tailMaskBaseOffset = stackAllocate(YMM_REGISTER_SIZE, YMM_REGISTER_ALIGNMENT).baseOffset;
+		a.vmovaps(STACK_BASE_REGISTER, tailMaskBaseOffset, tailMaskRegisterLocation());
+	}
+}
 
-	a.cmp(indexRegister, arraySizeRegister);
-	a.jl(loopStartLabel);
+RegYmm CodeGenerator::tailMaskRegister() {
+	if (!tailMaskLoaded) {
+		a.vmovaps(tailMaskRegisterLocation(), STACK_BASE_REGISTER, tailMaskBaseOffset);
+		tailMaskLoaded = true;
+	}
+	return tailMaskRegisterLocation();
+}
 
-	emitPrologueAndEpilogue();
+void CodeGenerator::loadColumnAddress(Reg64 arrayRegister, i64 columnIndex, ElementType elementType) {
+	a.movFromMemory(COLUMN_ADDRESS_REGISTER, arrayRegister, i32(columnIndex * sizeof(float*)));
+	const auto elementSize = precision == Precision::F32 ? elementTypeSize(elementType) : i64(sizeof(double));
+	a.lea(COLUMN_ADDRESS_REGISTER, COLUMN_ADDRESS_REGISTER, columnIndexRegister, u8(elementSize));
+}
 
-	machineCodeOutput.generateFrom(a);
+void CodeGenerator::loadVariable(RegYmm destination, i64 inputIndex) {
+	auto addressRegister = inputArrayRegister;
+	i32 offset = 0;
+	auto elementType = ElementType::F32;
+	switch (inputLayout) {
+		using enum InputLayout;
+	case BLOCKS:
+		offset = i32(inputIndex * YMM_REGISTER_SIZE);
+		break;
+	case COLUMNS: {
+		addressRegister = COLUMN_ADDRESS_REGISTER;
+		const auto variableIndex = std::ranges::find(variableIndexToInputIndex, inputIndex) - variableIndexToInputIndex.begin();
+		elementType = parameters[variableIndex].elementType;
+		loadColumnAddress(inputArrayRegister, inputIndex, elementType);
+		break;
+	}
+	case GRID:
+		// All the variables are either generated or uniform.
+		ASSERT_NOT_REACHED();
+		break;
+	}
 
-	return machineCodeOutput;
+	if (generatingTail) {
+		a.vmaskmovps(destination, tailMaskRegister(), addressRegister, offset);
+		return;
+	}
+	switch (elementType) {
+		using enum ElementType;
+	case F32:
+		a.vmovups(destination, addressRegister, offset);
+		break;
+	case F16:
+		a.vcvtph2ps(destination, addressRegister, offset);
+		break;
+	case F64: {
+		const auto upperHalf = conversionScratchRegister();
+		a.vcvtpd2ps(destination, addressRegister, offset);
+		a.vcvtpd2ps(upperHalf, addressRegister, offset + 4 * i32(sizeof(double)));
+		a.vinsertf128(destination, destination, upperHalf, 1);
+		break;
+	}
+	case I32:
+		a.vmovups(destination, addressRegister, offset);
+		a.vcvtdq2ps(destination, destination);
+		break;
+	case U8:
+		a.vpmovzxbd(destination, addressRegister, offset);
+		a.vcvtdq2ps(destination, destination);
+		break;
+	}
+}
+
+void CodeGenerator::storeOutput(i64 outputIndex, RegYmm source) {
+	auto addressRegister = outputArrayRegister;
+	i32 offset = 0;
+	auto elementType = ElementType::F32;
+	switch (inputLayout) {
+		using enum InputLayout;
+	case BLOCKS:
+		offset = i32(outputIndex * YMM_REGISTER_SIZE);
+		break;
+	case COLUMNS:
+	case GRID:
+		addressRegister = COLUMN_ADDRESS_REGISTER;
+		elementType = outputType(outputIndex);
+		loadColumnAddress(outputArrayRegister, outputIndex, elementType);
+		break;
+	}
+
+	if (generatingTail) {
+		a.vmaskmovps(addressRegister, offset, tailMaskRegister(), source);
+		return;
+	}
+	// The source can't be modified, because the value might still be used.
+	const auto scratch = conversionScratchRegister();
+	switch (elementType) {
+		using enum ElementType;
+	case F32:
+		a.vmovups(addressRegister, offset, source);
+		break;
+	case F16:
+		a.vcvtps2ph(addressRegister, offset, source);
+		break;
+	case F64:
+		a.vcvtps2pd(scratch, source);
+		a.vmovups(addressRegister, offset, scratch);
+		a.vextractf128(scratch, source, 1);
+		a.vcvtps2pd(scratch, scratch);
+		a.vmovups(addressRegister, offset + 4 * i32(sizeof(double)), scratch);
+		break;
+	case I32: {
+		// vcvtps2dq converts NaN and the values outside the range to INT32_MIN. NaN is zeroed before the conversion and the lanes that are at least 2^31 (greater than the biggest float less than 2^31) are flipped from INT32_MIN to INT32_MAX by xoring them with the all ones compare mask.
+		const auto overflowMask = secondConversionScratchRegister();
+		a.vcmpps(scratch, source, source, CmpPredicate::ORDERED);
+		a.vandps(scratch, scratch, source);
+		a.vcvtps2dq(scratch, scratch);
+		a.vbroadcastss(overflowMask, a.allocateData(2147483520.0f));
+		a.vcmpps(overflowMask, overflowMask, source, CmpPredicate::LESS);
+		a.vxorps(scratch, scratch, overflowMask);
+		a.vmovups(addressRegister, offset, scratch);
+		break;
+	}
+	case U8:
+		// vminps returns the second operand if it is NaN so NaN is converted to INT32_MIN and saturated to 0 by the packing like the negative values.
+		a.vbroadcastss(scratch, a.allocateData(255.0f));
+		a.vminps(scratch, scratch, source);
+		a.vcvtps2dq(scratch, scratch);
+		// Each lane holds its 4 words twice. The first copies of both lanes are moved into the lower lane.
+		a.vpackusdw(scratch, scratch, scratch);
+		a.vpermq(scratch, scratch, 0b00'00'10'00);
+		a.vpackuswb(scratch, scratch, scratch);
+		a.vmovq(addressRegister, offset, scratch);
+		break;
+	}
+}
+
+RegYmm CodeGenerator::conversionScratchRegister() const {
+	ASSERT(!generatingTail);
+	return tailMaskRegisterLocation();
+}
+
+RegYmm CodeGenerator::secondConversionScratchRegister() const {
+	ASSERT(hasTypedColumns && reduction == Reduction::NONE);
+	return regYmmFromIndex(u8(YMM_REGISTER_COUNT - 2));
+}
+
+RegYmm CodeGenerator::tailMaskRegisterLocation() const {
+	return regYmmFromIndex(u8(YMM_REGISTER_COUNT - 1 - reductionReservedRegisterCount()));
+}
+
+i64 CodeGenerator::allocatableYmmRegisterCount() const {
+	const auto count = YMM_REGISTER_COUNT - reductionReservedRegisterCount();
+	if (hasTypedColumns) {
+		return count - 2;
+	}
+	return generatingTail ? count - 1 : count;
+}
+
+bool CodeGenerator::isArgReduction() const {
+	return reduction == Reduction::ARGMIN || reduction == Reduction::ARGMAX;
+}
+
+i64 CodeGenerator::reductionReservedRegisterCount() const {
+	switch (reduction) {
+		using enum Reduction;
+	case NONE: return 0;
+	case SUM:
+	case MEAN:
+	case MIN:
+	case MAX:
+		return 2;
+	case ARGMIN:
+	case ARGMAX:
+		return 4;
+	}
+	ASSERT_NOT_REACHED();
+	return 0;
+}
+
+void CodeGenerator::initializeReduction() {
+	const auto values = REDUCTION_VALUES_REGISTER;
+	switch (reduction) {
+		using enum Reduction;
+	case NONE:
+		ASSERT_NOT_REACHED();
+		break;
+	case SUM:
+	case MEAN:
+		a.vxorps(values, values, values);
+		break;
+	case MIN:
+	case ARGMIN:
+		a.vbroadcastss(values, a.allocateData(std::numeric_limits<float>::infinity()));
+		break;
+	case MAX:
+	case ARGMAX:
+		a.vbroadcastss(values, a.allocateData(-std::numeric_limits<float>::infinity()));
+		break;
+	}
+
+	reductionAccumulatorBaseOffsets.clear();
+	reductionAccumulatorBaseOffsets.push_back({ values, 0 });
+	if (isArgReduction()) {
+		static constexpr float elementIndices[] = {
+			std::bit_cast<float>(0), std::bit_cast<float>(1), std::bit_cast<float>(2), std::bit_cast<float>(3),
+			std::bit_cast<float>(4), std::bit_cast<float>(5), std::bit_cast<float>(6), std::bit_cast<float>(7),
+		};
+		const auto scratchRegister = Reg64::R11;
+		a.lea(scratchRegister, a.allocateData(elementIndices));
+		a.vmovups(REDUCTION_ELEMENT_INDICES_REGISTER, scratchRegister, 0);
+		a.vbroadcastss(REDUCTION_INDICES_REGISTER, a.allocateData(std::bit_cast<float>(-1)));
+		reductionAccumulatorBaseOffsets.push_back({ REDUCTION_ELEMENT_INDICES_REGISTER, 0 });
+		reductionAccumulatorBaseOffsets.push_back({ REDUCTION_INDICES_REGISTER, 0 });
+	}
+
+	if (callsFunctions) {
+		for (auto& [reg, baseOffset] : reductionAccumulatorBaseOffsets) {
+			baseOffset = stackAllocate(YMM_REGISTER_SIZE, YMM_REGISTER_ALIGNMENT).baseOffset;
+			a.vmovaps(STACK_BASE_REGISTER, baseOffset, reg);
+		}
+	}
+}
+
+void CodeGenerator::reduce(RegYmm value) {
+	if (callsFunctions) {
+		for (const auto& [reg, baseOffset] : reductionAccumulatorBaseOffsets) {
+			a.vmovaps(reg, STACK_BASE_REGISTER, baseOffset);
+		}
+	}
+
+	const auto values = REDUCTION_VALUES_REGISTER;
+	const auto temp = REDUCTION_TEMP_REGISTER;
+	switch (reduction) {
+		using enum Reduction;
+	case NONE:
+		ASSERT_NOT_REACHED();
+		break;
+
+	case SUM:
+	case MEAN:
+		if (generatingTail) {
+			// The masked out elements are zero.
+			a.vandps(temp, value, tailMaskRegister());
+			a.vaddps(values, values, temp);
+		} else {
+			a.vaddps(values, values, value);
+		}
+		break;
+
+	// If one of the operands is NaN vminps and vmaxps return the second one so the NaNs are skipped.
+	case MIN:
+		if (generatingTail) {
+			a.vminps(temp, value, values);
+			a.vblendvps(values, values, temp, tailMaskRegister());
+		} else {
+			a.vminps(values, value, values);
+		}
+		break;
+
+	case MAX:
+		if (generatingTail) {
+			a.vmaxps(temp, value, values);
+			a.vblendvps(values, values, temp, tailMaskRegister());
+		} else {
+			a.vmaxps(values, value, values);
+		}
+		break;
+
+	case ARGMIN:
+	case ARGMAX: {
+		// The comparison is strict and false for NaNs so each lane keeps the first of the equal values.
+		const auto predicate = reduction == ARGMIN ? CmpPredicate::LESS : CmpPredicate::GREATER;
+		a.vcmpps(temp, value, values, predicate);
+		if (generatingTail) {
+			a.vandps(temp, temp, tailMaskRegister());
+		}
+		a.vblendvps(values, values, value, temp);
+		a.vblendvps(REDUCTION_INDICES_REGISTER, REDUCTION_INDICES_REGISTER, REDUCTION_ELEMENT_INDICES_REGISTER, temp);
+		a.vbroadcastss(temp, a.allocateData(std::bit_cast<float>(i32(ELEMENTS_PER_YMM))));
+		a.vpaddd(REDUCTION_ELEMENT_INDICES_REGISTER, REDUCTION_ELEMENT_INDICES_REGISTER, temp);
+		break;
+	}
+	}
+
+	if (callsFunctions) {
+		for (const auto& [reg, baseOffset] : reductionAccumulatorBaseOffsets) {
+			a.vmovaps(STACK_BASE_REGISTER, baseOffset, reg);
+		}
+	}
+}
+
+void CodeGenerator::storeReductionPartials() {
+	// The loop might not have run so the accumulators are reloaded if they might have been overwritten by a call.
+	if (callsFunctions) {
+		for (const auto& [reg, baseOffset] : reductionAccumulatorBaseOffsets) {
+			a.vmovaps(reg, STACK_BASE_REGISTER, baseOffset);
+		}
+	}
+	a.vmovups(outputArrayRegister, i32(offsetof(ReductionPartials, values)), REDUCTION_VALUES_REGISTER);
+	if (isArgReduction()) {
+		a.vmovups(outputArrayRegister, i32(offsetof(ReductionPartials, indices)), REDUCTION_INDICES_REGISTER);
+	}
 }
 
 void CodeGenerator::computeRegisterLastUsage(const std::vector<IrOp>& irCode) {
@@ -159,15 +774,27 @@ void CodeGenerator::computeRegisterFirstAssigned(const std::vector<IrOp>& irCode
 void CodeGenerator::movToYmmFromMemoryLocation(RegYmm destination, const MemoryLocation& memoryLocation) {
 	std::visit(overloaded{
 		[&](const ConstantLocation& location) {
-			const auto label = a.allocateData(location.value);
-			a.vbroadcastss(destination, label);
+			broadcastConstant(destination, location.value);
 		},
 		[&](const RegisterConstantOffsetLocation& location) {
+			// The variables are stored at the offset they would have in the BLOCKS layout.
+			if (location.registerWithAddress == inputArrayRegister) {
+				loadVariable(destination, location.offset / YMM_REGISTER_SIZE);
+				return;
+			}
 			a.vmovaps(destination, location.registerWithAddress, u32(location.offset));
 		}
 	}, memoryLocation);
 }
 
+void CodeGenerator::broadcastConstant(RegYmm destination, RealConstant value) {
+	if (precision == Precision::F32) {
+		a.vbroadcastss(destination, a.allocateData(float(value)));
+	} else {
+		a.vbroadcastsd(destination, a.allocateData(double(value)));
+	}
+}
+
 void CodeGenerator::movToYmmFromYmm(RegYmm destination, RegYmm source) {
 	if (destination == source) {
 		return;
@@ -189,39 +816,52 @@ void CodeGenerator::emitPrologueAndEpilogue() {
 	// Figure 3.4: Register Usage
 	// All XMM register which also includes the YMM register are caller saved.
 
+	const auto inputRegisters = integerFunctionInputRegisters();
+	auto moveArgument = [&](Reg64 destination, i64 argumentIndex) {
+		const auto source = inputRegisters[argumentIndex];
+		if (destination != source) {
+			a.mov(destination, source, offset());
+		}
+	};
+
+	std::vector<Reg64> registersToSave;
+	std::vector<Reg64> loopRegisters{ inputArrayRegister, outputArrayRegister, arraySizeRegister };
+	if (inputLayout != InputLayout::BLOCKS) {
+		loopRegisters.push_back(columnIndexRegister);
+	}
+	for (const auto reg : loopRegisters) {
+		if (isCalleeSavedRegister(reg)) {
+			registersToSave.push_back(reg);
+		}
+	}
+
+	// A leaf function that doesn't spill doesn't use the stack so it doesn't need a frame.
+	const auto needsStackFrame = callsFunctions || stackMemoryAllocated > 0;
+
 	const auto maxPossibleIncreaseCausedByAligning = 32;
+	const auto shadowSpaceSize = callsFunctions && callingConvention == CallingConvention::WINDOWS_X64
+		? SHADOW_SPACE_SIZE
+		: 0;
 
-	auto stackMemoryAllocatedTotal = maxPossibleIncreaseCausedByAligning + stackMemoryAllocated + SHADOW_SPACE_SIZE * 8;
+	auto stackMemoryAllocatedTotal = maxPossibleIncreaseCausedByAligning + stackMemoryAllocated + shadowSpaceSize;
 
-	//const Reg64 registerToSave[] = {
-	//	inputArrayRegister,
-	//	outputArrayRegister,
-	//	arraySizeRegister,
-	//	indexRegister
-	//};
 	i64 pushedMemory = 8;
 	auto push = [&](Reg64 reg) {
 		pushedMemory += 8;
 		a.push(reg, offset());
 	};
 
-	/*if (stackMemoryAllocatedTotal > 0)*/ {
+	if (needsStackFrame) {
 		push(Reg64::RBP);
+	}
+	for (const auto reg : registersToSave) {
+		push(reg);
+	}
+	moveArgument(inputArrayRegister, inputArrayRegisterArgumentIndex);
+	moveArgument(outputArrayRegister, outputArrayRegisterArgumentIndex);
+	moveArgument(arraySizeRegister, arraySizeRegisterArgumentIndex);
 
-		push(inputArrayRegister);
-		a.mov(inputArrayRegister, INTEGER_FUNCTION_INPUT_REGISTERS[inputArrayRegisterArgumentIndex], offset());
-
-		push(outputArrayRegister);
-		//a.push(outputArrayRegister, offset());
-		a.mov(outputArrayRegister, INTEGER_FUNCTION_INPUT_REGISTERS[outputArrayRegisterArgumentIndex], offset());
-
-		push(arraySizeRegister);
-		//a.push(arraySizeRegister, offset());
-		a.mov(arraySizeRegister, INTEGER_FUNCTION_INPUT_REGISTERS[arraySizeRegisterArgumentIndex], offset());
-
-		//a.push(indexRegister, offset());
-		push(indexRegister);
-
+	if (needsStackFrame) {
 		const auto requiredAlignment = 16;
 		const auto misalignment = pushedMemory % requiredAlignment;
 		stackMemoryAllocatedTotal += misalignment == 0 ? 0 : requiredAlignment - misalignment;
@@ -230,14 +870,13 @@ void CodeGenerator::emitPrologueAndEpilogue() {
 		a.and_(Reg8::BPL, 0b11100000, offset());
 
 		a.sub(Reg64::RSP, u32(stackMemoryAllocatedTotal), offset());
-	}
 
-	/*if (stackMemoryAllocated > 0)*/ {
 		a.add(Reg64::RSP, u32(stackMemoryAllocatedTotal));
-		a.pop(indexRegister);
-		a.pop(arraySizeRegister);
-		a.pop(outputArrayRegister);
-		a.pop(inputArrayRegister);
+	}
+	for (auto it = registersToSave.rbegin(); it != registersToSave.rend(); ++it) {
+		a.pop(*it);
+	}
+	if (needsStackFrame) {
 		a.pop(Reg64::RBP);
 	}
 	// Prevent expensive transitions. Read agner.
@@ -271,7 +910,7 @@ RegYmm CodeGenerator::allocateRegister(std::span<const Register> virtualRegister
 	RegYmm virtualRegisterThatIsNotUsedForLongestFromNowRegisterLocation;
 	i64 maxDistance = -1;
 
-	for (u8 actualRegisterIndex = 0; actualRegisterIndex < i64(std::size(registerAllocations)); actualRegisterIndex++) {
+	for (u8 actualRegisterIndex = 0; actualRegisterIndex < allocatableYmmRegisterCount(); actualRegisterIndex++) {
 		const auto actualRegister = regYmmFromIndex(actualRegisterIndex);
 		const auto optVirtualRegister = registerAllocations[actualRegisterIndex];
 
@@ -281,7 +920,7 @@ RegYmm CodeGenerator::allocateRegister(std::span<const Register> virtualRegister
 		const auto virtualRegister = *optVirtualRegister;
 
 		const auto lastUsage = registerToLastUsage[virtualRegister];
-		if (std::ranges::contains(virtualRegistersThatCanNotBeSpilled, virtualRegister)) {
+		if (std::ranges::find(virtualRegistersThatCanNotBeSpilled, virtualRegister) != virtualRegistersThatCanNotBeSpilled.end()) {
 			continue;
 		}
 
@@ -308,6 +947,8 @@ RegYmm CodeGenerator::allocateRegister(std::span<const Register> virtualRegister
 	}
 
 	const auto baseOffset = stackAllocate(YMM_REGISTER_SIZE, YMM_REGISTER_ALIGNMENT);
+	spillCount++;
+	spillBytes += YMM_REGISTER_SIZE;
 	virtualRegisterToSpillLocation.memoryLocation = baseOffset.location();
 	a.vmovaps(STACK_BASE_REGISTER, baseOffset.baseOffset, virtualRegisterToSpillRegisterLocation);
 	return virtualRegisterToSpillRegisterLocation;
@@ -316,8 +957,7 @@ RegYmm CodeGenerator::allocateRegister(std::span<const Register> virtualRegister
 void CodeGenerator::loadConstantOp(const LoadConstantOp& op) {
 	const auto destination = getRegisterLocation(op.destination);
 	//loadRegYmmConstant32(destination, op.constant);
-	const auto label = a.allocateData(op.constant);
-	a.vbroadcastss(destination, label);
+	broadcastConstant(destination, op.constant);
 	virtualRegisterToLocation[op.destination].memoryLocation = ConstantLocation{
 		.value = op.constant
 	};
@@ -328,11 +968,16 @@ void CodeGenerator::generate(const LoadVariableOp& op) {
 	const auto destination = getRegisterLocation(op.destination);
 
 	auto& location = virtualRegisterToLocation[op.destination];
-	const auto offset = op.variableIndex * YMM_REGISTER_SIZE;
-	location.memoryLocation = RegisterConstantOffsetLocation{
-		.registerWithAddress = inputArrayRegister,
-		.offset = offset,
-	};
+	if (const auto uniformBaseOffset = variableIndexToUniformBaseOffset[op.variableIndex]; uniformBaseOffset.has_value()) {
+		location.memoryLocation = BaseOffset{ .baseOffset = *uniformBaseOffset }.location();
+	} else if (const auto gridDimension = variableIndexToGridDimension[op.variableIndex]; gridDimension.has_value()) {
+		location.memoryLocation = BaseOffset{ .baseOffset = gridDimensionLocations[*gridDimension].coordinates }.location();
+	} else {
+		location.memoryLocation = RegisterConstantOffsetLocation{
+			.registerWithAddress = inputArrayRegister,
+			.offset = *variableIndexToInputIndex[op.variableIndex] * YMM_REGISTER_SIZE,
+		};
+	}
 	location.registerLocation = destination;
 	movToYmmFromMemoryLocation(destination, *location.memoryLocation);
 
@@ -351,7 +996,11 @@ void CodeGenerator::addOp(const AddOp& op) {
 	const auto destination = getRegisterLocation(op.destination, reserved);
 	const auto lhs = getRegisterLocation(op.lhs, reserved);
 	const auto rhs = getRegisterLocation(op.rhs, reserved);
-	a.vaddps(destination, lhs, rhs);
+	if (precision == Precision::F32) {
+		a.vaddps(destination, lhs, rhs);
+	} else {
+		a.vaddpd(destination, lhs, rhs);
+	}
 }
 
 void CodeGenerator::subtractOp(const SubtractOp& op) {
@@ -359,7 +1008,11 @@ void CodeGenerator::subtractOp(const SubtractOp& op) {
 	const auto destination = getRegisterLocation(op.destination, reserved);
 	const auto lhs = getRegisterLocation(op.lhs, reserved);
 	const auto rhs = getRegisterLocation(op.rhs, reserved);
-	a.vsubps(destination, lhs, rhs);
+	if (precision == Precision::F32) {
+		a.vsubps(destination, lhs, rhs);
+	} else {
+		a.vsubpd(destination, lhs, rhs);
+	}
 }
 
 void CodeGenerator::multiplyOp(const MultiplyOp& op) {
@@ -367,7 +1020,11 @@ void CodeGenerator::multiplyOp(const MultiplyOp& op) {
 	const auto destination = getRegisterLocation(op.destination, reserved);
 	const auto lhs = getRegisterLocation(op.lhs, reserved);
 	const auto rhs = getRegisterLocation(op.rhs, reserved);
-	a.vmulps(destination, lhs, rhs);
+	if (precision == Precision::F32) {
+		a.vmulps(destination, lhs, rhs);
+	} else {
+		a.vmulpd(destination, lhs, rhs);
+	}
 }
 
 void CodeGenerator::divideOp(const DivideOp& op) {
@@ -375,7 +1032,11 @@ void CodeGenerator::divideOp(const DivideOp& op) {
 	const auto destination = getRegisterLocation(op.destination, reserved);
 	const auto lhs = getRegisterLocation(op.lhs, reserved);
 	const auto rhs = getRegisterLocation(op.rhs, reserved);
-	a.vdivps(destination, lhs, rhs);
+	if (precision == Precision::F32) {
+		a.vdivps(destination, lhs, rhs);
+	} else {
+		a.vdivpd(destination, lhs, rhs);
+	}
 }
 
 void CodeGenerator::generate(const XorOp& op) {
@@ -391,8 +1052,8 @@ void CodeGenerator::generate(const NegateOp& op) {
 	const Register reserved[] = { op.operand, op.destination };
 	const auto destination = getRegisterLocation(op.destination, reserved);
 	const auto operand = getRegisterLocation(op.operand, reserved);
-	const auto dataLabel = a.allocateData(std::bit_cast<float>(F32_SIGN_MASK));
-	a.vbroadcastss(destination, dataLabel);
+	// Only the sign bit of -0 is set in both precisions.
+	broadcastConstant(destination, -0.0);
 	a.vxorps(destination, destination, operand);
 }
 
@@ -430,7 +1091,7 @@ void CodeGenerator::generate(const FunctionOp& op) {
 			continue;
 		}
 		const auto& location = locationIt->second;
-		const auto vectorCallPassByValueInRegister = i < 6;
+		const auto vectorCallPassByValueInRegister = i < simdArgumentRegisterCount();
 
 		if (location.registerLocation.has_value()) {
 			if (vectorCallPassByValueInRegister) {
@@ -463,11 +1124,15 @@ void CodeGenerator::generate(const FunctionOp& op) {
 		ASSERT_NOT_REACHED();
 		return;
 	}
+	const auto address = precision == Precision::F32 ? functionInfo->address : functionInfo->addressF64;
+	ASSERT(address != nullptr);
 	// Can't use RIP relative jumps because they take 32 bit signed operands. I tried and the OS allocates memory that is more than 2^31 bytes away from the other function pointers.
-	a.mov(Reg64::R9, std::bit_cast<u64>(functionInfo->address));
+	a.movFunctionAddress(Reg64::R9, std::bit_cast<u64>(address), functionInfo - functions.begin());
 	a.call(Reg64::R9);
+	tailMaskLoaded = false;
 
 	const auto destination = getRegisterLocation(op.destination);
+	// Both vectorcall and System V return __m256 in ymm0.
 	const auto VECTORCALL_RETURN_REGISTER_0 = RegYmm::YMM0;
 	movToYmmFromYmm(destination, VECTORCALL_RETURN_REGISTER_0);
 
@@ -478,7 +1143,11 @@ void CodeGenerator::generate(const FunctionOp& op) {
 
 void CodeGenerator::returnOp(const ReturnOp& op) {
 	const auto source = getRegisterLocation(op.returnedRegister);
-	a.vmovaps(outputArrayRegister, 0, source);
+	if (reduction != Reduction::NONE) {
+		reduce(source);
+		return;
+	}
+	storeOutput(op.outputIndex, source);
 }
 
 CodeGenerator::BaseOffset CodeGenerator::stackAllocate(i32 size, i32 aligment) {
@@ -4,6 +4,7 @@
 #include "input.hpp"
 //#include "assemblyCode.hpp"
 #include "machineCode.hpp"
+#include "callingConvention.hpp"
 #include <unordered_map>
 #include <unordered_set>
 #include <span>
@@ -27,22 +28,25 @@
 /*
 
 void perform_calculations(const float* input, float* output);
+void perform_calculations_masked(const float* input, float* output, i64 count);
 
 extern const i64 INPUT_BATCH_SIZE;
 extern const i64 OUTPUT_BATCH_SIZE;
 
-void function(const float* input, float* output, i64 outputBatchCount) {
-	for (i64 i = 0; i < outputBatchCount; i++) {
+void function(const float* input, float* output, i64 elementCount) {
+	for (; elementCount >= 8; elementCount -= 8) {
 		perform_calculations(input, output);
 
 		input += INPUT_BATCH_SIZE;
 		output += OUTPUT_BATCH_SIZE;
 	}
+	if (elementCount > 0) {
+		perform_calculations_masked(input, output, elementCount);
+	}
 }
 */
 
 /*
-mov some_free_register, 0 // Could do this using xor
 jmp loop_check
 loop_start:
 
@@ -50,10 +54,16 @@ loop_start:
 
 add integer_input_register[0], INPUT_BATCH_SIZE
 add integer_input_register[1], OUTPUT_BATCH_SIZE
-inc some_free_register
+sub integer_input_register[2], 8
 loop_check:
-cmp some_free_register, integer_input_register[2]
-jl loop_start
+cmp integer_input_register[2], 8
+jge loop_start
+
+cmp integer_input_register[2], 0
+jle end
+// load the mask for the remaining elements
+// loop content with masked loads and stores
+end:
 ret
 
 */
@@ -62,6 +72,38 @@ ret
 // Could emit struct instead of emiting code directly so the assembly could be optimized using peephole optimization.
 // The patching of jumps would still need to work the way it is currently implemented, because if there is a forward jump then the relative distance is still unknown so the jump must be patched after all the code is emmited.
 
+// BLOCKS: void(const float* input, float* output, i64 elementCount, const float* uniforms)
+// The input contains 8 values of the first variable, then 8 values of the second variable and so on. The output has the same layout with a value for each ReturnOp.
+// COLUMNS: void(const float* const* columns, float* const* outputs, i64 elementCount, const float* uniforms)
+// columns[i] points to the values of the variable i and outputs[i] to the values of the output i.
+// GRID: void(const void* unused, float* const* outputs, i64 elementCount, const float* uniforms)
+// Evaluates a whole grid of up to 3 dimensions stored in row major order. The non uniform variables are the coordinates along the dimensions (x, y, z) and they are generated in the kernel. Each lane keeps the indices of its element along the dimensions and every iteration adds the increments to them, wrapping the lower dimensions into the higher ones like the digits of a mixed radix number. The coordinate along the dimension d is origin[d] + index[d] * step[d].
+// The uniforms array contains the uniform variables followed by GRID_UNIFORMS_PER_DIMENSION values for each dimension (origin, step, size and the increment of the index per iteration) and then the 8 indices of the first elements for each dimension. The outputs are the same as in the COLUMNS layout.
+// The uniform variables are skipped when numbering the variables in the input. uniforms[i] is the value of the i-th uniform variable.
+enum class InputLayout {
+	BLOCKS,
+	COLUMNS,
+	GRID,
+};
+static constexpr i64 GRID_UNIFORMS_PER_DIMENSION = 4;
+
+// A kernel compiled with a reduction doesn't write the outputs. Instead it combines the values of its only output into 8 partial results, one for each lane, and writes a ReductionPartials to the output argument. The partials are combined into a single value by the caller so the result doesn't depend on how the input is split between calls.
+enum class Reduction {
+	NONE,
+	SUM,
+	MEAN,
+	MIN,
+	MAX,
+	ARGMIN,
+	ARGMAX,
+};
+
+struct ReductionPartials {
+	float values[8];
+	// Only written by ARGMIN and ARGMAX. The index of the element relative to the start of the call or -1 if the lane hasn't found any element. NaNs are never selected.
+	i32 indices[8];
+};
+
 // TODO: Maybe make a function that just returns the lower part of a register64 and return a register32 with error checking.
 struct CodeGenerator {
 	/*
@@ -72,20 +114,47 @@ struct CodeGenerator {
 	rdi, rsi, rdx, rcx, r8, r9
 	*/
 
-	static constexpr Reg64 INTEGER_FUNCTION_INPUT_REGISTERS[]{
+	static constexpr Reg64 WINDOWS_INTEGER_FUNCTION_INPUT_REGISTERS[]{
 		Reg64::RCX,
 		Reg64::RDX,
 		Reg64::R8,
 		Reg64::R9,
 	};
 
-	CodeGenerator();
-	void initialize(std::span<const Variable> parameters, std::span<const FunctionInfo> functions);
+	static constexpr Reg64 SYSTEM_V_INTEGER_FUNCTION_INPUT_REGISTERS[]{
+		Reg64::RDI,
+		Reg64::RSI,
+		Reg64::RDX,
+		Reg64::RCX,
+		Reg64::R8,
+		Reg64::R9,
+	};
+
+	// vectorcall passes the first 6 vector arguments in registers and System V the first 8.
+	static constexpr i64 VECTORCALL_SIMD_ARGUMENT_REGISTER_COUNT = 6;
+	static constexpr i64 SYSTEM_V_SIMD_ARGUMENT_REGISTER_COUNT = 8;
+
+	CodeGenerator(CallingConvention callingConvention = HOST_CALLING_CONVENTION);
+	void initialize(std::span<const Variable> parameters, std::span<const FunctionInfo> functions, InputLayout inputLayout, Reduction reduction, Precision precision, std::span<const ElementType> outputTypes);
 
-	const MachineCode& compile(
+	// The generator can be reused, but it can only compile one function at a time.
+	MachineCode compile(
 		const std::vector<IrOp>& irCode, 
 		std::span<const FunctionInfo> functions,
-		std::span<const Variable> parameters);
+		std::span<const Variable> parameters,
+		InputLayout inputLayout = InputLayout::BLOCKS,
+		Reduction reduction = Reduction::NONE,
+		Precision precision = Precision::F32,
+		std::span<const ElementType> outputTypes = {});
+	// Generates the assembly into a without encoding it. compile() is generateAssembly() followed by MachineCode::generateFrom(a).
+	void generateAssembly(
+		const std::vector<IrOp>& irCode,
+		std::span<const FunctionInfo> functions,
+		std::span<const Variable> parameters,
+		InputLayout inputLayout = InputLayout::BLOCKS,
+		Reduction reduction = Reduction::NONE,
+		Precision precision = Precision::F32,
+		std::span<const ElementType> outputTypes = {});
 
 	// Emmiting jumps after the code has been generated is can be difficult in some situations.
 	/*
@@ -104,8 +173,97 @@ struct CodeGenerator {
 	i64 currentInstructionIndex = 0;
 
 	std::span<const Variable> parameters;
+	InputLayout inputLayout;
+	// F64 code only supports the BLOCKS and COLUMNS layouts without a reduction. The arrays have the same layout with 4 doubles in place of 8 floats.
+	Precision precision;
+	i64 elementsPerYmm() const;
+	// outputTypes[i] is the type of the output i. The outputs that aren't in the span are F32.
+	std::span<const ElementType> outputTypes;
+	ElementType outputType(i64 outputIndex) const;
+	// Only the COLUMNS layout with F32 precision and without a reduction supports types other than F32.
+	// The code converts the whole vectors in registers, so it doesn't generate the masked tail and only processes the multiple of 8 elements that is less than or equal to the element count. LoopFunction computes the remaining elements using padded copies.
+	bool hasTypedColumns;
+
+	void assignVariableLocations();
+	// Only one of these is set for each variable. The grid coordinates have neither.
+	std::vector<std::optional<i64>> variableIndexToInputIndex;
+	std::vector<std::optional<i64>> variableIndexToUniformIndex;
+	i64 inputVariableCount;
+	i64 outputCount;
+	// The uniforms are broadcast once before the loop and stored on the stack so the allocator can reload them like spilled registers.
+	std::vector<std::optional<i32>> variableIndexToUniformBaseOffset;
+	void broadcastUniforms();
+
+	std::vector<std::optional<i64>> variableIndexToGridDimension;
+	i64 gridDimensionCount;
+	i64 gridFirstUniformIndex;
+	// The indices and coordinates of the current 8 elements are computed at the end of each iteration and stored on the stack like the uniforms.
+	struct GridDimensionLocations {
+		i32 indices;
+		i32 origin;
+		i32 step;
+		i32 size;
+		i32 increment;
+		i32 coordinates;
+	};
+	std::vector<GridDimensionLocations> gridDimensionLocations;
+	void initializeGridCoordinates();
+	void advanceGridCoordinates();
+	void computeGridCoordinates(const GridDimensionLocations& locations, RegYmm indices, RegYmm temp);
+	// Only windows requires the caller to allocate the shadow space.
 	static constexpr i64 SHADOW_SPACE_SIZE = 32;
 
+	CallingConvention callingConvention;
+	std::span<const Reg64> integerFunctionInputRegisters() const;
+	i64 simdArgumentRegisterCount() const;
+	bool isCalleeSavedRegister(Reg64 reg) const;
+
+	// If the code doesn't call any functions the arguments can stay in the volatile registers they were passed in so nothing needs to be saved.
+	bool callsFunctions;
+	void chooseLoopRegisters(const std::vector<IrOp>& irCode);
+	Reg64 inputArrayRegister;
+	Reg64 outputArrayRegister;
+	Reg64 arraySizeRegister;
+	// With the COLUMNS and GRID layouts the column pointers stay the same and the index of the current element scaled by the size of the elements is added to them.
+	Reg64 columnIndexRegister;
+	// Holds the address of the column while loading it.
+	static constexpr Reg64 COLUMN_ADDRESS_REGISTER = Reg64::R10;
+	void loadColumnAddress(Reg64 arrayRegister, i64 columnIndex, ElementType elementType);
+
+	void generateLoopBody(const std::vector<IrOp>& irCode);
+	void resetRegisterAllocation();
+
+	// The elements that don't fill a whole YMM register are computed by generating the loop body again with the loads and stores of the arrays replaced with masked ones. The masked instructions don't access the masked out elements so the arrays don't need any padding.
+	// The mask is kept in the highest register that isn't reserved for the reduction.
+	RegYmm tailMaskRegisterLocation() const;
+	bool generatingTail;
+	// If the code calls functions the mask is also stored on the stack, because the calls overwrite the mask register.
+	i32 tailMaskBaseOffset;
+	bool tailMaskLoaded;
+	RegYmm tailMaskRegister();
+	void emitTailMask();
+	void loadVariable(RegYmm destination, i64 inputIndex);
+	void storeOutput(i64 outputIndex, RegYmm source);
+	i64 allocatableYmmRegisterCount() const;
+	// The code with typed columns doesn't have a tail so the register of the tail mask and the one below it hold the temporary values of the conversions.
+	RegYmm conversionScratchRegister() const;
+	RegYmm secondConversionScratchRegister() const;
+
+	// The accumulators are kept in the highest registers for the whole loop.
+	Reduction reduction;
+	static constexpr RegYmm REDUCTION_VALUES_REGISTER = RegYmm::YMM15;
+	static constexpr RegYmm REDUCTION_TEMP_REGISTER = RegYmm::YMM14;
+	// The indices of the current elements and the indices of the values in REDUCTION_VALUES_REGISTER. Stored as i32.
+	static constexpr RegYmm REDUCTION_ELEMENT_INDICES_REGISTER = RegYmm::YMM13;
+	static constexpr RegYmm REDUCTION_INDICES_REGISTER = RegYmm::YMM12;
+	bool isArgReduction() const;
+	i64 reductionReservedRegisterCount() const;
+	// If the code calls functions the accumulators are stored on the stack after each update, because the calls overwrite them.
+	std::vector<std::pair<RegYmm, i32>> reductionAccumulatorBaseOffsets;
+	void initializeReduction();
+	void reduce(RegYmm value);
+	void storeReductionPartials();
+
 	void computeRegisterLastUsage(const std::vector<IrOp>& irCode);
 	std::unordered_map<Register, i64> registerToLastUsage;
 
@@ -118,7 +276,7 @@ struct CodeGenerator {
 	};
 
 	struct ConstantLocation {
-		float value;
+		RealConstant value;
 	};
 	using MemoryLocation = std::variant<RegisterConstantOffsetLocation, ConstantLocation>;
 
@@ -128,7 +286,8 @@ struct CodeGenerator {
 		std::optional<RegYmm> registerLocation;
 	};
 
-	static constexpr i64 YMM_REGISTER_SIZE = 8 * sizeof(float);
+	static constexpr i64 ELEMENTS_PER_YMM = 8;
+	static constexpr i64 YMM_REGISTER_SIZE = ELEMENTS_PER_YMM * sizeof(float);
 	static constexpr i64 YMM_REGISTER_ALIGNMENT = YMM_REGISTER_SIZE;
 	static constexpr Reg64 STACK_BASE_REGISTER = Reg64::RBP;
 
@@ -138,6 +297,7 @@ struct CodeGenerator {
 
 	void movToYmmFromMemoryLocation(RegYmm destination, const MemoryLocation& memoryLocation);
 	void movToYmmFromYmm(RegYmm destination, RegYmm source);
+	void broadcastConstant(RegYmm destination, RealConstant value);
 
 	void emitPrologueAndEpilogue();
 	
@@ -164,6 +324,9 @@ struct CodeGenerator {
 	};
 	std::vector<StackAllocation> stackAllocations;
 	i32 stackMemoryAllocated;
+	// Registers stored to the stack because there were no free registers.
+	i64 spillCount;
+	i64 spillBytes;
 	struct BaseOffset {
 		i32 baseOffset;
 		RegisterConstantOffsetLocation location() const;
@@ -171,6 +334,5 @@ struct CodeGenerator {
 	BaseOffset stackAllocate(i32 size, i32 aligment);
 
 	AssemblyCode a;
-	MachineCode machineCodeOutput;
 	std::span<const FunctionInfo> functions;
 };
\ No newline at end of file
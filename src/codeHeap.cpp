@@ -0,0 +1,152 @@
+#include "codeHeap.hpp"
+#include "os/os.hpp"
+#include "utils/rounding.hpp"
+#include "utils/asserts.hpp"
+#include <algorithm>
+
+CodeHeap::CodeHeap(i64 regionSize)
+	: regionSize(roundUpToMultiple(regionSize, pageSize())) {}
+
+CodeHeap::~CodeHeap() {
+	for (const auto& region : regions) {
+		freeDualMappedPages(region.pages, region.size);
+	}
+}
+
+CodeHeap::Allocation CodeHeap::allocate(i64 size) {
+	std::lock_guard lock(mutex);
+	const auto sizeClass = roundUpToMultiple(std::max(size, i64(1)), ALLOCATION_ALIGNMENT);
+
+	u8* memory = nullptr;
+	Region* region = nullptr;
+
+	const auto freeList = freeLists.find(sizeClass);
+	if (freeList != freeLists.end() && !freeList->second.empty()) {
+		memory = freeList->second.back();
+		freeList->second.pop_back();
+		region = findRegion(memory);
+	} else {
+		for (auto& r : regions) {
+			if (r.bumpOffset + sizeClass <= r.size) {
+				region = &r;
+				memory = r.pages.executable + r.bumpOffset;
+				r.bumpOffset += sizeClass;
+				break;
+			}
+		}
+	}
+
+	if (memory == nullptr) {
+		memory = allocateFromNewRegion(sizeClass);
+		if (memory == nullptr) {
+			return Allocation{ .memory = nullptr, .writable = nullptr };
+		}
+		region = &regions.back();
+	}
+
+	ASSERT(region != nullptr);
+	region->liveBytes += sizeClass;
+	allocationToSize[memory] = sizeClass;
+	return allocationAt(*region, memory);
+}
+
+void CodeHeap::free(u8* memory) {
+	std::lock_guard lock(mutex);
+	const auto allocation = allocationToSize.find(memory);
+	if (allocation == allocationToSize.end()) {
+		ASSERT_NOT_REACHED();
+		return;
+	}
+	const auto size = allocation->second;
+	allocationToSize.erase(allocation);
+
+	const auto region = findRegion(memory);
+	if (region == nullptr) {
+		ASSERT_NOT_REACHED();
+		return;
+	}
+	region->liveBytes -= size;
+	if (region->liveBytes == 0) {
+		releaseRegion(*region);
+		return;
+	}
+	freeLists[size].push_back(memory);
+}
+
+float CodeHeap::Stats::fragmentation() const {
+	const auto freeBytes = freeListBytes + untouchedBytes;
+	if (freeBytes == 0) {
+		return 0.0f;
+	}
+	return float(freeListBytes) / float(freeBytes);
+}
+
+CodeHeap::Stats CodeHeap::stats() const {
+	std::lock_guard lock(mutex);
+	Stats stats{
+		.regionCount = i64(regions.size()),
+		.reservedBytes = 0,
+		.liveBytes = 0,
+		.liveAllocationCount = i64(allocationToSize.size()),
+		.freeListBytes = 0,
+		.untouchedBytes = 0,
+	};
+	for (const auto& region : regions) {
+		stats.reservedBytes += region.size;
+		stats.liveBytes += region.liveBytes;
+		stats.untouchedBytes += region.size - region.bumpOffset;
+	}
+	for (const auto& [sizeClass, blocks] : freeLists) {
+		stats.freeListBytes += sizeClass * i64(blocks.size());
+	}
+	return stats;
+}
+
+CodeHeap::Region* CodeHeap::findRegion(const u8* address) {
+	for (auto& region : regions) {
+		if (address >= region.pages.executable && address < region.pages.executable + region.size) {
+			return &region;
+		}
+	}
+	return nullptr;
+}
+
+CodeHeap::Allocation CodeHeap::allocationAt(const Region& region, const u8* memory) const {
+	const auto offset = memory - region.pages.executable;
+	return Allocation{ .memory = region.pages.executable + offset, .writable = region.pages.writable + offset };
+}
+
+u8* CodeHeap::allocateFromNewRegion(i64 size) {
+	// Functions bigger than the region size get a region of their own.
+	const auto newRegionSize = std::max(regionSize, roundUpToMultiple(size, pageSize()));
+	const auto pages = allocateDualMappedPages(newRegionSize);
+	if (pages.executable == nullptr) {
+		return nullptr;
+	}
+	regions.push_back(Region{
+		.pages = pages,
+		.size = newRegionSize,
+		.bumpOffset = size,
+		.liveBytes = 0,
+	});
+	return pages.executable;
+}
+
+void CodeHeap::releaseRegion(Region& region) {
+	const auto memory = region.pages.executable;
+	for (auto& [_, blocks] : freeLists) {
+		std::erase_if(blocks, [&](const u8* block) {
+			return block >= memory && block < memory + region.size;
+		});
+	}
+
+	// Keep the last region so that freeing and then compiling a single function doesn't allocate and free a region every time.
+	if (&region == &regions.back()) {
+		region.bumpOffset = 0;
+		return;
+	}
+
+	freeDualMappedPages(region.pages, region.size);
+	const auto index = &region - regions.data();
+	regions.erase(regions.begin() + index);
+}
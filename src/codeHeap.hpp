@@ -0,0 +1,65 @@
+#pragma once
+
+#include "utils/ints.hpp"
+#include "os/os.hpp"
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+
+// Packs many small functions into big executable regions instead of using a separate OS allocation (at least a page) for each one.
+// Memory is handed out by bumping a pointer inside the last region. Freed blocks are put into free lists per size class and reused by allocations of the same size class. A region that has no live allocations left is returned to the OS.
+// No mapping is both writable and executable. Each region is mapped twice, the code is written through the writable view and called through the executable view, so the protection is never changed and the functions in a region can run while other functions are written into it.
+// The member functions can be called from multiple threads.
+struct CodeHeap {
+	static constexpr i64 ALLOCATION_ALIGNMENT = 64;
+	static constexpr i64 DEFAULT_REGION_SIZE = 256 * 1024;
+
+	CodeHeap(i64 regionSize = DEFAULT_REGION_SIZE);
+	~CodeHeap();
+	CodeHeap(const CodeHeap&) = delete;
+	CodeHeap& operator=(const CodeHeap&) = delete;
+
+	struct Allocation {
+		// The address the code is called at and freed with.
+		u8* memory;
+		// The same memory mapped writable. The code has to be written through this address and followed by flushInstructionCache(memory, size).
+		u8* writable;
+	};
+	// Both addresses are nullptr if the OS allocation failed.
+	Allocation allocate(i64 size);
+	void free(u8* memory);
+
+	struct Stats {
+		i64 regionCount;
+		// Bytes allocated from the OS.
+		i64 reservedBytes;
+		i64 liveBytes;
+		i64 liveAllocationCount;
+		// Freed blocks that weren't reused yet.
+		i64 freeListBytes;
+		// Memory at the end of the regions that was never allocated.
+		i64 untouchedBytes;
+
+		// The part of the free memory that is in holes between live allocations.
+		float fragmentation() const;
+	};
+	Stats stats() const;
+
+	struct Region {
+		DualMappedPages pages;
+		i64 size;
+		i64 bumpOffset;
+		i64 liveBytes;
+	};
+	Region* findRegion(const u8* address);
+	Allocation allocationAt(const Region& region, const u8* memory) const;
+	u8* allocateFromNewRegion(i64 size);
+	void releaseRegion(Region& region);
+
+	i64 regionSize;
+	std::vector<Region> regions;
+	std::unordered_map<const u8*, i64> allocationToSize;
+	// Size class to freed blocks.
+	std::unordered_map<i64, std::vector<u8*>> freeLists;
+	mutable std::mutex mutex;
+};
@@ -0,0 +1,144 @@
+#include "compilationContext.hpp"
+
+std::optional<std::vector<IrOp>> CompilationContext::compileToIr(
+	std::span<const std::string_view> sources,
+	std::span<const Variable> variables,
+	std::span<const FunctionInfo> functions,
+	ScannerMessageReporter& scannerReporter,
+	ParserMessageReporter& parserReporter,
+	IrCompilerMessageReporter& irCompilerReporter,
+	Precision precision) {
+
+	stats = CompilationStats();
+	const auto collected = statsIfCollected();
+
+	compiler.initialize(variables, functions, &irCompilerReporter);
+	bool compiled = true;
+	for (const auto& source : sources) {
+		// Compile all the sources so that all the errors are reported.
+		const std::vector<Token>* tokens;
+		{
+			CompilationPhaseTimer timer(collected, CompilationStats::Phase::SCANNING);
+			tokens = &scanner.parse(source, functions, variables, scannerReporter);
+		}
+		std::optional<Ast> ast;
+		{
+			CompilationPhaseTimer timer(collected, CompilationStats::Phase::PARSING);
+			ast = parser.parse(*tokens, source, parserReporter);
+		}
+		stats.astArenaBytes += parser.astAllocator.bytesUsed();
+		if (!ast.has_value()) {
+			compiled = false;
+			continue;
+		}
+		CompilationPhaseTimer timer(collected, CompilationStats::Phase::IR_GENERATION);
+		compiled &= compiler.compileOutput(*ast);
+	}
+	if (!compiled) {
+		return std::nullopt;
+	}
+
+	std::vector<IrOp> a = compiler.generatedIrCode;
+	std::vector<IrOp> b;
+
+	std::vector<IrOp>* input = &a;
+	std::vector<IrOp>* output = &b;
+	auto swap = [&]() -> void {
+		std::swap(input, output);
+	};
+	auto result = [&]() -> const std::vector<IrOp>& {
+		return *input;
+	};
+
+	stats.irOpCountAfterIrGeneration = i64(input->size());
+
+	{
+		CompilationPhaseTimer timer(collected, CompilationStats::Phase::VALUE_NUMBERING);
+		valueNumbering.run(*input, variables, *output, precision);
+	}
+	swap();
+	stats.irOpCountAfterValueNumbering = i64(input->size());
+
+	{
+		CompilationPhaseTimer timer(collected, CompilationStats::Phase::DEAD_CODE_ELIMINATION);
+		deadCodeElimination.run(*input, variables, *output);
+	}
+	swap();
+	stats.irOpCountAfterDeadCodeElimination = i64(input->size());
+
+	return result();
+}
+
+MachineCode CompilationContext::generateMachineCode(
+	const std::vector<IrOp>& irCode,
+	std::span<const FunctionInfo> functions,
+	std::span<const Variable> variables,
+	InputLayout inputLayout,
+	Reduction reduction,
+	Precision precision,
+	std::span<const ElementType> outputTypes) {
+	const auto collected = statsIfCollected();
+	{
+		CompilationPhaseTimer timer(collected, CompilationStats::Phase::CODE_GENERATION);
+		codeGenerator.generateAssembly(irCode, functions, variables, inputLayout, reduction, precision, outputTypes);
+	}
+	MachineCode machineCode;
+	{
+		CompilationPhaseTimer timer(collected, CompilationStats::Phase::ASSEMBLY);
+		machineCode.generateFrom(codeGenerator.a);
+	}
+	stats.spillCount = codeGenerator.spillCount;
+	stats.spillBytes = codeGenerator.spillBytes;
+	stats.codeBytes = i64(machineCode.code.size());
+	stats.dataBytes = i64(machineCode.data.size());
+	return machineCode;
+}
+
+std::optional<std::vector<IrOp>> CompilationContext::compileToIr(
+	std::span<const std::string_view> sources,
+	std::span<const Variable> variables,
+	std::span<const FunctionInfo> functions,
+	Precision precision) {
+	resetErrors();
+	return compileToIr(sources, variables, functions, scannerReporter, parserReporter, irCompilerReporter, precision);
+}
+
+void CompilationContext::resetErrors() {
+	scannerReporter.reset();
+	parserReporter.reset();
+	irCompilerReporter.reset();
+}
+
+bool CompilationContext::hasErrors() const {
+	return !scannerReporter.errors.empty() || !parserReporter.errors.empty() || !irCompilerReporter.errors.empty();
+}
+
+CompilationStats* CompilationContext::statsIfCollected() {
+	return collectStats ? &stats : nullptr;
+}
+
+void CompilationContext::recordStats() {
+	if (collectStats) {
+		compilationStatsHistograms().record(stats);
+	}
+}
+
+CompilationContextPool::Handle CompilationContextPool::acquire() {
+	std::unique_ptr<CompilationContext> context;
+	{
+		std::lock_guard lock(mutex);
+		if (!freeContexts.empty()) {
+			context = std::move(freeContexts.back());
+			freeContexts.pop_back();
+		}
+	}
+	if (context == nullptr) {
+		context = std::make_unique<CompilationContext>();
+	}
+	return Handle(context.release(), Release{ .pool = this });
+}
+
+void CompilationContextPool::Release::operator()(CompilationContext* context) const {
+	std::lock_guard lock(pool->mutex);
+	pool->freeContexts.push_back(std::unique_ptr<CompilationContext>(context));
+}
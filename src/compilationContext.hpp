@@ -0,0 +1,78 @@
+#pragma once
+
+#include "scanner.hpp"
+#include "parser.hpp"
+#include "irCompiler.hpp"
+#include "valueNumbering.hpp"
+#include "deadCodeElimination.hpp"
+#include "codeGenerator.hpp"
+#include "listScannerMessageReporter.hpp"
+#include "listParserMessageReporter.hpp"
+#include "listIrCompilerMessageReporter.hpp"
+#include "compilationStats.hpp"
+#include <memory>
+#include <mutex>
+
+// Holds all the mutable state used while compiling a function. Multiple threads can compile at once if each one uses its own context. The function table and the variables are only read.
+// The results only reference the sources and not the context so the context can be reused right away.
+struct CompilationContext {
+	std::optional<std::vector<IrOp>> compileToIr(
+		std::span<const std::string_view> sources,
+		std::span<const Variable> variables,
+		std::span<const FunctionInfo> functions,
+		ScannerMessageReporter& scannerReporter,
+		ParserMessageReporter& parserReporter,
+		IrCompilerMessageReporter& irCompilerReporter,
+		Precision precision = Precision::F32);
+	// Reports the errors to the reporters of the context. They are cleared first.
+	std::optional<std::vector<IrOp>> compileToIr(
+		std::span<const std::string_view> sources,
+		std::span<const Variable> variables,
+		std::span<const FunctionInfo> functions,
+		Precision precision = Precision::F32);
+	// The precision has to be the same as the one the IR was compiled with.
+	MachineCode generateMachineCode(
+		const std::vector<IrOp>& irCode,
+		std::span<const FunctionInfo> functions,
+		std::span<const Variable> variables,
+		InputLayout inputLayout,
+		Reduction reduction,
+		Precision precision = Precision::F32,
+		std::span<const ElementType> outputTypes = {});
+	void resetErrors();
+	bool hasErrors() const;
+
+	// Returns nullptr if the stats aren't collected.
+	CompilationStats* statsIfCollected();
+	// Adds the stats to the process-wide histograms. Called after a function is compiled successfully.
+	void recordStats();
+
+	// compileToIr resets the stats and the following steps add to them, so after compiling a function they describe the whole compilation.
+	bool collectStats = false;
+	CompilationStats stats;
+
+	Scanner scanner;
+	Parser parser;
+	IrCompiler compiler;
+	LocalValueNumbering valueNumbering;
+	DeadCodeElimination deadCodeElimination;
+	CodeGenerator codeGenerator;
+
+	ListScannerMessageReporter scannerReporter;
+	ListParserMessageReporter parserReporter;
+	ListIrCompilerMessageReporter irCompilerReporter;
+};
+
+// Keeps the contexts so their allocations are reused. A thread acquires a context for the time it is compiling and it is returned to the pool when the handle is destroyed.
+// Thread safe. The handles can't outlive the pool.
+struct CompilationContextPool {
+	struct Release {
+		CompilationContextPool* pool;
+		void operator()(CompilationContext* context) const;
+	};
+	using Handle = std::unique_ptr<CompilationContext, Release>;
+	Handle acquire();
+
+	std::mutex mutex;
+	std::vector<std::unique_ptr<CompilationContext>> freeContexts;
+};
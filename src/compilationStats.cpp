@@ -0,0 +1,114 @@
+#include "compilationStats.hpp"
+#include "utils/asserts.hpp"
+#include <bit>
+#include <algorithm>
+
+const char* CompilationStats::phaseName(Phase phase) {
+	switch (phase) {
+		using enum Phase;
+	case SCANNING: return "scanning";
+	case PARSING: return "parsing";
+	case IR_GENERATION: return "IR generation";
+	case VALUE_NUMBERING: return "value numbering";
+	case DEAD_CODE_ELIMINATION: return "dead code elimination";
+	case CODE_GENERATION: return "code generation";
+	case ASSEMBLY: return "assembly";
+	case PLACEMENT: return "placement";
+	case COUNT: break;
+	}
+	ASSERT_NOT_REACHED();
+	return "";
+}
+
+i64 CompilationStats::totalNanoseconds() const {
+	i64 total = 0;
+	for (const auto nanoseconds : phaseNanoseconds) {
+		total += nanoseconds;
+	}
+	return total;
+}
+
+CompilationPhaseTimer::CompilationPhaseTimer(CompilationStats* stats, CompilationStats::Phase phase)
+	: stats(stats)
+	, phase(phase) {
+	if (stats != nullptr) {
+		start = std::chrono::steady_clock::now();
+	}
+}
+
+CompilationPhaseTimer::~CompilationPhaseTimer() {
+	if (stats == nullptr) {
+		return;
+	}
+	const auto elapsed = std::chrono::steady_clock::now() - start;
+	stats->phaseNanoseconds[i64(phase)] += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+}
+
+void CompilationStatsHistograms::Histogram::add(i64 value) {
+	value = std::max(value, i64(0));
+	const auto bucket = std::min(i64(std::bit_width(u64(value))), BUCKET_COUNT - 1);
+	buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+	sum_.fetch_add(value, std::memory_order_relaxed);
+}
+
+void CompilationStatsHistograms::Histogram::reset() {
+	for (auto& bucket : buckets) {
+		bucket.store(0, std::memory_order_relaxed);
+	}
+	sum_.store(0, std::memory_order_relaxed);
+}
+
+i64 CompilationStatsHistograms::Histogram::count() const {
+	i64 count = 0;
+	for (const auto& bucket : buckets) {
+		count += bucket.load(std::memory_order_relaxed);
+	}
+	return count;
+}
+
+i64 CompilationStatsHistograms::Histogram::sum() const {
+	return sum_.load(std::memory_order_relaxed);
+}
+
+i64 CompilationStatsHistograms::Histogram::percentile(double p) const {
+	const auto total = count();
+	if (total == 0) {
+		return 0;
+	}
+	const auto rank = std::max(i64(p * double(total) + 0.5), i64(1));
+	i64 seen = 0;
+	for (i64 i = 0; i < BUCKET_COUNT; i++) {
+		seen += buckets[i].load(std::memory_order_relaxed);
+		if (seen >= rank) {
+			return i == 0 ? 0 : (i64(1) << i) - 1;
+		}
+	}
+	return (i64(1) << (BUCKET_COUNT - 1)) - 1;
+}
+
+void CompilationStatsHistograms::record(const CompilationStats& stats) {
+	for (i64 i = 0; i < CompilationStats::PHASE_COUNT; i++) {
+		phaseNanoseconds[i].add(stats.phaseNanoseconds[i]);
+	}
+	totalNanoseconds.add(stats.totalNanoseconds());
+	irOpCount.add(stats.irOpCountAfterDeadCodeElimination);
+	spillCount.add(stats.spillCount);
+	codeBytes.add(stats.codeBytes);
+	astArenaBytes.add(stats.astArenaBytes);
+}
+
+void CompilationStatsHistograms::reset() {
+	for (auto& histogram : phaseNanoseconds) {
+		histogram.reset();
+	}
+	totalNanoseconds.reset();
+	irOpCount.reset();
+	spillCount.reset();
+	codeBytes.reset();
+	astArenaBytes.reset();
+}
+
+CompilationStatsHistograms& compilationStatsHistograms() {
+	static CompilationStatsHistograms histograms;
+	return histograms;
+}
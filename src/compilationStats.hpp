@@ -0,0 +1,83 @@
+#pragma once
+
+#include "utils/ints.hpp"
+#include <atomic>
+#include <chrono>
+
+// Measurements of a single compilation. Only collected when CompilationContext::collectStats is set.
+struct CompilationStats {
+	enum class Phase {
+		SCANNING,
+		PARSING,
+		IR_GENERATION,
+		VALUE_NUMBERING,
+		DEAD_CODE_ELIMINATION,
+		// Instruction selection and register allocation are done in a single pass so they are measured together.
+		CODE_GENERATION,
+		// Encoding the instructions and resolving the jumps.
+		ASSEMBLY,
+		// Allocating the memory in the code heap, copying the code and patching the data operands.
+		PLACEMENT,
+		COUNT
+	};
+	static constexpr i64 PHASE_COUNT = i64(Phase::COUNT);
+	static const char* phaseName(Phase phase);
+
+	i64 phaseNanoseconds[PHASE_COUNT] = {};
+	i64 totalNanoseconds() const;
+
+	i64 irOpCountAfterIrGeneration = 0;
+	i64 irOpCountAfterValueNumbering = 0;
+	i64 irOpCountAfterDeadCodeElimination = 0;
+
+	// Registers stored to the stack by CodeGenerator::allocateRegister. Both the loop body and the tail are counted.
+	i64 spillCount = 0;
+	i64 spillBytes = 0;
+
+	i64 codeBytes = 0;
+	i64 dataBytes = 0;
+	// The AST arena bytes used by all the sources.
+	i64 astArenaBytes = 0;
+};
+
+// Adds the time from construction to destruction to the phase. Does nothing if stats is nullptr.
+struct CompilationPhaseTimer {
+	CompilationPhaseTimer(CompilationStats* stats, CompilationStats::Phase phase);
+	~CompilationPhaseTimer();
+	CompilationPhaseTimer(const CompilationPhaseTimer&) = delete;
+	CompilationPhaseTimer& operator=(const CompilationPhaseTimer&) = delete;
+
+	CompilationStats* stats;
+	CompilationStats::Phase phase;
+	std::chrono::steady_clock::time_point start;
+};
+
+// Process-wide distributions of the collected stats. Can be updated from multiple threads.
+struct CompilationStatsHistograms {
+	// The bucket 0 counts the zero values and the bucket i counts the values in [2^(i-1), 2^i).
+	struct Histogram {
+		static constexpr i64 BUCKET_COUNT = 48;
+
+		void add(i64 value);
+		void reset();
+		i64 count() const;
+		i64 sum() const;
+		// Returns the upper bound of the bucket containing the percentile, so the result is at most 2 times too big.
+		i64 percentile(double p) const;
+
+		std::atomic<i64> buckets[BUCKET_COUNT] = {};
+		std::atomic<i64> sum_ = 0;
+	};
+
+	void record(const CompilationStats& stats);
+	void reset();
+
+	Histogram phaseNanoseconds[CompilationStats::PHASE_COUNT];
+	Histogram totalNanoseconds;
+	Histogram irOpCount;
+	Histogram spillCount;
+	Histogram codeBytes;
+	Histogram astArenaBytes;
+};
+
+CompilationStatsHistograms& compilationStatsHistograms();
@@ -0,0 +1,264 @@
+#include "cppCodeGenerator.hpp"
+#include "utils/overloaded.hpp"
+#include "utils/asserts.hpp"
+#include <set>
+#include <algorithm>
+#include <cmath>
+#include <bit>
+
+void CppCodeGenerator::initialize(std::ostream& output, std::span<const Variable> variables, std::span<const FunctionInfo> functions, InputLayout inputLayout) {
+	this->variables = variables;
+	this->functions = functions;
+	this->inputLayout = inputLayout;
+	this->out_ = &output;
+	indentation = 0;
+	generatingTail = false;
+}
+
+void CppCodeGenerator::compile(
+	std::ostream& output,
+	const std::vector<IrOp>& irCode,
+	std::span<const FunctionInfo> functions,
+	std::span<const Variable> variables,
+	std::string_view functionName,
+	InputLayout inputLayout) {
+
+	initialize(output, variables, functions, inputLayout);
+	if (inputLayout == InputLayout::GRID) {
+		ASSERT_NOT_REACHED();
+		return;
+	}
+	ASSERT(std::ranges::all_of(variables, [](const Variable& variable) {
+		return variable.isUniform || variable.elementType == ElementType::F32;
+	}));
+	assignVariableLocations();
+	outputCount = 0;
+	for (const auto& op : irCode) {
+		if (const auto returnOp = std::get_if<ReturnOp>(&op)) {
+			outputCount = std::max(outputCount, returnOp->outputIndex + 1);
+		}
+	}
+
+	out() << "#include <immintrin.h>\n";
+	out() << "#include <cstdint>\n";
+	out() << "#include \"simdFunctions.hpp\"\n\n";
+
+	out() << "extern \"C\" void " << functionName;
+	switch (inputLayout) {
+		using enum InputLayout;
+	case BLOCKS:
+		out() << "(const float* input, float* output, int64_t elementCount, const float* uniforms) {\n";
+		break;
+	case COLUMNS:
+		out() << "(const float* const* columns, float* const* outputs, int64_t elementCount, const float* uniforms) {\n";
+		break;
+	case GRID:
+		break;
+	}
+	indentation++;
+
+	for (i64 variableIndex = 0; variableIndex < i64(variables.size()); variableIndex++) {
+		if (const auto uniformIndex = variableIndexToUniformIndex[variableIndex]) {
+			outIndentation();
+			out() << "const __m256 u" << *uniformIndex << " = _mm256_set1_ps(uniforms[" << *uniformIndex << "]);\n";
+		}
+	}
+	if (inputLayout == InputLayout::COLUMNS) {
+		outIndentation();
+		out() << "int64_t offset = 0;\n";
+	}
+
+	outIndentation();
+	out() << "for (; elementCount >= 8; elementCount -= 8) {\n";
+	indentation++;
+	generatingTail = false;
+	generateLoopBody(irCode);
+	outIndentation();
+	if (inputLayout == InputLayout::BLOCKS) {
+		out() << "input += " << inputVariableCount * 8 << ";\n";
+		outIndentation();
+		out() << "output += " << outputCount * 8 << ";\n";
+	} else {
+		out() << "offset += 8;\n";
+	}
+	indentation--;
+	outIndentation();
+	out() << "}\n";
+
+	outIndentation();
+	out() << "if (elementCount > 0) {\n";
+	indentation++;
+	outIndentation();
+	out() << "const __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(int32_t(elementCount)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));\n";
+	generatingTail = true;
+	generateLoopBody(irCode);
+	indentation--;
+	outIndentation();
+	out() << "}\n";
+
+	indentation--;
+	out() << "}\n";
+}
+
+void CppCodeGenerator::assignVariableLocations() {
+	variableIndexToInputIndex.clear();
+	variableIndexToUniformIndex.clear();
+	inputVariableCount = 0;
+	i64 uniformCount = 0;
+	for (const auto& variable : variables) {
+		if (variable.isUniform) {
+			variableIndexToInputIndex.push_back(std::nullopt);
+			variableIndexToUniformIndex.push_back(uniformCount);
+			uniformCount++;
+		} else {
+			variableIndexToInputIndex.push_back(inputVariableCount);
+			variableIndexToUniformIndex.push_back(std::nullopt);
+			inputVariableCount++;
+		}
+	}
+}
+
+void CppCodeGenerator::generateLoopBody(const std::vector<IrOp>& irCode) {
+	// Ordered so the output doesn't depend on the hashing.
+	std::set<Register> usedRegisters;
+	for (const auto& op : irCode) {
+		callWithOutputRegisters(op, [&usedRegisters](Register r) {
+			usedRegisters.insert(r);
+		});
+	}
+	for (const auto& r : usedRegisters) {
+		outIndentation();
+		out() << "__m256 ";
+		outRegisterName(r);
+		out() << ";\n";
+	}
+
+	for (const auto& op : irCode) {
+		std::visit(overloaded{
+			[&](const auto& op) { generate(op); },
+		}, op);
+	}
+}
+
+void CppCodeGenerator::generate(const LoadConstantOp& op) {
+	outIndentation();
+	outRegisterEquals(op.destination);
+	const auto constant = float(op.constant);
+	if (std::isfinite(constant)) {
+		out() << "_mm256_set1_ps(";
+		outFloatLiteral(constant);
+		out() << ");\n";
+	} else {
+		out() << "_mm256_castsi256_ps(_mm256_set1_epi32(int32_t(0x" << std::hex << std::bit_cast<u32>(constant) << std::dec << "u)));\n";
+	}
+}
+
+void CppCodeGenerator::generate(const LoadVariableOp& op) {
+	outIndentation();
+	outRegisterEquals(op.destination);
+	if (const auto uniformIndex = variableIndexToUniformIndex[op.variableIndex]) {
+		out() << "u" << *uniformIndex << ";\n";
+		return;
+	}
+	const auto inputIndex = *variableIndexToInputIndex[op.variableIndex];
+	out() << (generatingTail ? "_mm256_maskload_ps(" : "_mm256_loadu_ps(");
+	if (inputLayout == InputLayout::BLOCKS) {
+		out() << "input + " << inputIndex * 8;
+	} else {
+		out() << "columns[" << inputIndex << "] + offset";
+	}
+	out() << (generatingTail ? ", mask);\n" : ");\n");
+}
+
+void CppCodeGenerator::generate(const AddOp& op) {
+	outIntrinsicBinaryOp(op.destination, op.lhs, op.rhs, "_mm256_add_ps");
+}
+
+void CppCodeGenerator::generate(const SubtractOp& op) {
+	outIntrinsicBinaryOp(op.destination, op.lhs, op.rhs, "_mm256_sub_ps");
+}
+
+void CppCodeGenerator::generate(const MultiplyOp& op) {
+	outIntrinsicBinaryOp(op.destination, op.lhs, op.rhs, "_mm256_mul_ps");
+}
+
+void CppCodeGenerator::generate(const DivideOp& op) {
+	outIntrinsicBinaryOp(op.destination, op.lhs, op.rhs, "_mm256_div_ps");
+}
+
+void CppCodeGenerator::generate(const ExponentiateOp&) {
+	// Not implemented by CodeGenerator either and powSimd is unfinished.
+	ASSERT_NOT_REACHED();
+}
+
+void CppCodeGenerator::generate(const XorOp& op) {
+	outIntrinsicBinaryOp(op.destination, op.lhs, op.rhs, "_mm256_xor_ps");
+}
+
+void CppCodeGenerator::generate(const NegateOp& op) {
+	outIndentation();
+	outRegisterEquals(op.destination);
+	out() << "_mm256_xor_ps(";
+	outRegisterName(op.operand);
+	out() << ", _mm256_set1_ps(-0.0f));\n";
+}
+
+void CppCodeGenerator::generate(const FunctionOp& op) {
+	outIndentation();
+	outRegisterEquals(op.destination);
+	out() << op.functionName << "Simd(";
+	for (usize i = 0; i < op.arguments.size(); i++) {
+		if (i != 0) {
+			out() << ", ";
+		}
+		outRegisterName(op.arguments[i]);
+	}
+	out() << ");\n";
+}
+
+void CppCodeGenerator::generate(const ReturnOp& op) {
+	outIndentation();
+	out() << (generatingTail ? "_mm256_maskstore_ps(" : "_mm256_storeu_ps(");
+	if (inputLayout == InputLayout::BLOCKS) {
+		out() << "output + " << op.outputIndex * 8;
+	} else {
+		out() << "outputs[" << op.outputIndex << "] + offset";
+	}
+	out() << (generatingTail ? ", mask, " : ", ");
+	outRegisterName(op.returnedRegister);
+	out() << ");\n";
+}
+
+void CppCodeGenerator::outRegisterName(Register reg) {
+	out() << "r" << reg;
+}
+
+void CppCodeGenerator::outRegisterEquals(Register reg) {
+	outRegisterName(reg);
+	out() << " = ";
+}
+
+void CppCodeGenerator::outIntrinsicBinaryOp(Register destination, Register lhs, Register rhs, const char* intrinsic) {
+	outIndentation();
+	outRegisterEquals(destination);
+	out() << intrinsic << '(';
+	outRegisterName(lhs);
+	out() << ", ";
+	outRegisterName(rhs);
+	out() << ");\n";
+}
+
+void CppCodeGenerator::outFloatLiteral(float value) {
+	// Hexadecimal literals are exact.
+	out() << std::hexfloat << value << std::defaultfloat << 'f';
+}
+
+void CppCodeGenerator::outIndentation() {
+	for (i64 i = 0; i < indentation; i++) {
+		out() << '\t';
+	}
+}
+
+std::ostream& CppCodeGenerator::out() {
+	return *out_;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "ir.hpp"
+#include "input.hpp"
+#include "codeGenerator.hpp"
+#include <span>
+#include <ostream>
+
+// Generates a C++ function using AVX2 intrinsics with the same signature and loop structure as the machine code of CodeGenerator, so it can be compiled ahead of time with an optimizing compiler or used as a baseline for the register allocator of CodeGenerator.
+// The function f is called as fSimd(...), which for the built in functions is declared in simdFunctions.hpp. The other functions have to be declared before the generated code.
+// Compilers contract multiplications and additions into fused multiply adds by default, so to get the same results as the JIT the code has to be compiled with -ffp-contract=off.
+// Only the BLOCKS and COLUMNS layouts are supported, the function doesn't do reductions and all the columns are F32.
+struct CppCodeGenerator {
+	void initialize(std::ostream& output, std::span<const Variable> variables, std::span<const FunctionInfo> functions, InputLayout inputLayout);
+
+	void compile(
+		std::ostream& output,
+		const std::vector<IrOp>& irCode,
+		std::span<const FunctionInfo> functions,
+		std::span<const Variable> variables,
+		std::string_view functionName,
+		InputLayout inputLayout = InputLayout::BLOCKS);
+
+	void assignVariableLocations();
+	// The uniform variables are broadcast once before the loop into u<uniform index>.
+	std::vector<std::optional<i64>> variableIndexToInputIndex;
+	std::vector<std::optional<i64>> variableIndexToUniformIndex;
+	i64 inputVariableCount;
+	i64 outputCount;
+
+	// The elements that don't fill a whole vector are computed by generating the loop body again with masked loads and stores.
+	void generateLoopBody(const std::vector<IrOp>& irCode);
+	bool generatingTail;
+
+	void generate(const LoadConstantOp& op);
+	void generate(const LoadVariableOp& op);
+	void generate(const AddOp& op);
+	void generate(const SubtractOp& op);
+	void generate(const MultiplyOp& op);
+	void generate(const DivideOp& op);
+	void generate(const ExponentiateOp& op);
+	void generate(const XorOp& op);
+	void generate(const NegateOp& op);
+	void generate(const FunctionOp& op);
+	void generate(const ReturnOp& op);
+
+	void outRegisterName(Register reg);
+	void outRegisterEquals(Register reg);
+	void outIntrinsicBinaryOp(Register destination, Register lhs, Register rhs, const char* intrinsic);
+	void outFloatLiteral(float value);
+	void outIndentation();
+
+	std::span<const Variable> variables;
+	std::span<const FunctionInfo> functions;
+	InputLayout inputLayout;
+	i64 indentation;
+	std::ostream* out_ = nullptr;
+	std::ostream& out();
+};
@@ -0,0 +1,51 @@
+#include "cpuFeatures.hpp"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+static void cpuid(u32 leaf, u32 subleaf, u32 registers[4]) {
+#ifdef _MSC_VER
+	int values[4];
+	__cpuidex(values, int(leaf), int(subleaf));
+	for (i64 i = 0; i < 4; i++) {
+		registers[i] = u32(values[i]);
+	}
+#else
+	__cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+static u32 computeCpuFeatures() {
+	u32 registers[4];
+	cpuid(0, 0, registers);
+	const auto maxLeaf = registers[0];
+
+	u32 features = 0;
+	cpuid(1, 0, registers);
+	const auto ecx1 = registers[2];
+	if (ecx1 & (1 << 28)) {
+		features |= CPU_FEATURE_AVX;
+	}
+	if (ecx1 & (1 << 12)) {
+		features |= CPU_FEATURE_FMA;
+	}
+	if (maxLeaf >= 7) {
+		cpuid(7, 0, registers);
+		const auto ebx7 = registers[1];
+		if (ebx7 & (1 << 5)) {
+			features |= CPU_FEATURE_AVX2;
+		}
+		if (ebx7 & (1 << 16)) {
+			features |= CPU_FEATURE_AVX512F;
+		}
+	}
+	return features;
+}
+
+u32 cpuFeatures() {
+	static const u32 features = computeCpuFeatures();
+	return features;
+}
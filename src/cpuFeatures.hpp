@@ -0,0 +1,14 @@
+#pragma once
+
+#include "utils/ints.hpp"
+
+// The instruction set extensions that matter for the generated code.
+enum CpuFeature : u32 {
+	CPU_FEATURE_AVX = 1 << 0,
+	CPU_FEATURE_AVX2 = 1 << 1,
+	CPU_FEATURE_FMA = 1 << 2,
+	CPU_FEATURE_AVX512F = 1 << 3,
+};
+
+// The features supported by the CPU running the process. Computed once.
+u32 cpuFeatures();
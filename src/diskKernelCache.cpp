@@ -0,0 +1,238 @@
+#include "diskKernelCache.hpp"
+#include "cpuFeatures.hpp"
+#include "os/os.hpp"
+#include "utils/fileIo.hpp"
+#include "utils/asserts.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+
+DiskKernelCache::DiskKernelCache(Runtime& runtime, const std::filesystem::path& directory)
+	: runtime(runtime)
+	, directory(directory / ("v" + std::to_string(FORMAT_VERSION))) {
+	std::error_code error;
+	std::filesystem::create_directories(this->directory, error);
+}
+
+std::optional<Runtime::LoopFunction> DiskKernelCache::compileFunction(
+	std::string_view source,
+	std::span<const Variable> variables,
+	InputLayout inputLayout,
+	Reduction reduction) {
+	const std::string_view sources[] = { source };
+	return compileFunction(sources, variables, inputLayout, reduction);
+}
+
+std::optional<Runtime::LoopFunction> DiskKernelCache::compileFunction(
+	std::span<const std::string_view> sources,
+	std::span<const Variable> variables,
+	InputLayout inputLayout,
+	Reduction reduction) {
+
+	const auto irCode = runtime.compileToIr(sources, variables);
+	if (!irCode.has_value()) {
+		return std::nullopt;
+	}
+	if (reduction != Reduction::NONE && (sources.size() != 1 || inputLayout == InputLayout::GRID)) {
+		ASSERT_NOT_REACHED();
+		return std::nullopt;
+	}
+
+	const auto key = computeKey(*irCode, variables, inputLayout, reduction);
+	const auto path = keyPath(key);
+	if (const auto file = readFile(path.string().c_str()); file.has_value()) {
+		auto machineCode = deserialize(*file, key);
+		if (machineCode.has_value()) {
+			stats.hits++;
+			return runtime.placeFunction(runtime.context, *machineCode, sources, variables, inputLayout, reduction);
+		}
+		stats.invalidFiles++;
+	}
+
+	stats.misses++;
+	const auto machineCode = runtime.context.generateMachineCode(*irCode, runtime.functions, variables, inputLayout, reduction);
+	write(path, serialize(key, machineCode));
+	return runtime.placeFunction(runtime.context, machineCode, sources, variables, inputLayout, reduction);
+}
+
+std::string DiskKernelCache::computeKey(
+	const std::vector<IrOp>& irCode,
+	std::span<const Variable> variables,
+	InputLayout inputLayout,
+	Reduction reduction) const {
+
+	std::string key;
+	auto appendI64 = [&key](i64 value) {
+		key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+	};
+	auto appendString = [&](std::string_view string) {
+		appendI64(i64(string.size()));
+		key.append(string);
+	};
+
+	appendI64(i64(irCode.size()));
+	for (const auto& op : irCode) {
+		appendI64(i64(op.index()));
+		callWithOutputRegisters(op, appendI64);
+		callWithInputRegisters(op, appendI64);
+		if (const auto loadConstant = std::get_if<LoadConstantOp>(&op)) {
+			appendI64(std::bit_cast<i64>(loadConstant->constant));
+		} else if (const auto loadVariable = std::get_if<LoadVariableOp>(&op)) {
+			appendI64(loadVariable->variableIndex);
+		} else if (const auto function = std::get_if<FunctionOp>(&op)) {
+			appendString(function->functionName);
+			appendI64(i64(function->arguments.size()));
+		} else if (const auto returnOp = std::get_if<ReturnOp>(&op)) {
+			appendI64(returnOp->outputIndex);
+		}
+	}
+
+	// The names don't change the code.
+	appendI64(i64(variables.size()));
+	for (const auto& variable : variables) {
+		key.push_back(char(variable.isUniform));
+		key.push_back(char(variable.elementType));
+	}
+	appendI64(i64(inputLayout));
+	appendI64(i64(reduction));
+	appendI64(i64(HOST_CALLING_CONVENTION));
+	appendI64(cpuFeatures());
+	return key;
+}
+
+std::filesystem::path DiskKernelCache::keyPath(std::string_view key) const {
+	// FNV-1a. The whole key is stored in the file so collisions are detected when reading.
+	u64 hash = 0xCBF29CE484222325;
+	for (const auto c : key) {
+		hash = (hash ^ u8(c)) * 0x100000001B3;
+	}
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.kernel", static_cast<unsigned long long>(hash));
+	return directory / name;
+}
+
+template<typename T>
+static void append(std::vector<u8>& output, const T& value) {
+	const auto bytes = reinterpret_cast<const u8*>(&value);
+	output.insert(output.end(), bytes, bytes + sizeof(T));
+}
+
+std::vector<u8> DiskKernelCache::serialize(std::string_view key, const MachineCode& machineCode) const {
+	std::vector<u8> file;
+	append(file, FileHeader{
+		.magic = FILE_MAGIC,
+		.version = FORMAT_VERSION,
+		.cpuFeatures = cpuFeatures(),
+		.keySize = i64(key.size()),
+		.codeSize = i64(machineCode.code.size()),
+		.dataSize = i64(machineCode.data.size()),
+		.ripRelativeDataOperandCount = i64(machineCode.ripRelativeDataOperands.size()),
+		.functionAddressOperandCount = i64(machineCode.functionAddressOperands.size()),
+	});
+	file.insert(file.end(), key.begin(), key.end());
+	file.insert(file.end(), machineCode.code.begin(), machineCode.code.end());
+	file.insert(file.end(), machineCode.data.begin(), machineCode.data.end());
+	for (const auto& operand : machineCode.ripRelativeDataOperands) {
+		append(file, operand);
+	}
+	for (const auto& operand : machineCode.functionAddressOperands) {
+		append(file, operand.operandCodeOffset);
+		const auto& name = runtime.functions[operand.functionIndex].name;
+		append(file, i64(name.size()));
+		file.insert(file.end(), name.begin(), name.end());
+	}
+	return file;
+}
+
+std::optional<MachineCode> DiskKernelCache::deserialize(std::span<const u8> file, std::string_view key) const {
+	i64 position = 0;
+	auto read = [&](void* destination, i64 size) -> bool {
+		if (size < 0 || size > i64(file.size()) - position) {
+			return false;
+		}
+		memcpy(destination, file.data() + position, size);
+		position += size;
+		return true;
+	};
+
+	FileHeader header;
+	if (!read(&header, sizeof(header))
+		|| header.magic != FILE_MAGIC
+		|| header.version != FORMAT_VERSION
+		|| header.cpuFeatures != cpuFeatures()
+		|| header.keySize != i64(key.size())) {
+		return std::nullopt;
+	}
+	std::string fileKey(key.size(), '\0');
+	if (!read(fileKey.data(), header.keySize) || fileKey != key) {
+		return std::nullopt;
+	}
+
+	MachineCode machineCode;
+	if (header.codeSize < 0 || header.dataSize < 0 || header.codeSize + header.dataSize > i64(file.size()) - position) {
+		return std::nullopt;
+	}
+	machineCode.code.resize(header.codeSize);
+	machineCode.data.resize(header.dataSize);
+	read(machineCode.code.data(), header.codeSize);
+	read(machineCode.data.data(), header.dataSize);
+
+	for (i64 i = 0; i < header.ripRelativeDataOperandCount; i++) {
+		MachineCode::RipRelativeDataOperand operand;
+		if (!read(&operand, sizeof(operand))
+			|| operand.operandCodeOffset < 0 || operand.operandCodeOffset + i64(sizeof(i32)) > header.codeSize
+			|| operand.dataOffset < 0 || operand.dataOffset >= header.dataSize) {
+			return std::nullopt;
+		}
+		machineCode.ripRelativeDataOperands.push_back(operand);
+	}
+
+	for (i64 i = 0; i < header.functionAddressOperandCount; i++) {
+		i64 operandCodeOffset;
+		i64 nameSize;
+		if (!read(&operandCodeOffset, sizeof(operandCodeOffset))
+			|| !read(&nameSize, sizeof(nameSize))
+			|| operandCodeOffset < 0 || operandCodeOffset + i64(sizeof(u64)) > header.codeSize) {
+			return std::nullopt;
+		}
+		std::string name(std::max(nameSize, i64(0)), '\0');
+		if (!read(name.data(), nameSize)) {
+			return std::nullopt;
+		}
+		const auto function = std::ranges::find_if(runtime.functions, [&](const FunctionInfo& f) { return f.name == name; });
+		if (function == runtime.functions.end()) {
+			return std::nullopt;
+		}
+		machineCode.functionAddressOperands.push_back(MachineCode::FunctionAddressOperand{
+			.operandCodeOffset = operandCodeOffset,
+			.functionIndex = function - runtime.functions.begin()
+		});
+	}
+	if (position != i64(file.size())) {
+		return std::nullopt;
+	}
+
+	std::vector<void*> addresses;
+	for (const auto& function : runtime.functions) {
+		addresses.push_back(function.address);
+	}
+	machineCode.patchFunctionAddresses(addresses);
+	return machineCode;
+}
+
+void DiskKernelCache::write(const std::filesystem::path& path, const std::vector<u8>& file) {
+	// Written to a temporary file first so other processes never read a partially written file.
+	auto temporaryPath = path;
+	temporaryPath += ".tmp" + std::to_string(processId());
+	if (!outputToFile(temporaryPath.string().c_str(), file)) {
+		stats.writeFailures++;
+		return;
+	}
+	std::error_code error;
+	std::filesystem::rename(temporaryPath, path, error);
+	if (error) {
+		std::filesystem::remove(temporaryPath, error);
+		stats.writeFailures++;
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "runtime.hpp"
+#include <filesystem>
+
+// Stores the machine code of compiled functions in a directory so it doesn't have to be generated again after the process restarts.
+// The sources are still compiled to IR, because the key is made from the optimized IR, the variables, the input layout, the reduction and the CPU features. Only the code generation is skipped.
+// A file holds the code, the data and the relocations: the rip relative data operands and the addresses of the called functions. The called functions are stored by name and resolved against the function table of the runtime when loading. Each format version uses its own subdirectory so incompatible files are never read.
+// Not thread safe, because the compilation context of the runtime is used.
+struct DiskKernelCache {
+	DiskKernelCache(Runtime& runtime, const std::filesystem::path& directory);
+
+	// The errors are reported through the reporters of the runtime.
+	std::optional<Runtime::LoopFunction> compileFunction(
+		std::string_view source,
+		std::span<const Variable> variables,
+		InputLayout inputLayout = InputLayout::BLOCKS,
+		Reduction reduction = Reduction::NONE);
+	std::optional<Runtime::LoopFunction> compileFunction(
+		std::span<const std::string_view> sources,
+		std::span<const Variable> variables,
+		InputLayout inputLayout = InputLayout::BLOCKS,
+		Reduction reduction = Reduction::NONE);
+
+	struct Stats {
+		i64 hits = 0;
+		i64 misses = 0;
+		// Files that exist but can't be used, because they are corrupted or call a function that is missing.
+		i64 invalidFiles = 0;
+		i64 writeFailures = 0;
+	};
+	Stats stats;
+
+	static constexpr u32 FORMAT_VERSION = 3;
+	static constexpr u64 FILE_MAGIC = 0x314C4E524B434D46; // "FMCKRNL1"
+
+	struct FileHeader {
+		u64 magic;
+		u32 version;
+		u32 cpuFeatures;
+		i64 keySize;
+		i64 codeSize;
+		i64 dataSize;
+		i64 ripRelativeDataOperandCount;
+		i64 functionAddressOperandCount;
+	};
+
+	std::string computeKey(
+		const std::vector<IrOp>& irCode,
+		std::span<const Variable> variables,
+		InputLayout inputLayout,
+		Reduction reduction) const;
+	std::filesystem::path keyPath(std::string_view key) const;
+	std::vector<u8> serialize(std::string_view key, const MachineCode& machineCode) const;
+	// Returns std::nullopt if the file doesn't match the key or can't be relocated. The function addresses are patched.
+	std::optional<MachineCode> deserialize(std::span<const u8> file, std::string_view key) const;
+	void write(const std::filesystem::path& path, const std::vector<u8>& file);
+
+	Runtime& runtime;
+	// Includes the version subdirectory.
+	std::filesystem::path directory;
+};
@@ -0,0 +1,98 @@
+#include "elfObjectExport.hpp"
+#include "elfWriter.hpp"
+#include "utils/asserts.hpp"
+#include <cstring>
+
+// Relocating the 64 bit immediates would require the dynamic linker to write to .text. The instructions are replaced with rip relative loads of the address of the function, which have the same size.
+// mov r64, imm64 (REX.W + B8+r, 10 bytes) -> lea r64, [rip + disp32] (REX.W + 8D /r, 7 bytes) + 3 byte nop
+// Returns the code offset of disp32.
+static i64 replaceFunctionAddressMovWithLea(std::vector<u8>& code, i64 operandCodeOffset) {
+	const auto instructionStart = operandCodeOffset - 2;
+	const auto rex = code[instructionStart];
+	const auto opCode = code[instructionStart + 1];
+	ASSERT((rex & 0xF8) == 0x48 && (opCode & 0xF8) == 0xB8);
+	const auto registerLow3Bits = u8(opCode & 0b111);
+	// The register is in modrm.rm for mov and in modrm.reg for lea so REX.B becomes REX.R.
+	const auto registerHighBit = u8(rex & 0b1);
+
+	u8 lea[] = {
+		u8(0x48 | (registerHighBit << 2)),
+		0x8D,
+		u8((registerLow3Bits << 3) | 0b101),
+		0, 0, 0, 0,
+		0x0F, 0x1F, 0x00,
+	};
+	memcpy(code.data() + instructionStart, lea, sizeof(lea));
+	return instructionStart + 3;
+}
+
+std::vector<u8> machineCodeToElfObject(const MachineCode& machineCode, std::span<const FunctionInfo> functions, std::string_view symbolName) {
+	auto code = machineCode.code;
+	std::vector<i64> functionAddressDisplacements;
+	for (const auto& operand : machineCode.functionAddressOperands) {
+		functionAddressDisplacements.push_back(replaceFunctionAddressMovWithLea(code, operand.operandCodeOffset));
+	}
+
+	ElfWriter elf;
+	const auto text = elf.addSection(
+		".text",
+		ElfWriter::SECTION_TYPE_PROGBITS,
+		ElfWriter::SECTION_FLAG_ALLOC | ElfWriter::SECTION_FLAG_EXECINSTR,
+		0,
+		16,
+		code);
+	const auto rodata = elf.addSection(
+		".rodata",
+		ElfWriter::SECTION_TYPE_PROGBITS,
+		ElfWriter::SECTION_FLAG_ALLOC,
+		0,
+		MachineCode::DATA_ALIGNMENT,
+		machineCode.data);
+	// Without this section the linker assumes that the object requires an executable stack.
+	elf.addSection(".note.GNU-stack", ElfWriter::SECTION_TYPE_PROGBITS, 0, 0, 1, {});
+
+	const auto rodataSymbol = elf.addSectionSymbol(rodata);
+	for (const auto& operand : machineCode.ripRelativeDataOperands) {
+		// The displacement is relative to the end of the 32 bit operand, which is the end of the instruction.
+		elf.addRelocation(text, operand.operandCodeOffset, rodataSymbol, ElfWriter::RelocationType::PC_RELATIVE_32, operand.dataOffset - i64(sizeof(i32)));
+	}
+
+	std::vector<i64> functionSymbols(functions.size(), -1);
+	for (i64 i = 0; i < i64(machineCode.functionAddressOperands.size()); i++) {
+		const auto& operand = machineCode.functionAddressOperands[i];
+		auto& symbol = functionSymbols[operand.functionIndex];
+		if (symbol == -1) {
+			symbol = elf.addUndefinedSymbol(functionSymbolName(functions[operand.functionIndex].name));
+		}
+		elf.addRelocation(text, functionAddressDisplacements[i], symbol, ElfWriter::RelocationType::PLT_32, -i64(sizeof(i32)));
+	}
+
+	elf.addFunctionSymbol(symbolName, text, 0, machineCode.code.size());
+	return elf.write(ElfWriter::FileType::RELOCATABLE);
+}
+
+std::optional<std::vector<u8>> compileToElfObject(
+	Runtime& runtime,
+	std::span<const std::string_view> sources,
+	std::span<const Variable> variables,
+	std::string_view symbolName,
+	InputLayout inputLayout,
+	Reduction reduction) {
+
+	const auto irCode = runtime.compileToIr(sources, variables);
+	if (!irCode.has_value()) {
+		return std::nullopt;
+	}
+	if (reduction != Reduction::NONE && (sources.size() != 1 || inputLayout == InputLayout::GRID)) {
+		ASSERT_NOT_REACHED();
+		return std::nullopt;
+	}
+	// The host might use a different calling convention.
+	CodeGenerator codeGenerator(CallingConvention::SYSTEM_V);
+	const auto machineCode = codeGenerator.compile(*irCode, runtime.functions, variables, inputLayout, reduction);
+	return machineCodeToElfObject(machineCode, runtime.functions, symbolName);
+}
+
+std::string functionSymbolName(std::string_view functionName) {
+	return "mathCompiler_" + std::string(functionName);
+}
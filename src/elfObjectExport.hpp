@@ -0,0 +1,23 @@
+#pragma once
+
+#include "runtime.hpp"
+
+// Ahead of time compilation. The functions are written as relocatable ELF object files so they can be linked into a program, which then doesn't need to generate code or have executable memory that is writable.
+// The code is placed in .text and the data in .rodata. The rip relative data operands are relocated against .rodata. The instructions loading the addresses of the called functions are replaced with rip relative loads relocated against the symbols named by functionSymbolName(), so .text never has to be written to when loading, even in position independent executables.
+// The function is exported as a global symbol with the signature of the kernels. For the block layout it is
+// extern "C" void symbol(const float* input, float* output, int64_t elementCount, const float* uniforms);
+// The code uses the System V calling convention, so the objects can only be linked on systems that use it.
+
+std::vector<u8> machineCodeToElfObject(const MachineCode& machineCode, std::span<const FunctionInfo> functions, std::string_view symbolName);
+
+// The errors are reported through the reporters of the runtime.
+std::optional<std::vector<u8>> compileToElfObject(
+	Runtime& runtime,
+	std::span<const std::string_view> sources,
+	std::span<const Variable> variables,
+	std::string_view symbolName,
+	InputLayout inputLayout = InputLayout::BLOCKS,
+	Reduction reduction = Reduction::NONE);
+
+// The symbol the generated code calls for the function. The built in functions are defined with these names in simdFunctionSymbols.cpp. Functions added to the runtime have to be defined by the program.
+std::string functionSymbolName(std::string_view functionName);
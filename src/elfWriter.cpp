@@ -0,0 +1,264 @@
+#include "elfWriter.hpp"
+#include "utils/rounding.hpp"
+#include "utils/asserts.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+#pragma pack(push, 1)
+struct ElfHeader {
+	u8 ident[16];
+	u16 type;
+	u16 machine;
+	u32 version;
+	u64 entry;
+	u64 programHeaderOffset;
+	u64 sectionHeaderOffset;
+	u32 flags;
+	u16 headerSize;
+	u16 programHeaderEntrySize;
+	u16 programHeaderCount;
+	u16 sectionHeaderEntrySize;
+	u16 sectionHeaderCount;
+	u16 sectionNameTableIndex;
+};
+
+struct ElfSectionHeader {
+	u32 name;
+	u32 type;
+	u64 flags;
+	u64 address;
+	u64 offset;
+	u64 size;
+	u32 link;
+	u32 info;
+	u64 alignment;
+	u64 entrySize;
+};
+
+struct ElfRelocation {
+	u64 offset;
+	u64 info;
+	i64 addend;
+};
+
+struct ElfSymbol {
+	u32 name;
+	u8 info;
+	u8 other;
+	u16 sectionIndex;
+	u64 value;
+	u64 size;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(ElfHeader) == 64);
+static_assert(sizeof(ElfSectionHeader) == 64);
+static_assert(sizeof(ElfSymbol) == 24);
+static_assert(sizeof(ElfRelocation) == 24);
+
+constexpr u16 MACHINE_X86_64 = 62;
+constexpr u32 SECTION_TYPE_SYMTAB = 2;
+constexpr u32 SECTION_TYPE_STRTAB = 3;
+constexpr u32 SECTION_TYPE_RELA = 4;
+// sh_info of the section holds the index of the section the relocations apply to.
+constexpr u64 SECTION_FLAG_INFO_LINK = 0x40;
+constexpr u8 SYMBOL_BINDING_LOCAL = 0;
+constexpr u8 SYMBOL_BINDING_GLOBAL = 1;
+
+struct StringTable {
+	StringTable() {
+		// Offset 0 is the empty string.
+		data.push_back(0);
+	}
+
+	u32 add(std::string_view string) {
+		const auto offset = u32(data.size());
+		data.insert(data.end(), string.begin(), string.end());
+		data.push_back(0);
+		return offset;
+	}
+
+	std::vector<u8> data;
+};
+
+template<typename T>
+void append(std::vector<u8>& output, const T& value) {
+	const auto bytes = reinterpret_cast<const u8*>(&value);
+	output.insert(output.end(), bytes, bytes + sizeof(T));
+}
+
+}
+
+i64 ElfWriter::addSection(std::string_view name, u32 type, u64 flags, u64 address, u64 alignment, std::span<const u8> data, u64 size) {
+	Section section{};
+	section.name = std::string(name);
+	section.type = type;
+	section.flags = flags;
+	section.address = address;
+	section.alignment = alignment;
+	section.size = type == SECTION_TYPE_NOBITS ? size : u64(data.size());
+	if (type != SECTION_TYPE_NOBITS) {
+		section.data.assign(data.begin(), data.end());
+	}
+	sections.push_back(std::move(section));
+	// The null section comes first.
+	return i64(sections.size());
+}
+
+i64 ElfWriter::addSymbol(std::string_view name, i64 sectionIndex, u64 value, u64 size, SymbolType type, bool global) {
+	symbols.push_back(Symbol{ .name = std::string(name), .sectionIndex = sectionIndex, .value = value, .size = size, .type = type, .global = global });
+	return i64(symbols.size()) - 1;
+}
+
+i64 ElfWriter::addFunctionSymbol(std::string_view name, i64 sectionIndex, u64 value, u64 size, bool global) {
+	return addSymbol(name, sectionIndex, value, size, SymbolType::FUNC, global);
+}
+
+i64 ElfWriter::addSectionSymbol(i64 sectionIndex) {
+	return addSymbol("", sectionIndex, 0, 0, SymbolType::SECTION, false);
+}
+
+i64 ElfWriter::addUndefinedSymbol(std::string_view name) {
+	return addSymbol(name, UNDEFINED_SECTION, 0, 0, SymbolType::NOTYPE, true);
+}
+
+void ElfWriter::addRelocation(i64 sectionIndex, u64 offset, i64 symbolIndex, RelocationType type, i64 addend) {
+	auto sectionRelocations = std::ranges::find_if(relocations, [&](const SectionRelocations& r) { return r.sectionIndex == sectionIndex; });
+	if (sectionRelocations == relocations.end()) {
+		relocations.push_back(SectionRelocations{ .sectionIndex = sectionIndex, .relocations = {} });
+		sectionRelocations = relocations.end() - 1;
+	}
+	sectionRelocations->relocations.push_back(Relocation{ .offset = offset, .symbolIndex = symbolIndex, .type = type, .addend = addend });
+}
+
+std::vector<u8> ElfWriter::write(FileType type) const {
+	StringTable sectionNames;
+	StringTable symbolNames;
+
+	// The local symbols have to come before the global ones. The index 0 is the null symbol.
+	std::vector<i64> orderedSymbols;
+	for (i64 i = 0; i < i64(symbols.size()); i++) {
+		orderedSymbols.push_back(i);
+	}
+	std::stable_partition(orderedSymbols.begin(), orderedSymbols.end(), [this](i64 i) { return !symbols[i].global; });
+	std::vector<i64> symbolIndexInTable(symbols.size());
+
+	std::vector<u8> symbolTable;
+	append(symbolTable, ElfSymbol{});
+	i64 firstGlobalSymbolIndex = 1;
+	for (i64 i = 0; i < i64(orderedSymbols.size()); i++) {
+		const auto& symbol = symbols[orderedSymbols[i]];
+		symbolIndexInTable[orderedSymbols[i]] = i + 1;
+		const auto binding = symbol.global ? SYMBOL_BINDING_GLOBAL : SYMBOL_BINDING_LOCAL;
+		ElfSymbol elfSymbol{};
+		elfSymbol.name = symbol.name.empty() ? 0 : symbolNames.add(symbol.name);
+		elfSymbol.info = u8((binding << 4) | u8(symbol.type));
+		elfSymbol.sectionIndex = u16(symbol.sectionIndex);
+		elfSymbol.value = symbol.value;
+		elfSymbol.size = symbol.size;
+		append(symbolTable, elfSymbol);
+		if (!symbol.global) {
+			firstGlobalSymbolIndex++;
+		}
+	}
+
+	const auto userSectionCount = i64(sections.size());
+	const auto relocationSectionCount = i64(relocations.size());
+	const auto firstRelocationSectionIndex = userSectionCount + 1;
+	const auto symbolTableIndex = firstRelocationSectionIndex + relocationSectionCount;
+	const auto symbolNamesIndex = symbolTableIndex + 1;
+	const auto sectionNamesIndex = symbolTableIndex + 2;
+	const auto sectionCount = symbolTableIndex + 3;
+
+	std::vector<ElfSectionHeader> headers(sectionCount);
+	std::vector<u8> output(sizeof(ElfHeader));
+	auto appendSectionData = [&](ElfSectionHeader& header, std::span<const u8> data, u64 alignment) {
+		output.resize(roundUpToMultiple(i64(output.size()), i64(std::max(alignment, u64(1)))));
+		header.offset = output.size();
+		output.insert(output.end(), data.begin(), data.end());
+	};
+
+	for (i64 i = 0; i < userSectionCount; i++) {
+		const auto& section = sections[i];
+		auto& header = headers[i + 1];
+		header.name = sectionNames.add(section.name);
+		header.type = section.type;
+		header.flags = section.flags;
+		header.address = section.address;
+		header.size = section.size;
+		header.alignment = section.alignment;
+		if (section.type == SECTION_TYPE_NOBITS) {
+			header.offset = output.size();
+		} else {
+			appendSectionData(header, section.data, section.alignment);
+		}
+	}
+
+	for (i64 i = 0; i < relocationSectionCount; i++) {
+		const auto& sectionRelocations = relocations[i];
+		std::vector<u8> data;
+		for (const auto& relocation : sectionRelocations.relocations) {
+			ElfRelocation elfRelocation{};
+			elfRelocation.offset = relocation.offset;
+			elfRelocation.info = (u64(symbolIndexInTable[relocation.symbolIndex]) << 32) | u64(relocation.type);
+			elfRelocation.addend = relocation.addend;
+			append(data, elfRelocation);
+		}
+		auto& header = headers[firstRelocationSectionIndex + i];
+		header.name = sectionNames.add(".rela" + sections[sectionRelocations.sectionIndex - 1].name);
+		header.type = SECTION_TYPE_RELA;
+		header.flags = SECTION_FLAG_INFO_LINK;
+		header.size = data.size();
+		header.link = u32(symbolTableIndex);
+		header.info = u32(sectionRelocations.sectionIndex);
+		header.alignment = 8;
+		header.entrySize = sizeof(ElfRelocation);
+		appendSectionData(header, data, 8);
+	}
+
+	auto& symbolTableHeader = headers[symbolTableIndex];
+	symbolTableHeader.name = sectionNames.add(".symtab");
+	symbolTableHeader.type = SECTION_TYPE_SYMTAB;
+	symbolTableHeader.size = symbolTable.size();
+	symbolTableHeader.link = u32(symbolNamesIndex);
+	symbolTableHeader.info = u32(firstGlobalSymbolIndex);
+	symbolTableHeader.alignment = 8;
+	symbolTableHeader.entrySize = sizeof(ElfSymbol);
+	appendSectionData(symbolTableHeader, symbolTable, 8);
+
+	auto& symbolNamesHeader = headers[symbolNamesIndex];
+	symbolNamesHeader.name = sectionNames.add(".strtab");
+	symbolNamesHeader.type = SECTION_TYPE_STRTAB;
+	symbolNamesHeader.size = symbolNames.data.size();
+	symbolNamesHeader.alignment = 1;
+	appendSectionData(symbolNamesHeader, symbolNames.data, 1);
+
+	auto& sectionNamesHeader = headers[sectionNamesIndex];
+	sectionNamesHeader.name = sectionNames.add(".shstrtab");
+	sectionNamesHeader.type = SECTION_TYPE_STRTAB;
+	sectionNamesHeader.size = sectionNames.data.size();
+	sectionNamesHeader.alignment = 1;
+	appendSectionData(sectionNamesHeader, sectionNames.data, 1);
+
+	output.resize(roundUpToMultiple(i64(output.size()), i64(8)));
+	const auto sectionHeaderOffset = output.size();
+	for (const auto& header : headers) {
+		append(output, header);
+	}
+
+	ElfHeader header{};
+	const u8 ident[] = { 0x7F, 'E', 'L', 'F', 2 /* 64 bit */, 1 /* little endian */, 1 /* version */ };
+	memcpy(header.ident, ident, sizeof(ident));
+	header.type = u16(type);
+	header.machine = MACHINE_X86_64;
+	header.version = 1;
+	header.sectionHeaderOffset = sectionHeaderOffset;
+	header.headerSize = sizeof(ElfHeader);
+	header.sectionHeaderEntrySize = sizeof(ElfSectionHeader);
+	header.sectionHeaderCount = u16(sectionCount);
+	header.sectionNameTableIndex = u16(sectionNamesIndex);
+	memcpy(output.data(), &header, sizeof(header));
+	return output;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "utils/ints.hpp"
+#include <vector>
+#include <string>
+#include <string_view>
+#include <span>
+
+// Builds x86-64 ELF64 files in memory. Only the parts needed to describe generated code are supported: sections, symbols and relocations.
+struct ElfWriter {
+	enum class FileType : u16 {
+		RELOCATABLE = 1,
+		EXECUTABLE = 2,
+	};
+
+	static constexpr u32 SECTION_TYPE_PROGBITS = 1;
+	// The section doesn't have any data in the file. Used to describe code that is already in memory.
+	static constexpr u32 SECTION_TYPE_NOBITS = 8;
+	static constexpr u64 SECTION_FLAG_WRITE = 0x1;
+	static constexpr u64 SECTION_FLAG_ALLOC = 0x2;
+	static constexpr u64 SECTION_FLAG_EXECINSTR = 0x4;
+
+	enum class SymbolType : u8 {
+		NOTYPE = 0,
+		OBJECT = 1,
+		FUNC = 2,
+		SECTION = 3,
+	};
+	// The section index of undefined symbols.
+	static constexpr i64 UNDEFINED_SECTION = 0;
+
+	// S is the value of the symbol, A the addend and P the address of the relocated field.
+	enum class RelocationType : u32 {
+		// S + A, 64 bits.
+		ABSOLUTE_64 = 1,
+		// S + A - P, 32 bits.
+		PC_RELATIVE_32 = 2,
+		// L + A - P, 32 bits, where L is the address of the procedure linkage table entry of the symbol or the symbol itself if it is linked statically.
+		PLT_32 = 4,
+	};
+
+	// Returns the index of the section. For NOBITS sections data is ignored and size is used instead.
+	i64 addSection(std::string_view name, u32 type, u64 flags, u64 address, u64 alignment, std::span<const u8> data, u64 size = 0);
+	// The functions adding symbols return the index that is used to refer to them in relocations.
+	i64 addSymbol(std::string_view name, i64 sectionIndex, u64 value, u64 size, SymbolType type, bool global);
+	i64 addFunctionSymbol(std::string_view name, i64 sectionIndex, u64 value, u64 size, bool global = true);
+	// A local symbol with the address of the start of the section.
+	i64 addSectionSymbol(i64 sectionIndex);
+	// A symbol that has to be defined by another file.
+	i64 addUndefinedSymbol(std::string_view name);
+	void addRelocation(i64 sectionIndex, u64 offset, i64 symbolIndex, RelocationType type, i64 addend);
+	std::vector<u8> write(FileType type) const;
+
+	struct Section {
+		std::string name;
+		u32 type;
+		u64 flags;
+		u64 address;
+		u64 alignment;
+		std::vector<u8> data;
+		u64 size;
+	};
+	// Index 0 is the null section which is added when writing.
+	std::vector<Section> sections;
+
+	struct Symbol {
+		std::string name;
+		i64 sectionIndex;
+		u64 value;
+		u64 size;
+		SymbolType type;
+		bool global;
+	};
+	std::vector<Symbol> symbols;
+
+	struct Relocation {
+		u64 offset;
+		i64 symbolIndex;
+		RelocationType type;
+		i64 addend;
+	};
+	struct SectionRelocations {
+		i64 sectionIndex;
+		std::vector<Relocation> relocations;
+	};
+	std::vector<SectionRelocations> relocations;
+};
@@ -3,6 +3,7 @@
 #include "ffiUtils.hpp"
 #include "utils/format.hpp"
 #include <vector>
+#include <algorithm>
 
 struct State {
 	std::span<const Variable> parameters;
@@ -52,7 +53,7 @@ Result<Real, std::string> evaluateExpr(const State& state, const Expr* expr) {
 
 	case CONSTANT: {
 		const auto constantExpr = static_cast<const ConstantExpr*>(expr);
-		return constantExpr->value;
+		return Real(constantExpr->value);
 	}
 
 	case IDENTIFIER: {
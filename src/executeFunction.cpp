@@ -1,28 +1,24 @@
 #include "executeFunction.hpp"
-#include "os/os.hpp"
+#include "codeHeap.hpp"
 #include "utils/put.hpp"
 
-void executeFunction(const MachineCode& machineCode, const float* inputArray, float* outputArray, i64 arrayElementCount) {
-	auto codeBuffer = reinterpret_cast<u8*>(allocateExecutableMemory(machineCode.code.size() + machineCode.data.size()));
-	if (codeBuffer == nullptr) {
+void executeFunction(const MachineCode& machineCode, const float* inputArray, float* outputArray, i64 arrayElementCount, const float* uniforms) {
+	static CodeHeap heap;
+	const auto size = machineCode.sizeWithData();
+	const auto allocation = heap.allocate(size);
+	if (allocation.memory == nullptr) {
 		put("failed to allocate executable memory");
 		exit(EXIT_FAILURE);
 	}
+	machineCode.copyWithData(allocation.writable);
+	flushInstructionCache(allocation.memory, size);
+	const auto codeBuffer = allocation.memory;
 
-	memcpy(codeBuffer, machineCode.code.data(), machineCode.code.size());
-	const auto dataBuffer = codeBuffer + machineCode.code.size();
-	// TODO: Alignment?
-	memcpy(dataBuffer, machineCode.data.data(), machineCode.data.size());
-	/*machineCode.patchRipRelativeOperands(codeBuffer, machineCode.data.data());*/
-	// Use the same buffer so the rip relative operands are not outside the i32 range.
-	machineCode.patchRipRelativeOperands(codeBuffer, dataBuffer);
-
-	ASSERT(uintptr_t(inputArray) % 32 == 0);
-	ASSERT(uintptr_t(outputArray) % 32 == 0);
-	using Function = void (*)(const float*, float*, i64);
+	using Function = void (*)(const float*, float*, i64, const float*);
 
 	const auto function = reinterpret_cast<Function>(codeBuffer);
-	function(inputArray, outputArray, arrayElementCount);
+	function(inputArray, outputArray, arrayElementCount, uniforms);
+	heap.free(codeBuffer);
 }
 
 Real executeFunction(const MachineCode& machineCode, std::span<const float> arguments) {
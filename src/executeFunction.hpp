@@ -7,6 +7,6 @@ struct alignas(32) YmmArgument {
 	float x[8];
 };
 
-void executeFunction(const MachineCode& machineCode, const float* inputArray, float* outputArray, i64 arrayElementCount);
+void executeFunction(const MachineCode& machineCode, const float* inputArray, float* outputArray, i64 arrayElementCount, const float* uniforms = nullptr);
 
 Real executeFunction(const MachineCode& machineCode, std::span<const float> arguments);
@@ -1,20 +1,21 @@
 #include "ffiUtils.hpp"
 #include "utils/asserts.hpp"
 #include <immintrin.h>
+#include "callingConvention.hpp"
 
 float callSimdVectorCall(void* function, std::span<const float> inputs) {
 	const auto arity = inputs.size();
 	switch (arity) {
 	case 0:
-		return reinterpret_cast<__m256 (__vectorcall*)()>(function)().m256_f32[0];
+		return _mm256_cvtss_f32(reinterpret_cast<__m256 (SIMD_CALL*)()>(function)());
 	case 1: {
 		__m256 a1 = _mm256_set1_ps(inputs[0]);
-		return reinterpret_cast<__m256(__vectorcall*)(__m256)>(function)(a1).m256_f32[0];
+		return _mm256_cvtss_f32(reinterpret_cast<__m256(SIMD_CALL*)(__m256)>(function)(a1));
 	}
 	case 2: {
 		__m256 a1 = _mm256_set1_ps(inputs[0]);
 		__m256 a2 = _mm256_set1_ps(inputs[1]);
-		return reinterpret_cast<__m256(__vectorcall*)(__m256, __m256)>(function)(a1, a2).m256_f32[0];
+		return _mm256_cvtss_f32(reinterpret_cast<__m256(SIMD_CALL*)(__m256, __m256)>(function)(a1, a2));
 	}
 
 	default:
@@ -24,3 +25,20 @@ float callSimdVectorCall(void* function, std::span<const float> inputs) {
 
 	return 0.0f;
 }
+
+__m256 callSimdVectorCall(void* function, const __m256* inputs, i64 inputCount) {
+	switch (inputCount) {
+	case 0:
+		return reinterpret_cast<__m256(SIMD_CALL*)()>(function)();
+	case 1:
+		return reinterpret_cast<__m256(SIMD_CALL*)(__m256)>(function)(inputs[0]);
+	case 2:
+		return reinterpret_cast<__m256(SIMD_CALL*)(__m256, __m256)>(function)(inputs[0], inputs[1]);
+
+	default:
+		ASSERT_NOT_REACHED();
+		break;
+	}
+
+	return _mm256_setzero_ps();
+}
@@ -1,5 +1,8 @@
 #pragma once
 
+#include "utils/ints.hpp"
 #include <span>
+#include <immintrin.h>
 
-float callSimdVectorCall(void* function, std::span<const float> inputs);
\ No newline at end of file
+float callSimdVectorCall(void* function, std::span<const float> inputs);
+__m256 callSimdVectorCall(void* function, const __m256* inputs, i64 inputCount);
\ No newline at end of file
@@ -17,6 +17,13 @@ static constexpr u32 F32_SIGN_SHIFT = F32_SIGNIFICAND_BITS + F32_EXPONENT_BITS;
 static constexpr u32 F32_EXPONENT_BIAS = 127;
 static constexpr u32 F32_SIGNIFICAND_PRECISON_BITS = 24; // 23 + hidden bit
 
+static constexpr u64 F64_SIGNIFICAND_BITS = 52;
+static constexpr u64 F64_SIGN_MASK = u64(1) << 63;
+static constexpr u64 F64_EXPONENT_MASK = u64(0x7FF) << F64_SIGNIFICAND_BITS;
+static constexpr u64 F64_SIGNIFICAND_MASK = (u64(1) << F64_SIGNIFICAND_BITS) - 1;
+static constexpr u64 F64_EXPONENT_SHIFT = F64_SIGNIFICAND_BITS;
+static constexpr u64 F64_EXPONENT_BIAS = 1023;
+
 i32 f32GetExponent(float x);
 float f32GetSignificand(float x);
 
@@ -34,4 +41,8 @@ inline float f32Make(bool sign, u8 exponent, u32 significand) {
 
 inline bool f32BitwiseEquals(float a, float b) {
 	return std::bit_cast<u32>(a) == std::bit_cast<u32>(b);
+}
+
+inline bool f64BitwiseEquals(double a, double b) {
+	return std::bit_cast<u64>(a) == std::bit_cast<u64>(b);
 }
\ No newline at end of file
@@ -3,8 +3,34 @@
 #include <string_view>
 #include "utils/ints.hpp"
 
+// The type of the values stored in an input or output column. The values are converted to and from the precision of the code when they are loaded and stored.
+// The stores round to nearest and saturate the integer types. NaN is stored as 0 in the integer types. F16 follows the IEEE rounding so values that are too big become infinities.
+enum class ElementType : u8 {
+	F32,
+	F16,
+	F64,
+	I32,
+	U8,
+};
+
+inline i64 elementTypeSize(ElementType type) {
+	switch (type) {
+		using enum ElementType;
+	case F32: return 4;
+	case F16: return 2;
+	case F64: return 8;
+	case I32: return 4;
+	case U8: return 1;
+	}
+	return 4;
+}
+
 struct Variable {
 	std::string_view name;
+	// Uniform variables have the same value for all the elements evaluated by a single call. They are passed in a separate array and aren't a part of the input layout.
+	bool isUniform = false;
+	// Only used by the non uniform variables of functions compiled with InputLayout::COLUMNS and Precision::F32.
+	ElementType elementType = ElementType::F32;
 
 	bool operator==(const Variable&) const = default;
 };
@@ -14,4 +40,12 @@ struct FunctionInfo {
 	std::string_view name;
 	i64 arity;
 	void* address;
+	// The version used by the code compiled with Precision::F64. Takes and returns __m256d. nullptr if the function can't be used in that code.
+	void* addressF64 = nullptr;
+};
+
+// The type of the values the compiled code operates on. F32 code processes 8 elements per iteration and F64 code 4.
+enum class Precision {
+	F32,
+	F64,
 };
\ No newline at end of file
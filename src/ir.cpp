@@ -47,7 +47,11 @@ void printIrOp(std::ostream& out, const IrOp& op) {
 			put("r%)", op.arguments.back());
 		},
 		[&](const ReturnOp& ret) {
-			out << "ret r" << ret.returnedRegister << '\n';
+			out << "ret r" << ret.returnedRegister;
+			if (ret.outputIndex != 0) {
+				out << " output " << ret.outputIndex;
+			}
+			out << '\n';
 		}
 	}, op);
 }
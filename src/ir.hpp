@@ -12,7 +12,7 @@ using Register = i64;
 
 struct LoadConstantOp {
 	Register destination;
-	Real constant;
+	RealConstant constant;
 
 	template<typename Function> 
 	void callWithInputRegisters(Function f) const;
@@ -127,8 +127,10 @@ struct FunctionOp {
 //	Register argumentRegister;
 //};
 
+// Code with multiple outputs has a ReturnOp for each one of them.
 struct ReturnOp {
 	Register returnedRegister;
+	i64 outputIndex = 0;
 
 	template<typename Function>
 	void callWithOutputRegisters(Function f) const;
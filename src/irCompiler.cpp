@@ -1,6 +1,7 @@
 #include "irCompiler.hpp"
 #include "utils/asserts.hpp"
 #include <iostream>
+#include <algorithm>
 
 //#define IR_COMPILER_DEBUG_PRINT_ADDED_INSTRUCTIONS
 
@@ -17,6 +18,7 @@ void IrCompiler::initialize(
 	this->functionInfo = functionInfo;
 	this->reporter = reporter;
 	allocatedRegistersCount = parameters.size();
+	outputCount = 0;
 }
 
 std::optional<const std::vector<IrOp>&> IrCompiler::compile(
@@ -25,15 +27,23 @@ std::optional<const std::vector<IrOp>&> IrCompiler::compile(
 	std::span<const FunctionInfo> functionInfo,
 	IrCompilerMessageReporter& reporter) {
 	initialize(parameters, functionInfo, &reporter);
+	if (!compileOutput(ast)) {
+		return std::nullopt;
+	}
+	return generatedIrCode;
+}
 
+bool IrCompiler::compileOutput(const Ast& ast) {
 	try {
 		const auto result = compileExpression(ast.root);
 		addOp(ReturnOp{
-			.returnedRegister = result.result
+			.returnedRegister = result.result,
+			.outputIndex = outputCount
 		});
-		return generatedIrCode;
+		outputCount++;
+		return true;
 	} catch (const CompilerError&) {
-		return std::nullopt;
+		return false;
 	}
 }
 
@@ -26,6 +26,10 @@ struct IrCompiler {
 		std::span<const FunctionInfo> functionInfo,
 		IrCompilerMessageReporter& reporter);
 
+	// Used for compiling code with multiple outputs. Call initialize and then compileOutput for each output. The outputs share the registers so the code can be optimized as a whole.
+	bool compileOutput(const Ast& ast);
+	i64 outputCount = 0;
+
 	ExprResult compileExpression(const Expr* expr);
 	ExprResult compileConstantExpr(const ConstantExpr& expr);
 	ExprResult compileBinaryExpr(const BinaryExpr& expr);
@@ -3,6 +3,8 @@
 #include "utils/asserts.hpp"
 #include "ffiUtils.hpp"
 #include <immintrin.h>
+#include <bit>
+#include <algorithm>
 
 Result<Real, std::string> IrVm::execute(
 	const std::vector<IrOp>& instructions, 
@@ -58,7 +60,7 @@ IrVm::Status IrVm::executeOp(const IrOp& op) {
 
 void IrVm::executeLoadConstantOp(const LoadConstantOp& op) {
 	allocateRegisterIfNotExists(op.destination);
-	setRegister(op.destination, op.constant);
+	setRegister(op.destination, Real(op.constant));
 }
 
 IrVm::Status IrVm::executeOp(const LoadVariableOp& op) {
@@ -175,3 +177,133 @@ IrVm::Status IrVm::registerDoesNotExistError(Register reg) {
 const Real& IrVm::getRegister(Register index) const {
 	return registers[index];
 }
+
+void VectorIrVm::execute(
+	const std::vector<IrOp>& instructions,
+	std::span<const Variable> variables,
+	std::span<const FunctionInfo> functionInfo,
+	const float* input,
+	float* output,
+	i64 elementCount,
+	std::span<const float> uniforms) {
+	initialize(instructions, variables, functionInfo);
+
+	const auto blockInputSize = inputVariableCount * 8;
+	const auto blockOutputSize = outputCount * 8;
+	i64 start = 0;
+	for (; start + 8 <= elementCount; start += 8) {
+		executeBlock(instructions, input, output, uniforms);
+		input += blockInputSize;
+		output += blockOutputSize;
+	}
+
+	const auto remaining = elementCount - start;
+	if (remaining == 0) {
+		return;
+	}
+	// Only the remaining elements of the last block can be accessed.
+	std::vector<float> inputBlock(blockInputSize, 0.0f);
+	std::vector<float> outputBlock(blockOutputSize);
+	for (i64 i = 0; i < inputVariableCount; i++) {
+		std::copy_n(input + i * 8, remaining, inputBlock.data() + i * 8);
+	}
+	executeBlock(instructions, inputBlock.data(), outputBlock.data(), uniforms);
+	for (i64 i = 0; i < outputCount; i++) {
+		std::copy_n(outputBlock.data() + i * 8, remaining, output + i * 8);
+	}
+}
+
+void VectorIrVm::initialize(const std::vector<IrOp>& instructions, std::span<const Variable> variables, std::span<const FunctionInfo> functionInfo) {
+	variableIndexToInputIndex.clear();
+	variableIndexToUniformIndex.clear();
+	inputVariableCount = 0;
+	i64 uniformCount = 0;
+	for (const auto& variable : variables) {
+		if (variable.isUniform) {
+			variableIndexToInputIndex.push_back(-1);
+			variableIndexToUniformIndex.push_back(uniformCount);
+			uniformCount++;
+		} else {
+			variableIndexToInputIndex.push_back(inputVariableCount);
+			variableIndexToUniformIndex.push_back(-1);
+			inputVariableCount++;
+		}
+	}
+
+	i64 registerCount = 0;
+	outputCount = 0;
+	instructionToFunctionAddress.clear();
+	for (const auto& op : instructions) {
+		callWithOutputRegisters(op, [&](Register reg) {
+			registerCount = std::max(registerCount, i64(reg) + 1);
+		});
+		if (const auto returnOp = std::get_if<ReturnOp>(&op)) {
+			outputCount = std::max(outputCount, returnOp->outputIndex + 1);
+		}
+
+		void* address = nullptr;
+		if (const auto functionOp = std::get_if<FunctionOp>(&op)) {
+			const auto function = std::find_if(
+				functionInfo.begin(), functionInfo.end(),
+				[&](const FunctionInfo& f) { return f.name == functionOp->functionName; });
+			ASSERT(function != functionInfo.end());
+			if (function != functionInfo.end()) {
+				address = function->address;
+			}
+		}
+		instructionToFunctionAddress.push_back(address);
+	}
+	registers.resize(registerCount * 8);
+}
+
+__m256& VectorIrVm::reg(Register index) {
+	return reinterpret_cast<__m256*>(registers.data())[index];
+}
+
+void VectorIrVm::executeBlock(const std::vector<IrOp>& instructions, const float* input, float* output, std::span<const float> uniforms) {
+	for (i64 i = 0; i < i64(instructions.size()); i++) {
+		std::visit(overloaded{
+			[&](const LoadConstantOp& op) {
+				reg(op.destination) = _mm256_set1_ps(float(op.constant));
+			},
+			[&](const LoadVariableOp& op) {
+				const auto uniformIndex = variableIndexToUniformIndex[op.variableIndex];
+				reg(op.destination) = uniformIndex != -1
+					? _mm256_set1_ps(uniforms[uniformIndex])
+					: _mm256_loadu_ps(input + variableIndexToInputIndex[op.variableIndex] * 8);
+			},
+			[&](const AddOp& op) {
+				reg(op.destination) = _mm256_add_ps(reg(op.lhs), reg(op.rhs));
+			},
+			[&](const SubtractOp& op) {
+				reg(op.destination) = _mm256_sub_ps(reg(op.lhs), reg(op.rhs));
+			},
+			[&](const MultiplyOp& op) {
+				reg(op.destination) = _mm256_mul_ps(reg(op.lhs), reg(op.rhs));
+			},
+			[&](const DivideOp& op) {
+				reg(op.destination) = _mm256_div_ps(reg(op.lhs), reg(op.rhs));
+			},
+			[&](const ExponentiateOp& op) {
+				ASSERT_NOT_REACHED();
+			},
+			[&](const XorOp& op) {
+				reg(op.destination) = _mm256_xor_ps(reg(op.lhs), reg(op.rhs));
+			},
+			[&](const NegateOp& op) {
+				reg(op.destination) = _mm256_xor_ps(reg(op.operand), _mm256_set1_ps(-0.0f));
+			},
+			[&](const FunctionOp& op) {
+				functionArguments.resize(op.arguments.size() * 8);
+				const auto arguments = reinterpret_cast<__m256*>(functionArguments.data());
+				for (usize j = 0; j < op.arguments.size(); j++) {
+					arguments[j] = reg(op.arguments[j]);
+				}
+				reg(op.destination) = callSimdVectorCall(instructionToFunctionAddress[i], arguments, i64(op.arguments.size()));
+			},
+			[&](const ReturnOp& op) {
+				_mm256_storeu_ps(output + op.outputIndex * 8, reg(op.returnedRegister));
+			},
+		}, instructions[i]);
+	}
+}
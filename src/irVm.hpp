@@ -1,10 +1,13 @@
 #pragma once
 
 #include "ir.hpp"
+#include "input.hpp"
 #include "utils/format.hpp"
 #include "utils/result.hpp"
+#include "utils/alignedAllocator.hpp"
 #include <optional>
 #include <span>
+#include <immintrin.h>
 
 struct IrVm {
 	enum class [[nodiscard]] Status {
@@ -50,3 +53,30 @@ IrVm::Status IrVm::error(const char* format, const Args & ...args) {
 	errorMessage = ::format(format, args...);
 	return Status::ERROR;
 }
+
+// Interprets the code 8 elements at a time. The arguments are the same as the ones of the functions compiled with InputLayout::BLOCKS so it can be used in place of them, for example while the machine code is being generated.
+struct VectorIrVm {
+	void execute(
+		const std::vector<IrOp>& instructions,
+		std::span<const Variable> variables,
+		std::span<const FunctionInfo> functionInfo,
+		const float* input,
+		float* output,
+		i64 elementCount,
+		std::span<const float> uniforms);
+	void initialize(const std::vector<IrOp>& instructions, std::span<const Variable> variables, std::span<const FunctionInfo> functionInfo);
+	// input and output point to a single block.
+	void executeBlock(const std::vector<IrOp>& instructions, const float* input, float* output, std::span<const float> uniforms);
+
+	// Each register is 8 floats. The buffers hold floats, because the alignment of __m256 is ignored as a template argument.
+	std::vector<float, AlignedAllocator<float, sizeof(__m256)>> registers;
+	__m256& reg(Register index);
+	// The uniform variables are broadcast from the uniforms and the other ones are loaded from the input.
+	std::vector<i64> variableIndexToInputIndex;
+	std::vector<i64> variableIndexToUniformIndex;
+	i64 inputVariableCount;
+	i64 outputCount;
+	// The address of the function called by each FunctionOp.
+	std::vector<void*> instructionToFunctionAddress;
+	std::vector<float, AlignedAllocator<float, sizeof(__m256)>> functionArguments;
+};
@@ -0,0 +1,323 @@
+#include "jitCodeRegistry.hpp"
+#include "elfWriter.hpp"
+#include "os/os.hpp"
+#include "utils/asserts.hpp"
+#include <chrono>
+#include <cstring>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// The interface GDB uses to find JIT code. GDB sets a breakpoint in __jit_debug_register_code and reads __jit_debug_descriptor when it is hit. The names and layouts are fixed by GDB.
+extern "C" {
+
+enum JitActions : u32 {
+	JIT_NOACTION = 0,
+	JIT_REGISTER_FN,
+	JIT_UNREGISTER_FN
+};
+
+struct jit_code_entry {
+	jit_code_entry* next_entry;
+	jit_code_entry* prev_entry;
+	const char* symfile_addr;
+	u64 symfile_size;
+};
+
+struct jit_descriptor {
+	u32 version;
+	u32 action_flag;
+	jit_code_entry* relevant_entry;
+	jit_code_entry* first_entry;
+};
+
+#ifdef _MSC_VER
+__declspec(noinline)
+#else
+__attribute__((noinline))
+#endif
+void __jit_debug_register_code() {
+	// Prevents the call from being optimized out.
+#ifndef _MSC_VER
+	asm volatile("" ::: "memory");
+#endif
+}
+
+jit_descriptor __jit_debug_descriptor = { 1, JIT_NOACTION, nullptr, nullptr };
+
+}
+
+struct JitCodeRegistry::DebuggerEntry {
+	jit_code_entry entry;
+	std::vector<u8> symbolFile;
+};
+
+#pragma pack(push, 1)
+struct JitdumpHeader {
+	u32 magic;
+	u32 version;
+	u32 totalSize;
+	u32 elfMachine;
+	u32 padding;
+	u32 pid;
+	u64 timestamp;
+	u64 flags;
+};
+
+struct JitdumpCodeLoadRecord {
+	u32 id;
+	u32 totalSize;
+	u64 timestamp;
+	u32 pid;
+	u32 tid;
+	u64 vma;
+	u64 codeAddress;
+	u64 codeSize;
+	u64 codeIndex;
+};
+#pragma pack(pop)
+
+static constexpr u32 JITDUMP_MAGIC = 0x4A695444;
+static constexpr u32 JITDUMP_CODE_LOAD = 0;
+
+// perf record -k mono uses CLOCK_MONOTONIC, which is what steady_clock uses on Linux.
+static u64 jitdumpTimestamp() {
+	return u64(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+JitCodeRegistry::JitCodeRegistry()
+	: outputs(0)
+	, perfMap(nullptr)
+	, jitdump(nullptr)
+	, jitdumpMarker(nullptr)
+	, nextCodeIndex(0) {}
+
+JitCodeRegistry::~JitCodeRegistry() {
+	disable();
+}
+
+bool JitCodeRegistry::enable(u32 newOutputs) {
+	std::lock_guard lock(mutex);
+	bool opened = true;
+#ifdef __linux__
+	if ((newOutputs & PERF_MAP) && perfMap == nullptr) {
+		const auto path = "/tmp/perf-" + std::to_string(processId()) + ".map";
+		perfMap = fopen(path.c_str(), "a");
+		if (perfMap == nullptr) {
+			newOutputs &= ~PERF_MAP;
+			opened = false;
+		}
+	}
+	if ((newOutputs & JITDUMP) && jitdump == nullptr && !openJitdump()) {
+		newOutputs &= ~JITDUMP;
+		opened = false;
+	}
+#else
+	if (newOutputs & (PERF_MAP | JITDUMP)) {
+		newOutputs &= ~(PERF_MAP | JITDUMP);
+		opened = false;
+	}
+#endif
+	outputs.fetch_or(newOutputs, std::memory_order_relaxed);
+	return opened;
+}
+
+void JitCodeRegistry::disable() {
+	std::lock_guard lock(mutex);
+	outputs.store(0, std::memory_order_relaxed);
+	if (perfMap != nullptr) {
+		fclose(perfMap);
+		perfMap = nullptr;
+	}
+	closeJitdump();
+}
+
+bool JitCodeRegistry::isEnabled() const {
+	return outputs.load(std::memory_order_relaxed) != 0;
+}
+
+JitCodeRegistry::DebuggerEntry* JitCodeRegistry::registerCode(std::string_view symbolName, const u8* code, i64 size) {
+	const auto enabledOutputs = outputs.load(std::memory_order_relaxed);
+	if (enabledOutputs == 0) {
+		return nullptr;
+	}
+
+	DebuggerEntry* debuggerEntry = nullptr;
+	if (enabledOutputs & GDB) {
+		// The code is already in memory so the file only describes where it is.
+		ElfWriter elf;
+		const auto text = elf.addSection(".text", ElfWriter::SECTION_TYPE_NOBITS, ElfWriter::SECTION_FLAG_ALLOC | ElfWriter::SECTION_FLAG_EXECINSTR, u64(code), 16, {}, u64(size));
+		elf.addFunctionSymbol(symbolName, text, u64(code), u64(size));
+		debuggerEntry = new DebuggerEntry{ .entry = {}, .symbolFile = elf.write(ElfWriter::FileType::RELOCATABLE) };
+		debuggerEntry->entry.symfile_addr = reinterpret_cast<const char*>(debuggerEntry->symbolFile.data());
+		debuggerEntry->entry.symfile_size = debuggerEntry->symbolFile.size();
+	}
+
+	std::lock_guard lock(mutex);
+	if (perfMap != nullptr) {
+		writePerfMapEntry(symbolName, code, size);
+	}
+	if (jitdump != nullptr) {
+		writeJitdumpEntry(symbolName, code, size);
+	}
+	if (debuggerEntry != nullptr) {
+		auto& entry = debuggerEntry->entry;
+		entry.prev_entry = nullptr;
+		entry.next_entry = __jit_debug_descriptor.first_entry;
+		if (entry.next_entry != nullptr) {
+			entry.next_entry->prev_entry = &entry;
+		}
+		__jit_debug_descriptor.first_entry = &entry;
+		__jit_debug_descriptor.relevant_entry = &entry;
+		__jit_debug_descriptor.action_flag = JIT_REGISTER_FN;
+		__jit_debug_register_code();
+	}
+	return debuggerEntry;
+}
+
+void JitCodeRegistry::unregisterCode(DebuggerEntry* debuggerEntry) {
+	if (debuggerEntry == nullptr) {
+		return;
+	}
+	{
+		std::lock_guard lock(mutex);
+		auto& entry = debuggerEntry->entry;
+		if (entry.prev_entry != nullptr) {
+			entry.prev_entry->next_entry = entry.next_entry;
+		} else {
+			__jit_debug_descriptor.first_entry = entry.next_entry;
+		}
+		if (entry.next_entry != nullptr) {
+			entry.next_entry->prev_entry = entry.prev_entry;
+		}
+		__jit_debug_descriptor.relevant_entry = &entry;
+		__jit_debug_descriptor.action_flag = JIT_UNREGISTER_FN;
+		__jit_debug_register_code();
+	}
+	delete debuggerEntry;
+}
+
+std::string JitCodeRegistry::symbolName(std::span<const std::string_view> sources) {
+	// FNV-1a
+	u64 hash = 0xCBF29CE484222325;
+	for (const auto& source : sources) {
+		for (const auto c : source) {
+			hash = (hash ^ u8(c)) * 0x100000001B3;
+		}
+		hash = (hash ^ 0xFF) * 0x100000001B3;
+	}
+
+	char hashString[17];
+	snprintf(hashString, sizeof(hashString), "%016llx", static_cast<unsigned long long>(hash));
+	std::string name = "jit_";
+	name += hashString;
+
+	if (sources.empty()) {
+		return name;
+	}
+	name += ' ';
+	// Only keeps the printable characters and collapses the whitespace so the name is on a single line.
+	bool previousWasSpace = true;
+	i64 charCount = 0;
+	for (const auto c : sources[0]) {
+		if (charCount >= MAX_SOURCE_CHARS_IN_SYMBOL_NAME) {
+			name += "...";
+			break;
+		}
+		const auto isSpace = c == ' ' || c == '\t' || c == '\n' || c == '\r';
+		if (isSpace) {
+			if (!previousWasSpace) {
+				name += ' ';
+				charCount++;
+			}
+		} else if (c > ' ' && c < 127) {
+			name += c;
+			charCount++;
+		}
+		previousWasSpace = isSpace;
+	}
+	if (sources.size() > 1) {
+		name += " (+" + std::to_string(sources.size() - 1) + ")";
+	}
+	return name;
+}
+
+void JitCodeRegistry::writePerfMapEntry(std::string_view symbolName, const u8* code, i64 size) {
+	fprintf(perfMap, "%llx %llx %.*s\n",
+		static_cast<unsigned long long>(reinterpret_cast<uintptr_t>(code)),
+		static_cast<unsigned long long>(size),
+		int(symbolName.size()), symbolName.data());
+	// perf can read the file while the process is running.
+	fflush(perfMap);
+}
+
+void JitCodeRegistry::writeJitdumpEntry(std::string_view symbolName, const u8* code, i64 size) {
+#ifdef __linux__
+	JitdumpCodeLoadRecord record{};
+	record.id = JITDUMP_CODE_LOAD;
+	record.totalSize = u32(sizeof(JitdumpCodeLoadRecord) + symbolName.size() + 1 + size);
+	record.timestamp = jitdumpTimestamp();
+	record.pid = u32(processId());
+	record.tid = u32(syscall(SYS_gettid));
+	record.vma = u64(code);
+	record.codeAddress = u64(code);
+	record.codeSize = u64(size);
+	record.codeIndex = nextCodeIndex++;
+	fwrite(&record, sizeof(record), 1, jitdump);
+	fwrite(symbolName.data(), 1, symbolName.size(), jitdump);
+	fputc('\0', jitdump);
+	fwrite(code, 1, size, jitdump);
+	fflush(jitdump);
+#endif
+}
+
+bool JitCodeRegistry::openJitdump() {
+#ifdef __linux__
+	// perf inject finds the file by this name.
+	const auto path = "/tmp/jit-" + std::to_string(processId()) + ".dump";
+	jitdump = fopen(path.c_str(), "w+");
+	if (jitdump == nullptr) {
+		return false;
+	}
+	jitdumpMarker = mmap(nullptr, pageSize(), PROT_READ | PROT_EXEC, MAP_PRIVATE, fileno(jitdump), 0);
+	if (jitdumpMarker == MAP_FAILED) {
+		jitdumpMarker = nullptr;
+		fclose(jitdump);
+		jitdump = nullptr;
+		return false;
+	}
+	JitdumpHeader header{};
+	header.magic = JITDUMP_MAGIC;
+	header.version = 1;
+	header.totalSize = sizeof(JitdumpHeader);
+	header.elfMachine = 62; // EM_X86_64
+	header.pid = u32(processId());
+	header.timestamp = jitdumpTimestamp();
+	fwrite(&header, sizeof(header), 1, jitdump);
+	fflush(jitdump);
+	return true;
+#else
+	return false;
+#endif
+}
+
+void JitCodeRegistry::closeJitdump() {
+#ifdef __linux__
+	if (jitdumpMarker != nullptr) {
+		munmap(jitdumpMarker, pageSize());
+		jitdumpMarker = nullptr;
+	}
+#endif
+	if (jitdump != nullptr) {
+		fclose(jitdump);
+		jitdump = nullptr;
+	}
+}
+
+JitCodeRegistry& jitCodeRegistry() {
+	static JitCodeRegistry registry;
+	return registry;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "utils/ints.hpp"
+#include <atomic>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdio>
+
+// Makes the generated functions visible to profilers and debuggers. Nothing is registered until an output is enabled.
+// PERF_MAP appends the functions to /tmp/perf-<pid>.map, which perf uses to name the addresses of JIT code.
+// JITDUMP writes the functions with their code to /tmp/jit-<pid>.dump so the instructions can be annotated after running perf record -k mono and perf inject --jit.
+// GDB registers an in-memory ELF file for each function with the GDB JIT interface so the functions are named in backtraces.
+// The perf outputs are only supported on Linux. Thread safe.
+struct JitCodeRegistry {
+	enum Outputs : u32 {
+		PERF_MAP = 1 << 0,
+		JITDUMP = 1 << 1,
+		GDB = 1 << 2,
+	};
+
+	JitCodeRegistry();
+	~JitCodeRegistry();
+	JitCodeRegistry(const JitCodeRegistry&) = delete;
+	JitCodeRegistry& operator=(const JitCodeRegistry&) = delete;
+
+	// Returns false if some of the files couldn't be opened. The outputs that could be opened are enabled anyway.
+	bool enable(u32 outputs);
+	// The functions registered with the debugger stay registered until they are destroyed.
+	void disable();
+	bool isEnabled() const;
+
+	struct DebuggerEntry;
+	// Returns the entry that has to be passed to unregisterCode before the code is freed. Can be nullptr.
+	DebuggerEntry* registerCode(std::string_view symbolName, const u8* code, i64 size);
+	void unregisterCode(DebuggerEntry* entry);
+
+	// A name that identifies the function in the tools. Made of a hash of the sources, so that different functions with the same prefix can be told apart, followed by the start of the first source.
+	static std::string symbolName(std::span<const std::string_view> sources);
+	static constexpr i64 MAX_SOURCE_CHARS_IN_SYMBOL_NAME = 48;
+
+	void writePerfMapEntry(std::string_view symbolName, const u8* code, i64 size);
+	void writeJitdumpEntry(std::string_view symbolName, const u8* code, i64 size);
+	bool openJitdump();
+	void closeJitdump();
+
+	std::atomic<u32> outputs;
+	std::mutex mutex;
+	FILE* perfMap;
+	FILE* jitdump;
+	// The jitdump file has to be mapped as executable so perf record notices it.
+	void* jitdumpMarker;
+	u64 nextCodeIndex;
+};
+
+JitCodeRegistry& jitCodeRegistry();
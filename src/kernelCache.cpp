@@ -0,0 +1,123 @@
+#include "kernelCache.hpp"
+#include "utils/asserts.hpp"
+#include <algorithm>
+#include <bit>
+
+KernelCache::KernelCache(Runtime& runtime, i64 memoryBudget)
+	: runtime(runtime)
+	, memoryBudget(memoryBudget) {}
+
+std::optional<KernelCache::Handle> KernelCache::compileFunction(std::string_view source, std::span<const Variable> variables, InputLayout inputLayout) {
+	auto key = computeKey(source, variables, inputLayout);
+	if (!key.has_value()) {
+		// Let the runtime report the errors.
+		auto function = runtime.compileFunction(source, variables, inputLayout);
+		if (!function.has_value()) {
+			return std::nullopt;
+		}
+		return std::make_shared<const Runtime::LoopFunction>(std::move(*function));
+	}
+
+	const auto cached = keyToEntry.find(*key);
+	if (cached != keyToEntry.end()) {
+		stats.hits++;
+		entries.splice(entries.begin(), entries, cached->second);
+		return cached->second->function;
+	}
+
+	stats.misses++;
+	auto function = runtime.compileFunction(source, variables, inputLayout);
+	if (!function.has_value()) {
+		return std::nullopt;
+	}
+	Handle handle = std::make_shared<const Runtime::LoopFunction>(std::move(*function));
+
+	if (handle->size > memoryBudget) {
+		return handle;
+	}
+
+	entries.push_front(Entry{ .key = std::move(*key), .function = handle });
+	keyToEntry[entries.front().key] = entries.begin();
+	stats.entryCount++;
+	stats.memoryUsed += handle->size;
+	evictUntilWithinBudget();
+
+	return handle;
+}
+
+void KernelCache::clear() {
+	keyToEntry.clear();
+	entries.clear();
+	stats.entryCount = 0;
+	stats.memoryUsed = 0;
+}
+
+std::optional<std::string> KernelCache::computeKey(std::string_view source, std::span<const Variable> variables, InputLayout inputLayout) {
+	scannerReporter.reset();
+	const auto& tokens = scanner.parse(source, runtime.functions, variables, scannerReporter);
+	if (!scannerReporter.errors.empty()) {
+		return std::nullopt;
+	}
+
+	std::string key;
+	auto appendI64 = [&key](i64 value) {
+		key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+	};
+	auto appendString = [&](std::string_view string) {
+		appendI64(i64(string.size()));
+		key.append(string);
+	};
+
+	for (const auto& token : tokens) {
+		key.push_back(char(token.type));
+		const auto text = source.substr(token.start(), token.length());
+
+		switch (token.type) {
+			using enum TokenType;
+		case FLOAT:
+			appendString(text);
+			break;
+
+		case VARIABLE: {
+			const auto variable = std::ranges::find_if(variables, [&](const Variable& v) { return v.name == text; });
+			ASSERT(variable != variables.end());
+			appendI64(variable - variables.begin());
+			break;
+		}
+
+		case FUNCTION: {
+			const auto function = std::ranges::find_if(runtime.functions, [&](const FunctionInfo& f) { return f.name == text; });
+			ASSERT(function != runtime.functions.end());
+			appendI64(function - runtime.functions.begin());
+			break;
+		}
+
+		default:
+			break;
+		}
+	}
+
+	appendI64(i64(variables.size()));
+	for (const auto& variable : variables) {
+		key.push_back(char(variable.isUniform));
+		key.push_back(char(variable.elementType));
+	}
+	appendI64(i64(inputLayout));
+	for (const auto& function : runtime.functions) {
+		appendString(function.name);
+		appendI64(function.arity);
+		appendI64(std::bit_cast<i64>(function.address));
+	}
+	return key;
+}
+
+void KernelCache::evictUntilWithinBudget() {
+	while (stats.memoryUsed > memoryBudget && !entries.empty()) {
+		const auto& entry = entries.back();
+		stats.memoryUsed -= entry.function->size;
+		stats.entryCount--;
+		stats.evictions++;
+		keyToEntry.erase(entry.key);
+		entries.pop_back();
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "runtime.hpp"
+#include "listScannerMessageReporter.hpp"
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// Caches the functions compiled by a Runtime so compiling the same source again only requires scanning it.
+// The key is built from the tokens so whitespace doesn't matter. Variables are identified by their position in the variable list so for example "a+b" with the variables (a, b) and "x + y" with the variables (x, y) share a function. The function table is also a part of the key.
+// When the size of the cached functions goes over the memory budget the least recently used ones are evicted. Evicted functions stay valid until all the handles to them are destroyed. The handles can't outlive the Runtime.
+struct KernelCache {
+	using Handle = std::shared_ptr<const Runtime::LoopFunction>;
+	static constexpr i64 DEFAULT_MEMORY_BUDGET = 16 * 1024 * 1024;
+
+	KernelCache(Runtime& runtime, i64 memoryBudget = DEFAULT_MEMORY_BUDGET);
+
+	std::optional<Handle> compileFunction(std::string_view source, std::span<const Variable> variables, InputLayout inputLayout = InputLayout::BLOCKS);
+	void clear();
+
+	struct Stats {
+		i64 hits = 0;
+		i64 misses = 0;
+		i64 evictions = 0;
+		i64 entryCount = 0;
+		i64 memoryUsed = 0;
+	};
+	Stats stats;
+
+	// Returns std::nullopt if the source has scanner errors.
+	std::optional<std::string> computeKey(std::string_view source, std::span<const Variable> variables, InputLayout inputLayout);
+	void evictUntilWithinBudget();
+
+	struct Entry {
+		std::string key;
+		Handle function;
+	};
+	// Ordered from the most recently used.
+	std::list<Entry> entries;
+	// The keys point to the strings stored in the entries.
+	std::unordered_map<std::string_view, std::list<Entry>::iterator> keyToEntry;
+
+	Runtime& runtime;
+	i64 memoryBudget;
+
+	Scanner scanner;
+	ListScannerMessageReporter scannerReporter;
+};
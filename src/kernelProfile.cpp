@@ -0,0 +1,97 @@
+#include "kernelProfile.hpp"
+
+namespace {
+
+struct ThreadHardwareCounters {
+	ThreadHardwareCounters() {
+		isOpen = openHardwareCounters(counters);
+	}
+	~ThreadHardwareCounters() {
+		if (isOpen) {
+			closeHardwareCounters(counters);
+		}
+	}
+
+	HardwareCounters counters;
+	bool isOpen;
+};
+
+}
+
+// Returns nullptr if the counters couldn't be opened.
+static const HardwareCounters* threadHardwareCounters() {
+	thread_local ThreadHardwareCounters counters;
+	return counters.isOpen ? &counters.counters : nullptr;
+}
+
+void KernelProfile::begin(Scope& scope) {
+	scope.counters = threadHardwareCounters();
+	if (scope.counters != nullptr) {
+		readHardwareCounters(*scope.counters, scope.startEvents);
+	}
+	// Started last so reading the counters isn't included.
+	scope.start = std::chrono::steady_clock::now();
+}
+
+void KernelProfile::end(Scope& scope) {
+	const auto elapsed = std::chrono::steady_clock::now() - scope.start;
+	if (scope.counters != nullptr) {
+		i64 endEvents[HARDWARE_EVENT_COUNT];
+		readHardwareCounters(*scope.counters, endEvents);
+		for (i64 i = 0; i < HARDWARE_EVENT_COUNT; i++) {
+			events[i].fetch_add(endEvents[i] - scope.startEvents[i], std::memory_order_relaxed);
+		}
+		countedCallCount.fetch_add(1, std::memory_order_relaxed);
+	}
+	callCount.fetch_add(1, std::memory_order_relaxed);
+	elementCount.fetch_add(scope.elementCount, std::memory_order_relaxed);
+	byteCount.fetch_add(scope.byteCount, std::memory_order_relaxed);
+	nanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(), std::memory_order_relaxed);
+}
+
+KernelProfile::Report KernelProfile::report() const {
+	Report report{};
+	report.callCount = callCount.load(std::memory_order_relaxed);
+	report.elementCount = elementCount.load(std::memory_order_relaxed);
+	report.byteCount = byteCount.load(std::memory_order_relaxed);
+	report.nanoseconds = nanoseconds.load(std::memory_order_relaxed);
+	report.countersAvailable = countedCallCount.load(std::memory_order_relaxed) > 0;
+	for (i64 i = 0; i < HARDWARE_EVENT_COUNT; i++) {
+		report.events[i] = events[i].load(std::memory_order_relaxed);
+	}
+	return report;
+}
+
+void KernelProfile::reset() {
+	callCount.store(0, std::memory_order_relaxed);
+	elementCount.store(0, std::memory_order_relaxed);
+	byteCount.store(0, std::memory_order_relaxed);
+	nanoseconds.store(0, std::memory_order_relaxed);
+	countedCallCount.store(0, std::memory_order_relaxed);
+	for (auto& event : events) {
+		event.store(0, std::memory_order_relaxed);
+	}
+}
+
+double KernelProfile::Report::cyclesPerElement() const {
+	if (elementCount == 0) {
+		return 0.0;
+	}
+	return double(events[i64(HardwareEvent::CYCLES)]) / double(elementCount);
+}
+
+double KernelProfile::Report::bytesPerCycle() const {
+	const auto cycles = events[i64(HardwareEvent::CYCLES)];
+	if (cycles == 0) {
+		return 0.0;
+	}
+	return double(byteCount) / double(cycles);
+}
+
+double KernelProfile::Report::instructionsPerCycle() const {
+	const auto cycles = events[i64(HardwareEvent::CYCLES)];
+	if (cycles == 0) {
+		return 0.0;
+	}
+	return double(events[i64(HardwareEvent::INSTRUCTIONS)]) / double(cycles);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "os/os.hpp"
+#include <atomic>
+#include <chrono>
+
+// Accumulates the hardware counters of the calls to a kernel. The counters of a thread are opened when it first calls a profiled kernel and stay open until the thread exits.
+// Thread safe.
+struct KernelProfile {
+	struct Report {
+		i64 callCount;
+		i64 elementCount;
+		// The input and output bytes accessed by the kernel.
+		i64 byteCount;
+		i64 nanoseconds;
+		// If false only the values above are valid, because the counters couldn't be opened.
+		bool countersAvailable;
+		i64 events[HARDWARE_EVENT_COUNT];
+
+		double cyclesPerElement() const;
+		double bytesPerCycle() const;
+		double instructionsPerCycle() const;
+	};
+	Report report() const;
+	void reset();
+
+	// Measures the code between the construction and the destruction. Does nothing if profile is nullptr, so the calls that aren't profiled only pay for the check.
+	struct Scope {
+		Scope(KernelProfile* profile, i64 elementCount, i64 byteCount);
+		~Scope();
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+		KernelProfile* profile;
+		i64 elementCount;
+		i64 byteCount;
+		const HardwareCounters* counters;
+		i64 startEvents[HARDWARE_EVENT_COUNT];
+		std::chrono::steady_clock::time_point start;
+	};
+	void begin(Scope& scope);
+	void end(Scope& scope);
+
+	std::atomic<i64> callCount = 0;
+	std::atomic<i64> elementCount = 0;
+	std::atomic<i64> byteCount = 0;
+	std::atomic<i64> nanoseconds = 0;
+	// The calls made on threads that have the counters.
+	std::atomic<i64> countedCallCount = 0;
+	std::atomic<i64> events[HARDWARE_EVENT_COUNT] = {};
+};
+
+inline KernelProfile::Scope::Scope(KernelProfile* profile, i64 elementCount, i64 byteCount)
+	: profile(profile)
+	, elementCount(elementCount)
+	, byteCount(byteCount) {
+	if (profile != nullptr) [[unlikely]] {
+		profile->begin(*this);
+	}
+}
+
+inline KernelProfile::Scope::~Scope() {
+	if (profile != nullptr) [[unlikely]] {
+		profile->end(*this);
+	}
+}
@@ -1,7 +1,9 @@
 #include "machineCode.hpp"
 #include "utils/asserts.hpp"
+#include "utils/rounding.hpp"
 #include <bit>
 #include <unordered_map>
+#include <cstring>
 
 static u8 takeFirst3Bits(u8 r) {
 	return 0b111 & u8(r);
@@ -16,6 +18,7 @@ void MachineCode::initialize() {
 	data.clear();
 	dataLabelToDataOffset.clear();
 	ripRelativeDataOperands.clear();
+	functionAddressOperands.clear();
 	jumpsToPatch.clear();
 }
 
@@ -53,10 +56,10 @@ void MachineCode::generateFrom(const AssemblyCode& assembly) {
 		auto operandAddress = code.data() + jump.displacemenOperandBytesCodeOffset;
 		const auto nextInstructionAddress = operandAddress + operandByteSize;
 
-		const auto jump = destinationAddress - nextInstructionAddress;
-		ASSERT(jump >= INT32_MIN && jump <= INT32_MAX);
+		const auto displacement = destinationAddress - nextInstructionAddress;
+		ASSERT(displacement >= INT32_MIN && displacement <= INT32_MAX);
 
-		*reinterpret_cast<i32*>(operandAddress) = i32(jump);
+		*reinterpret_cast<i32*>(operandAddress) = i32(displacement);
 
 		/*const auto operandCodeOffset = code.data() + jump.displacemenOperandBytesCodeOffset;
 		const auto nextInstructionOffset = operandCodeOffset + operandByteSize;*/
@@ -93,6 +96,27 @@ void MachineCode::patchRipRelativeOperands(u8* code, const u8* data) const {
 	}
 }
 
+void MachineCode::patchFunctionAddresses(std::span<void* const> addresses) {
+	for (const auto& operand : functionAddressOperands) {
+		ASSERT(operand.functionIndex >= 0 && operand.functionIndex < i64(addresses.size()));
+		const auto address = std::bit_cast<u64>(addresses[operand.functionIndex]);
+		memcpy(code.data() + operand.operandCodeOffset, &address, sizeof(address));
+	}
+}
+
+i64 MachineCode::sizeWithData() const {
+	return roundUpToMultiple(i64(code.size()), DATA_ALIGNMENT) + i64(data.size());
+}
+
+void MachineCode::copyWithData(u8* memory) const {
+	u8* codeDestination = memory;
+	memcpy(codeDestination, code.data(), code.size());
+
+	u8* dataDestination = memory + roundUpToMultiple(i64(code.size()), DATA_ALIGNMENT);
+	memcpy(dataDestination, data.data(), data.size());
+	patchRipRelativeOperands(codeDestination, dataDestination);
+}
+
 void MachineCode::emitU8(u8 value) {
 	code.push_back(value);
 }
@@ -173,16 +197,16 @@ void MachineCode::emit3ByteVex(bool r, bool x, bool b, u8 m_mmmm, bool w, u8 vvv
 		(pp & 0b11));
 }
 
-void MachineCode::emitInstructionYmmYmmYmm(u8 opCode, u8 a, u8 b, u8 c) {
+void MachineCode::emitInstructionYmmYmmYmm(u8 opCode, u8 a, u8 b, u8 c, u8 pp) {
 	const auto a4thBit = take4thBit(a);
 	const auto c4thBit = take4thBit(c);
 
 	const auto negatedB = ~static_cast<u8>(b) & 0b1111;
 	//emit2ByteVex(1, invertedLhs, 1, 0b00);
 	if (c4thBit == 0) {
-		emit2ByteVex(!a4thBit, negatedB, 1, 0b00);
+		emit2ByteVex(!a4thBit, negatedB, 1, pp);
 	} else {
-		emit3ByteVex(!a4thBit, 0, !c4thBit, 0b000001, 0, negatedB, 1, 0b00);
+		emit3ByteVex(!a4thBit, 0, !c4thBit, 0b000001, 0, negatedB, 1, pp);
 	}
 	emitU8(opCode);
 	emitModRmDirectAddressing(takeFirst3Bits(a), takeFirst3Bits(c));
@@ -252,6 +276,16 @@ void MachineCode::emit(const JmpLbl& i) {
 		emitU8(0x0F);
 		emitU8(0x8C);
 		break;
+
+	case SIGNED_LESS_OR_EQUAL:
+		emitU8(0x0F);
+		emitU8(0x8E);
+		break;
+
+	case SIGNED_GREATER_OR_EQUAL:
+		emitU8(0x0F);
+		emitU8(0x8D);
+		break;
 	}
 	const auto operandLocation = currentLocation();
 	emitU32(0);
@@ -285,6 +319,21 @@ void MachineCode::emit(const SubR64Imm& i) {
 	emitReg64ImmInstruction(0x81, 0x5, i.lhs, i.rhs);
 }
 
+void MachineCode::emit(const AddR64R64& i) {
+	emitReg64Reg64Instruction(0x03, i.lhs, i.rhs);
+}
+
+void MachineCode::emit(const SubR64R64& i) {
+	emitReg64Reg64Instruction(0x2B, i.lhs, i.rhs);
+}
+
+void MachineCode::emit(const ShlR64Imm& i) {
+	emitRex(1, 0, 0, take4thBit(regIndex(i.lhs)));
+	emitU8(0xC1);
+	emitModRm(0b11, 0x4, takeFirst3Bits(regIndex(i.lhs)));
+	emitU8(i.rhs);
+}
+
 void MachineCode::emit(const Inc64& i) {
 	emitRex(1, 0, 0, take4thBit(regIndex(i.reg)));
 	emitU8(0xFF);
@@ -296,6 +345,10 @@ void MachineCode::emit(const CmpR64R64& i) {
 	emitReg64Reg64Instruction(0x39, i.rhs, i.lhs);
 }
 
+void MachineCode::emit(const CmpR64Imm& i) {
+	emitReg64ImmInstruction(0x81, 0x7, i.lhs, i.rhs);
+}
+
 void MachineCode::emit(const MovR64R64& i) {
 	const auto destination = regIndex(i.destination);
 	const auto source = regIndex(i.source);
@@ -304,9 +357,20 @@ void MachineCode::emit(const MovR64R64& i) {
 	emitModRmDirectAddressing(takeFirst3Bits(source), takeFirst3Bits(destination));
 }
 
+void MachineCode::emit(const MovR64Mem& i) {
+	const auto destination = regIndex(i.destination);
+	const auto sourceAddressReg = regIndex(i.sourceAddressReg);
+	emitRex(1, take4thBit(destination), 0, take4thBit(sourceAddressReg));
+	emitU8(0x8B);
+	emitModRmRegDisp(takeFirst3Bits(destination), takeFirst3Bits(sourceAddressReg), i.addressOffset);
+}
+
 void MachineCode::emit(const MovR64Imm64& i) {
 	emitRex(1, 0, 0, take4thBit(regIndex(i.destination)));
 	emitU8(0xB8 + takeFirst3Bits(regIndex(i.destination)));
+	if (i.functionIndex != -1) {
+		functionAddressOperands.push_back(FunctionAddressOperand{ .operandCodeOffset = currentLocation(), .functionIndex = i.functionIndex });
+	}
 	emitU64(i.immediate);
 }
 
@@ -317,12 +381,58 @@ void MachineCode::emit(const VbroadcastssLbl& i) {
 	emit3ByteVex(!destination4thBit, 0, 0, 0b00010, 0, 0b1111, 1, 0b01);
 	emitU8(0x18);
 	emitModRm(0b00, static_cast<u8>(takeFirst3Bits(destination)), 0b101);
-	const i64 ripOffsetBytesCodeOffset = code.size(); // Points to last by of the current code. Which is where the next bytes begin.
+	emitRipRelativeDataOperand(i.source);
+}
+
+void MachineCode::emit(const VbroadcastssYmmMem& i) {
+	emitInstruction0F38YmmRegDisp(0x18, regIndex(i.destination), 0b0000, regIndex(i.sourceAddressReg), i.addressOffset);
+}
+
+void MachineCode::emit(const VbroadcastsdLbl& i) {
+	const auto destination = regIndex(i.destination);
+	const auto destination4thBit = take4thBit(destination);
+
+	emit3ByteVex(!destination4thBit, 0, 0, 0b00010, 0, 0b1111, 1, 0b01);
+	emitU8(0x19);
+	emitModRm(0b00, static_cast<u8>(takeFirst3Bits(destination)), 0b101);
+	emitRipRelativeDataOperand(i.source);
+}
+
+void MachineCode::emit(const VbroadcastsdYmmMem& i) {
+	emitInstruction0F38YmmRegDisp(0x19, regIndex(i.destination), 0b0000, regIndex(i.sourceAddressReg), i.addressOffset);
+}
+
+void MachineCode::emit(const LeaR64Lbl& i) {
+	const auto destination = regIndex(i.destination);
+	emitRex(1, take4thBit(destination), 0, 0);
+	emitU8(0x8D);
+	emitModRm(0b00, takeFirst3Bits(destination), 0b101);
+	emitRipRelativeDataOperand(i.source);
+}
+
+void MachineCode::emit(const LeaR64Sib& i) {
+	const auto destination = regIndex(i.destination);
+	const auto base = regIndex(i.base);
+	const auto index = regIndex(i.index);
+	ASSERT(i.index != Reg64::RSP);
+	ASSERT(i.scale == 1 || i.scale == 2 || i.scale == 4 || i.scale == 8);
+	emitRex(1, take4thBit(destination), take4thBit(index), take4thBit(base));
+	emitU8(0x8D);
+	// rm = 0b100 means that a SIB byte follows. With mod = 0b00 the base 0b101 means no base so RBP and R13 need a zero displacement.
+	const auto baseNeedsDisplacement = takeFirst3Bits(base) == 0b101;
+	emitModRm(baseNeedsDisplacement ? 0b01 : 0b00, takeFirst3Bits(destination), 0b100);
+	emitU8(u8(std::countr_zero(i.scale) << 6) | u8(takeFirst3Bits(index) << 3) | takeFirst3Bits(base));
+	if (baseNeedsDisplacement) {
+		emitI8(0);
+	}
+}
+
+void MachineCode::emitRipRelativeDataOperand(DataLabel label) {
 	const auto operandCodeOffset = currentLocation();
 	emitU32(0);
 
-	ASSERT(i.source < dataLabelToDataOffset.size());
-	const auto dataOffset = dataLabelToDataOffset[i.source];
+	ASSERT(label < dataLabelToDataOffset.size());
+	const auto dataOffset = dataLabelToDataOffset[label];
 
 	ripRelativeDataOperands.push_back(RipRelativeDataOperand{
 		.operandCodeOffset = operandCodeOffset,
@@ -354,6 +464,29 @@ void MachineCode::emit(const VmovapsMemYmm& i) {
 	emitInstructionYmmRegDisp(0x29, regIndex(i.source), regIndex(i.destinationAddressReg), i.addressOffset);
 }
 
+void MachineCode::emit(const VmovupsYmmMem& i) {
+	emitInstructionYmmRegDisp(0x10, regIndex(i.destination), regIndex(i.sourceAddressReg), i.addressOffset);
+}
+
+void MachineCode::emit(const VmovupsMemYmm& i) {
+	emitInstructionYmmRegDisp(0x11, regIndex(i.source), regIndex(i.destinationAddressReg), i.addressOffset);
+}
+
+void MachineCode::emitInstruction0F38YmmRegDisp(u8 opCode, u8 reg, u8 vvvv, u8 regWithAddress, i32 disp) {
+	const auto negatedVvvv = ~vvvv & 0b1111;
+	emit3ByteVex(!take4thBit(reg), 1, !take4thBit(regWithAddress), 0b00010, 0, negatedVvvv, 1, 0b01);
+	emitU8(opCode);
+	emitModRmRegDisp(takeFirst3Bits(reg), takeFirst3Bits(regWithAddress), disp);
+}
+
+void MachineCode::emit(const VmaskmovpsYmmMem& i) {
+	emitInstruction0F38YmmRegDisp(0x2C, regIndex(i.destination), regIndex(i.mask), regIndex(i.sourceAddressReg), i.addressOffset);
+}
+
+void MachineCode::emit(const VmaskmovpsMemYmm& i) {
+	emitInstruction0F38YmmRegDisp(0x2E, regIndex(i.source), regIndex(i.mask), regIndex(i.destinationAddressReg), i.addressOffset);
+}
+
 void MachineCode::emit(const VaddpsYmmYmmYmm& i) {
 	emitInstructionYmmYmmYmm(0x58, regIndex(i.destination), regIndex(i.lhs), regIndex(i.rhs));
 }
@@ -370,10 +503,141 @@ void MachineCode::emit(const VdivpsYmmYmmYmm& i) {
 	emitInstructionYmmYmmYmm(0x5E, regIndex(i.destination), regIndex(i.lhs), regIndex(i.rhs));
 }
 
+// The packed double versions have the same opcodes as the packed single versions with the 0x66 prefix.
+void MachineCode::emit(const VaddpdYmmYmmYmm& i) {
+	emitInstructionYmmYmmYmm(0x58, regIndex(i.destination), regIndex(i.lhs), regIndex(i.rhs), 0b01);
+}
+
+void MachineCode::emit(const VsubpdYmmYmmYmm& i) {
+	emitInstructionYmmYmmYmm(0x5C, regIndex(i.destination), regIndex(i.lhs), regIndex(i.rhs), 0b01);
+}
+
+void MachineCode::emit(const VmulpdYmmYmmYmm& i) {
+	emitInstructionYmmYmmYmm(0x59, regIndex(i.destination), regIndex(i.lhs), regIndex(i.rhs), 0b01);
+}
+
+void MachineCode::emit(const VdivpdYmmYmmYmm& i) {
+	emitInstructionYmmYmmYmm(0x5E, regIndex(i.destination), regIndex(i.lhs), regIndex(i.rhs), 0b01);
+}
+
 void MachineCode::emit(const VxorpsYmmYmmYmm& i) {
 	emitInstructionYmmYmmYmm(0x57, regIndex(i.destination), regIndex(i.lhs), regIndex(i.rhs));
 }
 
+void MachineCode::emit(const VandpsYmmYmmYmm& i) {
+	emitInstructionYmmYmmYmm(0x54, regIndex(i.destination), regIndex(i.lhs), regIndex(i.rhs));
+}
+
+void MachineCode::emit(const VminpsYmmYmmYmm& i) {
+	emitInstructionYmmYmmYmm(0x5D, regIndex(i.destination), regIndex(i.lhs), regIndex(i.rhs));
+}
+
+void MachineCode::emit(const VmaxpsYmmYmmYmm& i) {
+	emitInstructionYmmYmmYmm(0x5F, regIndex(i.destination), regIndex(i.lhs), regIndex(i.rhs));
+}
+
+void MachineCode::emit(const VcmppsYmmYmmYmm& i) {
+	emitInstructionYmmYmmYmm(0xC2, regIndex(i.destination), regIndex(i.lhs), regIndex(i.rhs));
+	emitU8(static_cast<u8>(i.predicate));
+}
+
+void MachineCode::emit(const VblendvpsYmmYmmYmmYmm& i) {
+	// VEX.256.66.0F3A.W0 4A /r /is4
+	const auto destination = regIndex(i.destination);
+	const auto rhs = regIndex(i.rhs);
+	const auto negatedLhs = ~regIndex(i.lhs) & 0b1111;
+	emit3ByteVex(!take4thBit(destination), 1, !take4thBit(rhs), 0b00011, 0, negatedLhs, 1, 0b01);
+	emitU8(0x4A);
+	emitModRmDirectAddressing(takeFirst3Bits(destination), takeFirst3Bits(rhs));
+	emitU8(regIndex(i.mask) << 4);
+}
+
+void MachineCode::emit(const VpadddYmmYmmYmm& i) {
+	emitInstructionYmmYmmYmm(0xFE, regIndex(i.destination), regIndex(i.lhs), regIndex(i.rhs), 0b01);
+}
+
+void MachineCode::emitVexRegReg(u8 m_mmmm, u8 pp, bool l, bool w, u8 opCode, u8 reg, u8 vvvv, u8 rm) {
+	emit3ByteVex(!take4thBit(reg), 1, !take4thBit(rm), m_mmmm, w, ~vvvv & 0b1111, l, pp);
+	emitU8(opCode);
+	emitModRmDirectAddressing(takeFirst3Bits(reg), takeFirst3Bits(rm));
+}
+
+void MachineCode::emitVexRegDisp(u8 m_mmmm, u8 pp, bool l, bool w, u8 opCode, u8 reg, u8 vvvv, u8 regWithAddress, i32 disp) {
+	emit3ByteVex(!take4thBit(reg), 1, !take4thBit(regWithAddress), m_mmmm, w, ~vvvv & 0b1111, l, pp);
+	emitU8(opCode);
+	emitModRmRegDisp(takeFirst3Bits(reg), takeFirst3Bits(regWithAddress), disp);
+}
+
+void MachineCode::emit(const Vcvtdq2psYmmYmm& i) {
+	// VEX.256.0F.WIG 5B /r
+	emitVexRegReg(0b00001, 0b00, 1, 0, 0x5B, regIndex(i.destination), 0, regIndex(i.source));
+}
+
+void MachineCode::emit(const Vcvtps2dqYmmYmm& i) {
+	// VEX.256.66.0F.WIG 5B /r
+	emitVexRegReg(0b00001, 0b01, 1, 0, 0x5B, regIndex(i.destination), 0, regIndex(i.source));
+}
+
+void MachineCode::emit(const VpmovzxbdYmmMem& i) {
+	// VEX.256.66.0F38.WIG 31 /r
+	emitVexRegDisp(0b00010, 0b01, 1, 0, 0x31, regIndex(i.destination), 0, regIndex(i.sourceAddressReg), i.addressOffset);
+}
+
+void MachineCode::emit(const Vcvtph2psYmmMem& i) {
+	// VEX.256.66.0F38.W0 13 /r
+	emitVexRegDisp(0b00010, 0b01, 1, 0, 0x13, regIndex(i.destination), 0, regIndex(i.sourceAddressReg), i.addressOffset);
+}
+
+void MachineCode::emit(const Vcvtps2phMemYmm& i) {
+	// VEX.256.66.0F3A.W0 1D /r ib
+	emitVexRegDisp(0b00011, 0b01, 1, 0, 0x1D, regIndex(i.source), 0, regIndex(i.destinationAddressReg), i.addressOffset);
+	// Round to nearest even.
+	emitU8(0b000);
+}
+
+void MachineCode::emit(const Vcvtpd2psXmmMem& i) {
+	// VEX.256.66.0F.WIG 5A /r
+	emitVexRegDisp(0b00001, 0b01, 1, 0, 0x5A, regIndex(i.destination), 0, regIndex(i.sourceAddressReg), i.addressOffset);
+}
+
+void MachineCode::emit(const Vcvtps2pdYmmXmm& i) {
+	// VEX.256.0F.WIG 5A /r
+	emitVexRegReg(0b00001, 0b00, 1, 0, 0x5A, regIndex(i.destination), 0, regIndex(i.source));
+}
+
+void MachineCode::emit(const Vinsertf128YmmYmmXmm& i) {
+	// VEX.256.66.0F3A.W0 18 /r ib
+	emitVexRegReg(0b00011, 0b01, 1, 0, 0x18, regIndex(i.destination), regIndex(i.lhs), regIndex(i.rhs));
+	emitU8(i.index);
+}
+
+void MachineCode::emit(const Vextractf128XmmYmm& i) {
+	// VEX.256.66.0F3A.W0 19 /r ib, the source is in modrm.reg.
+	emitVexRegReg(0b00011, 0b01, 1, 0, 0x19, regIndex(i.source), 0, regIndex(i.destination));
+	emitU8(i.index);
+}
+
+void MachineCode::emit(const VpackusdwYmmYmmYmm& i) {
+	// VEX.256.66.0F38.WIG 2B /r
+	emitVexRegReg(0b00010, 0b01, 1, 0, 0x2B, regIndex(i.destination), regIndex(i.lhs), regIndex(i.rhs));
+}
+
+void MachineCode::emit(const VpermqYmmYmmImm& i) {
+	// VEX.256.66.0F3A.W1 00 /r ib
+	emitVexRegReg(0b00011, 0b01, 1, 1, 0x00, regIndex(i.destination), 0, regIndex(i.source));
+	emitU8(i.selector);
+}
+
+void MachineCode::emit(const VpackuswbXmmXmmXmm& i) {
+	// VEX.128.66.0F.WIG 67 /r
+	emitVexRegReg(0b00001, 0b01, 0, 0, 0x67, regIndex(i.destination), regIndex(i.lhs), regIndex(i.rhs));
+}
+
+void MachineCode::emit(const VmovqMemXmm& i) {
+	// VEX.128.66.0F.WIG D6 /r
+	emitVexRegDisp(0b00001, 0b01, 0, 0, 0xD6, regIndex(i.source), 0, regIndex(i.destinationAddressReg), i.addressOffset);
+}
+
 void MachineCode::emit(const Vzeroupper& i) {
 	emit2ByteVex(1, 0b1111, 0, 00);
 	emitU8(0x77);
@@ -10,6 +10,12 @@ struct MachineCode {
 
 	void patchRipRelativeOperands(u8* code, const u8* data) const;
 
+	// The data is placed right after the code so the rip relative operands are not outside the i32 range.
+	static constexpr i64 DATA_ALIGNMENT = 16;
+	i64 sizeWithData() const;
+	// Copies the code followed by the data into memory and patches the rip relative operands. The memory has to be at least sizeWithData() bytes big.
+	void copyWithData(u8* memory) const;
+
 	void emitU8(u8 value);
 	void emitI8(i8 value);
 	void emitU32(u32 value);
@@ -47,7 +53,8 @@ struct MachineCode {
 	void emit2ByteVex(bool r, u8 vvvv, bool l, u8 pp);
 	void emit3ByteVex(bool r, bool x, bool b, u8 m_mmmm, bool w, u8 vvvv, bool l, u8 pp);
 
-	void emitInstructionYmmYmmYmm(u8 opCode, u8 a, u8 b, u8 c);
+	void emitInstructionYmmYmmYmm(u8 opCode, u8 a, u8 b, u8 c, u8 pp = 0b00);
+	void emitRipRelativeDataOperand(DataLabel label);
 	void emitReg64Reg64Instruction(u8 opCode, Reg64 lhs, Reg64 rhs);
 	void emitReg64ImmInstruction(u8 opCode, u8 opCodeExtension, Reg64 lhs, u32 rhs);
 
@@ -61,20 +68,62 @@ struct MachineCode {
 	void emit(const AndR8Imm& i);
 	void emit(const AddR64Imm& i);
 	void emit(const SubR64Imm& i);
+	void emit(const AddR64R64& i);
+	void emit(const SubR64R64& i);
+	void emit(const ShlR64Imm& i);
 	void emit(const Inc64& i);
 	void emit(const CmpR64R64& i);
+	void emit(const CmpR64Imm& i);
 	void emit(const MovR64R64& i);
+	void emit(const MovR64Mem& i);
 	void emit(const MovR64Imm64& i);
+	void emit(const LeaR64Lbl& i);
+	void emit(const LeaR64Sib& i);
 	void emit(const VbroadcastssLbl& i);
+	void emit(const VbroadcastssYmmMem& i);
+	void emit(const VbroadcastsdLbl& i);
+	void emit(const VbroadcastsdYmmMem& i);
 	void emit(const VmovapsYmmYmm& i);
 	void emitInstructionYmmRegDisp(u8 opCode, u8 reg, u8 regWithAddress, i32 disp);
 	void emit(const VmovapsYmmMem& i);
 	void emit(const VmovapsMemYmm& i);
+	void emit(const VmovupsYmmMem& i);
+	void emit(const VmovupsMemYmm& i);
+	// Instructions in the 0F38 opcode map require the 3 byte VEX prefix.
+	void emitInstruction0F38YmmRegDisp(u8 opCode, u8 reg, u8 vvvv, u8 regWithAddress, i32 disp);
+	void emit(const VmaskmovpsYmmMem& i);
+	void emit(const VmaskmovpsMemYmm& i);
 	void emit(const VaddpsYmmYmmYmm& i);
 	void emit(const VsubpsYmmYmmYmm& i);
 	void emit(const VmulpsYmmYmmYmm& i);
 	void emit(const VdivpsYmmYmmYmm& i);
+	void emit(const VaddpdYmmYmmYmm& i);
+	void emit(const VsubpdYmmYmmYmm& i);
+	void emit(const VmulpdYmmYmmYmm& i);
+	void emit(const VdivpdYmmYmmYmm& i);
 	void emit(const VxorpsYmmYmmYmm& i);
+	void emit(const VandpsYmmYmmYmm& i);
+	void emit(const VminpsYmmYmmYmm& i);
+	void emit(const VmaxpsYmmYmmYmm& i);
+	void emit(const VcmppsYmmYmmYmm& i);
+	void emit(const VblendvpsYmmYmmYmmYmm& i);
+	void emit(const VpadddYmmYmmYmm& i);
+	// Always use the 3 byte VEX prefix. rm is either a register or [regWithAddress + disp]. vvvv isn't negated.
+	void emitVexRegReg(u8 m_mmmm, u8 pp, bool l, bool w, u8 opCode, u8 reg, u8 vvvv, u8 rm);
+	void emitVexRegDisp(u8 m_mmmm, u8 pp, bool l, bool w, u8 opCode, u8 reg, u8 vvvv, u8 regWithAddress, i32 disp);
+	void emit(const Vcvtdq2psYmmYmm& i);
+	void emit(const Vcvtps2dqYmmYmm& i);
+	void emit(const VpmovzxbdYmmMem& i);
+	void emit(const Vcvtph2psYmmMem& i);
+	void emit(const Vcvtps2phMemYmm& i);
+	void emit(const Vcvtpd2psXmmMem& i);
+	void emit(const Vcvtps2pdYmmXmm& i);
+	void emit(const Vinsertf128YmmYmmXmm& i);
+	void emit(const Vextractf128XmmYmm& i);
+	void emit(const VpackusdwYmmYmmYmm& i);
+	void emit(const VpermqYmmYmmImm& i);
+	void emit(const VpackuswbXmmXmmXmm& i);
+	void emit(const VmovqMemXmm& i);
 	void emit(const Vzeroupper& i);
 
 	std::vector<u8> code;
@@ -92,6 +141,16 @@ struct MachineCode {
 	};
 	std::vector<RipRelativeDataOperand> ripRelativeDataOperands;
 
+	// The 64 bit immediates holding the addresses of the called functions.
+	struct FunctionAddressOperand {
+		i64 operandCodeOffset;
+		// Index in the function table used to generate the code.
+		i64 functionIndex;
+	};
+	std::vector<FunctionAddressOperand> functionAddressOperands;
+	// Replaces the function addresses with addresses[functionIndex]. Used when the code is loaded into a process with different function addresses.
+	void patchFunctionAddresses(std::span<void* const> addresses);
+
 	// Why bother storing nextInstructionCodeOffset if it is just operandCodeOffset.
 	struct RipRelativeJump {
 		i64 operandCodeOffset;
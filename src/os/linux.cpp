@@ -0,0 +1,161 @@
+#ifdef __linux__
+
+#include "os.hpp"
+#include "../utils/asserts.hpp"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+i64 pageSize() {
+	return sysconf(_SC_PAGESIZE);
+}
+
+DualMappedPages allocateDualMappedPages(i64 size) {
+	const DualMappedPages failed{ .writable = nullptr, .executable = nullptr };
+	const auto file = memfd_create("code", MFD_CLOEXEC);
+	if (file == -1) {
+		return failed;
+	}
+	if (ftruncate(file, size) != 0) {
+		close(file);
+		return failed;
+	}
+	const auto writable = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	const auto executable = mmap(nullptr, size, PROT_READ | PROT_EXEC, MAP_SHARED, file, 0);
+	// The mappings keep the memory alive.
+	close(file);
+	if (writable == MAP_FAILED || executable == MAP_FAILED) {
+		if (writable != MAP_FAILED) {
+			munmap(writable, size);
+		}
+		if (executable != MAP_FAILED) {
+			munmap(executable, size);
+		}
+		return failed;
+	}
+	return DualMappedPages{ .writable = reinterpret_cast<u8*>(writable), .executable = reinterpret_cast<u8*>(executable) };
+}
+
+void freeDualMappedPages(const DualMappedPages& pages, i64 size) {
+	[[maybe_unused]] const auto writableRet = munmap(pages.writable, size);
+	ASSERT(writableRet == 0);
+	[[maybe_unused]] const auto executableRet = munmap(pages.executable, size);
+	ASSERT(executableRet == 0);
+}
+
+void flushInstructionCache(const void*, i64) {
+	// x86 keeps the instruction cache coherent even if the code is written through a different mapping.
+}
+
+void* mapFile(const char* path, i64& size, bool writable) {
+	const auto file = writable
+		? open(path, O_RDWR | O_CREAT | O_TRUNC, 0644)
+		: open(path, O_RDONLY);
+	if (file == -1) {
+		return nullptr;
+	}
+	if (writable) {
+		if (ftruncate(file, size) != 0) {
+			close(file);
+			return nullptr;
+		}
+	} else {
+		struct stat fileStat;
+		if (fstat(file, &fileStat) != 0) {
+			close(file);
+			return nullptr;
+		}
+		size = fileStat.st_size;
+	}
+	if (size == 0) {
+		close(file);
+		return nullptr;
+	}
+
+	const auto memory = mmap(nullptr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, file, 0);
+	// The mapping keeps a reference to the file.
+	close(file);
+	if (memory == MAP_FAILED) {
+		return nullptr;
+	}
+	return memory;
+}
+
+void unmapFile(void* memory, i64 size) {
+	[[maybe_unused]] const auto ret = munmap(memory, size);
+	ASSERT(ret == 0);
+}
+
+bool flushMappedFile(void* memory, i64 size) {
+	return msync(memory, size, MS_SYNC) == 0;
+}
+
+void adviseSequentialAccess(void* memory, i64 size) {
+	madvise(memory, size, MADV_SEQUENTIAL);
+}
+
+i64 processId() {
+	return getpid();
+}
+
+bool pinCurrentThreadToCore(i64 core) {
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(core % sysconf(_SC_NPROCESSORS_ONLN), &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+static i64 openHardwareCounter(u32 type, u64 config) {
+	perf_event_attr attributes{};
+	attributes.size = sizeof(attributes);
+	attributes.type = type;
+	attributes.config = config;
+	// Counting only the user mode events is allowed with the default perf_event_paranoid setting.
+	attributes.exclude_kernel = 1;
+	attributes.exclude_hv = 1;
+	// glibc doesn't have a wrapper for this syscall.
+	return syscall(SYS_perf_event_open, &attributes, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+bool openHardwareCounters(HardwareCounters& counters) {
+	static constexpr u64 cacheReadMiss = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	counters.handles[i64(HardwareEvent::CYCLES)] = openHardwareCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+	counters.handles[i64(HardwareEvent::INSTRUCTIONS)] = openHardwareCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+	counters.handles[i64(HardwareEvent::L1D_READ_MISSES)] = openHardwareCounter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | cacheReadMiss);
+	counters.handles[i64(HardwareEvent::LLC_MISSES)] = openHardwareCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+	// Without cycles none of the derived metrics can be computed.
+	if (counters.handles[i64(HardwareEvent::CYCLES)] < 0) {
+		closeHardwareCounters(counters);
+		return false;
+	}
+	return true;
+}
+
+void closeHardwareCounters(HardwareCounters& counters) {
+	for (auto& handle : counters.handles) {
+		if (handle >= 0) {
+			close(int(handle));
+		}
+		handle = -1;
+	}
+}
+
+void readHardwareCounters(const HardwareCounters& counters, i64 values[HARDWARE_EVENT_COUNT]) {
+	for (i64 i = 0; i < HARDWARE_EVENT_COUNT; i++) {
+		values[i] = 0;
+		if (counters.handles[i] < 0) {
+			continue;
+		}
+		u64 value;
+		if (read(int(counters.handles[i]), &value, sizeof(value)) == sizeof(value)) {
+			values[i] = i64(value);
+		}
+	}
+}
+
+#endif
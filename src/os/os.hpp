@@ -2,6 +2,47 @@
 
 #include "../utils/ints.hpp"
 
-// Can be nullptr.
-void* allocateExecutableMemory(i64 size);
-void freeExecutableMemory(void* memory);
\ No newline at end of file
+i64 pageSize();
+// Maps the same pages twice, once readable and writable and once readable and executable. Code can be written through the writable view while other code in the executable view is running, so the protection never has to be changed. The size has to be a multiple of the page size. Both pointers are nullptr on failure.
+struct DualMappedPages {
+	u8* writable;
+	u8* executable;
+};
+DualMappedPages allocateDualMappedPages(i64 size);
+void freeDualMappedPages(const DualMappedPages& pages, i64 size);
+// Has to be called after writing code through the writable view before executing it.
+void flushInstructionCache(const void* memory, i64 size);
+
+// Maps a file into memory. If writable is true the file is created or truncated to size bytes and the writes to the memory are written to the file. Otherwise the whole existing file is mapped read only and size is set to its size. Returns nullptr on failure or if the file is empty.
+void* mapFile(const char* path, i64& size, bool writable);
+void unmapFile(void* memory, i64 size);
+// Writes the modified pages to the file.
+bool flushMappedFile(void* memory, i64 size);
+// Hints that the memory will be accessed sequentially so more of it can be read ahead and the pages that were already accessed can be dropped first.
+void adviseSequentialAccess(void* memory, i64 size);
+
+i64 processId();
+
+// The core index is wrapped around the number of cores.
+bool pinCurrentThreadToCore(i64 core);
+
+
+enum class HardwareEvent {
+	CYCLES,
+	INSTRUCTIONS,
+	L1D_READ_MISSES,
+	LLC_MISSES,
+	COUNT
+};
+static constexpr i64 HARDWARE_EVENT_COUNT = i64(HardwareEvent::COUNT);
+
+// Counters of the hardware events caused by the calling thread in user mode. The counters only count the events of the thread that opened them.
+struct HardwareCounters {
+	// -1 if the event isn't supported.
+	i64 handles[HARDWARE_EVENT_COUNT];
+};
+// Returns false if the counters aren't available, for example on Windows or if the kernel doesn't allow it (see /proc/sys/kernel/perf_event_paranoid). The events that are not supported by the CPU read as 0.
+bool openHardwareCounters(HardwareCounters& counters);
+void closeHardwareCounters(HardwareCounters& counters);
+// The values only increase so the events of a piece of code are the difference of the values read before and after it.
+void readHardwareCounters(const HardwareCounters& counters, i64 values[HARDWARE_EVENT_COUNT]);
@@ -1,22 +1,146 @@
 #ifdef _WIN32
 
+#include "os.hpp"
 #include "../utils/ints.hpp"
 #include "../utils/asserts.hpp"
 #include <windows.h>
 
-void* allocateExecutableMemory(i64 size) {
-	return reinterpret_cast<u8*>(VirtualAllocEx(
-		GetCurrentProcess(),
-		nullptr, // No desired starting address
-		size, // Rounds to page size
-		MEM_COMMIT,
-		PAGE_EXECUTE_READWRITE
-	));
+i64 pageSize() {
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	// The views of file mappings start at multiples of the allocation granularity so smaller regions would waste address space.
+	return info.dwAllocationGranularity;
 }
 
-void freeExecutableMemory(void* memory) {
-	const auto ret = VirtualFreeEx(GetCurrentProcess(), memory, 0, MEM_RELEASE);
+DualMappedPages allocateDualMappedPages(i64 size) {
+	const DualMappedPages failed{ .writable = nullptr, .executable = nullptr };
+	const auto mapping = CreateFileMappingA(
+		INVALID_HANDLE_VALUE, // Backed by the page file
+		nullptr,
+		PAGE_EXECUTE_READWRITE | SEC_COMMIT,
+		DWORD(u64(size) >> 32),
+		DWORD(u64(size) & 0xFFFFFFFF),
+		nullptr
+	);
+	if (mapping == nullptr) {
+		return failed;
+	}
+	const auto writable = MapViewOfFile(mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, size);
+	const auto executable = MapViewOfFile(mapping, FILE_MAP_READ | FILE_MAP_EXECUTE, 0, 0, size);
+	// The views keep the mapping alive.
+	CloseHandle(mapping);
+	if (writable == nullptr || executable == nullptr) {
+		if (writable != nullptr) {
+			UnmapViewOfFile(writable);
+		}
+		if (executable != nullptr) {
+			UnmapViewOfFile(executable);
+		}
+		return failed;
+	}
+	return DualMappedPages{ .writable = reinterpret_cast<u8*>(writable), .executable = reinterpret_cast<u8*>(executable) };
+}
+
+void freeDualMappedPages(const DualMappedPages& pages, i64 size) {
+	[[maybe_unused]] const auto writableRet = UnmapViewOfFile(pages.writable);
+	ASSERT(writableRet);
+	[[maybe_unused]] const auto executableRet = UnmapViewOfFile(pages.executable);
+	ASSERT(executableRet);
+}
+
+void flushInstructionCache(const void* memory, i64 size) {
+	// Without this the processor might execute stale instructions.
+	FlushInstructionCache(GetCurrentProcess(), memory, size);
+}
+
+void* mapFile(const char* path, i64& size, bool writable) {
+	const auto file = CreateFileA(
+		path,
+		writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+		FILE_SHARE_READ,
+		nullptr,
+		writable ? CREATE_ALWAYS : OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+		nullptr
+	);
+	if (file == INVALID_HANDLE_VALUE) {
+		return nullptr;
+	}
+	if (!writable) {
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize)) {
+			CloseHandle(file);
+			return nullptr;
+		}
+		size = fileSize.QuadPart;
+	}
+	if (size == 0) {
+		CloseHandle(file);
+		return nullptr;
+	}
+
+	// Creating a writable mapping of the given size extends the file.
+	const auto mapping = CreateFileMappingA(
+		file,
+		nullptr,
+		writable ? PAGE_READWRITE : PAGE_READONLY,
+		DWORD(u64(size) >> 32),
+		DWORD(u64(size) & 0xFFFFFFFF),
+		nullptr
+	);
+	CloseHandle(file);
+	if (mapping == nullptr) {
+		return nullptr;
+	}
+	// The view keeps a reference to the mapping.
+	const auto memory = MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size);
+	CloseHandle(mapping);
+	return memory;
+}
+
+void unmapFile(void* memory, i64 size) {
+	[[maybe_unused]] const auto ret = UnmapViewOfFile(memory);
 	ASSERT(ret);
 }
 
+bool flushMappedFile(void* memory, i64 size) {
+	// FlushViewOfFile doesn't wait for the data to be written to the disk.
+	return FlushViewOfFile(memory, size);
+}
+
+void adviseSequentialAccess(void* memory, i64 size) {
+	// The file is opened with FILE_FLAG_SEQUENTIAL_SCAN which has the same effect.
+}
+
+i64 processId() {
+	return GetCurrentProcessId();
+}
+
+bool pinCurrentThreadToCore(i64 core) {
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	const auto mask = DWORD_PTR(1) << (core % info.dwNumberOfProcessors);
+	return SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+}
+
+// Reading the hardware counters on Windows requires a kernel driver.
+bool openHardwareCounters(HardwareCounters& counters) {
+	for (auto& handle : counters.handles) {
+		handle = -1;
+	}
+	return false;
+}
+
+void closeHardwareCounters(HardwareCounters& counters) {
+	for (auto& handle : counters.handles) {
+		handle = -1;
+	}
+}
+
+void readHardwareCounters(const HardwareCounters&, i64 values[HARDWARE_EVENT_COUNT]) {
+	for (i64 i = 0; i < HARDWARE_EVENT_COUNT; i++) {
+		values[i] = 0;
+	}
+}
+
 #endif
\ No newline at end of file
@@ -124,7 +124,7 @@ Expr* Parser::primaryExpr() {
 	if (match(TokenType::FLOAT)) {
 		const auto& numberToken = peekPrevious();
 		const auto numberTokenSource = tokenSource(numberToken);
-		Real value;
+		RealConstant value;
 		const auto result = std::from_chars(
 			numberTokenSource.data(), 
 			numberTokenSource.data() + numberTokenSource.length(), 
@@ -1,95 +1,215 @@
 #include "runtime.hpp"
-#include "os/os.hpp"
 #include "utils/rounding.hpp"
 #include "utils/asserts.hpp"
 #include "simdFunctions.hpp"
+#include "os/os.hpp"
+#include <cstring>
+#include <algorithm>
+#include <new>
 
 Runtime::Runtime(ScannerMessageReporter& scannerReporter, ParserMessageReporter& parserReporter, IrCompilerMessageReporter& irCompilerReporter)
     : scannerReporter(scannerReporter)
     , parserReporter(parserReporter)
     , irCompilerReporter(irCompilerReporter) {
     
-    functions.push_back({ .name = "exp", .arity = 1, .address = expSimd, });
-    functions.push_back({ .name = "ln", .arity = 1, .address = lnSimd, });
-    functions.push_back({ .name = "sin", .arity = 1, .address = sinSimd, });
-    functions.push_back({ .name = "cos", .arity = 1, .address = cosSimd, });
-    functions.push_back({ .name = "sqrt", .arity = 1, .address = sqrtSimd, });
+    functions.push_back({ .name = "exp", .arity = 1, .address = reinterpret_cast<void*>(expSimd), .addressF64 = reinterpret_cast<void*>(expSimdF64), });
+    functions.push_back({ .name = "ln", .arity = 1, .address = reinterpret_cast<void*>(lnSimd), .addressF64 = reinterpret_cast<void*>(lnSimdF64), });
+    functions.push_back({ .name = "sin", .arity = 1, .address = reinterpret_cast<void*>(sinSimd), .addressF64 = reinterpret_cast<void*>(sinSimdF64), });
+    functions.push_back({ .name = "cos", .arity = 1, .address = reinterpret_cast<void*>(cosSimd), .addressF64 = reinterpret_cast<void*>(cosSimdF64), });
+    functions.push_back({ .name = "sqrt", .arity = 1, .address = reinterpret_cast<void*>(sqrtSimd), .addressF64 = reinterpret_cast<void*>(sqrtSimdF64), });
 }
 
 #include "utils/fileIo.hpp"
 
+// The reduction combines the values of a single output. The grid layout evaluates the rows with separate calls and doesn't support reductions. The F64 code only has the BLOCKS and COLUMNS layouts. The typed columns are only converted by the F32 COLUMNS code without a reduction.
+static bool isSupportedConfiguration(usize outputCount, InputLayout inputLayout, Reduction reduction, Precision precision, std::span<const Variable> variables, std::span<const ElementType> outputTypes) {
+    if (reduction != Reduction::NONE && (outputCount != 1 || inputLayout == InputLayout::GRID)) {
+        return false;
+    }
+    if (precision == Precision::F64 && (reduction != Reduction::NONE || inputLayout == InputLayout::GRID)) {
+        return false;
+    }
+    const auto hasTypedColumns =
+        std::ranges::any_of(variables, [](const Variable& v) { return !v.isUniform && v.elementType != ElementType::F32; }) ||
+        std::ranges::any_of(outputTypes, [](ElementType type) { return type != ElementType::F32; });
+    if (hasTypedColumns && (inputLayout != InputLayout::COLUMNS || precision != Precision::F32 || reduction != Reduction::NONE)) {
+        return false;
+    }
+    return outputTypes.size() <= outputCount;
+}
+
 std::optional<Runtime::LoopFunction> Runtime::compileFunction(
     std::string_view source, 
-    std::span<const Variable> variables) {
+    std::span<const Variable> variables,
+    InputLayout inputLayout,
+    Reduction reduction,
+    Precision precision,
+    std::span<const ElementType> outputTypes) {
+    const std::string_view sources[] = { source };
+    return compileFunction(sources, variables, inputLayout, reduction, precision, outputTypes);
+}
 
-    const auto ir = compileToIr(source, variables);
+std::optional<Runtime::LoopFunction> Runtime::compileFunction(
+    std::span<const std::string_view> sources,
+    std::span<const Variable> variables,
+    InputLayout inputLayout,
+    Reduction reduction,
+    Precision precision,
+    std::span<const ElementType> outputTypes) {
+
+    const auto ir = compileToIr(sources, variables, precision);
     if (!ir.has_value()) {
         return std::nullopt;
     }
 
-    const auto& machineCode = codeGenerator.compile(*ir, functions, variables);
+    if (!isSupportedConfiguration(sources.size(), inputLayout, reduction, precision, variables, outputTypes)) {
+        ASSERT_NOT_REACHED();
+        return std::nullopt;
+    }
+
+    const auto machineCode = context.generateMachineCode(*ir, functions, variables, inputLayout, reduction, precision, outputTypes);
     //outputToFile("test.bin", machineCode.code);
 
-    return LoopFunction(machineCode);
+    return placeFunction(context, machineCode, sources, variables, inputLayout, reduction, precision, outputTypes);
 }
 
 std::optional<std::vector<IrOp>> Runtime::compileToIr(
     std::string_view source,
-    std::span<const Variable> variables) {
+    std::span<const Variable> variables,
+    Precision precision) {
+    const std::string_view sources[] = { source };
+    return compileToIr(sources, variables, precision);
+}
+
+std::optional<std::vector<IrOp>> Runtime::compileToIr(
+    std::span<const std::string_view> sources,
+    std::span<const Variable> variables,
+    Precision precision) {
+    return context.compileToIr(sources, variables, functions, scannerReporter, parserReporter, irCompilerReporter, precision);
+}
 
-    const auto& tokens = scanner.parse(source, functions, variables, scannerReporter);
-    const auto& ast = parser.parse(tokens, source, parserReporter);
-    if (!ast.has_value()) {
+std::optional<MachineCode> Runtime::compileToMachineCode(
+    CompilationContext& context,
+    std::span<const std::string_view> sources,
+    std::span<const Variable> variables,
+    InputLayout inputLayout,
+    Reduction reduction,
+    Precision precision,
+    std::span<const ElementType> outputTypes) {
+
+    const auto ir = context.compileToIr(sources, variables, functions, precision);
+    if (!ir.has_value()) {
         return std::nullopt;
     }
-    const auto& irCode = compiler.compile(*ast, variables, functions, irCompilerReporter);
-    if (!irCode.has_value()) {
+    if (!isSupportedConfiguration(sources.size(), inputLayout, reduction, precision, variables, outputTypes)) {
+        ASSERT_NOT_REACHED();
         return std::nullopt;
     }
-
-    std::vector<IrOp> a = *irCode;
-    std::vector<IrOp> b;
-
-    std::vector<IrOp>* input = &a;
-    std::vector<IrOp>* output = &b;
-    auto swap = [&]() -> void {
-        std::swap(input, output);
-    };
-    auto result = [&]() -> const std::vector<IrOp>& {
-        return *input;
-    };
-
-    valueNumbering.run(*input, variables, *output);
-    swap();
-
-    deadCodeElimination.run(*input, variables, *output);
-    swap();
-
-    return result();
+    return context.generateMachineCode(*ir, functions, variables, inputLayout, reduction, precision, outputTypes);
 }
 
-Runtime::LoopFunction::LoopFunction(const MachineCode& machineCode) {
-    const auto alignment = 16;
-    const auto memory = reinterpret_cast<u8*>(allocateExecutableMemory(machineCode.code.size() + machineCode.data.size() + alignment));
+std::optional<Runtime::LoopFunction> Runtime::compileFunction(
+    CompilationContext& context,
+    std::span<const std::string_view> sources,
+    std::span<const Variable> variables,
+    InputLayout inputLayout,
+    Reduction reduction,
+    Precision precision,
+    std::span<const ElementType> outputTypes) {
+
+    const auto machineCode = compileToMachineCode(context, sources, variables, inputLayout, reduction, precision, outputTypes);
+    if (!machineCode.has_value()) {
+        return std::nullopt;
+    }
+    // The code heap is locked internally.
+    return placeFunction(context, *machineCode, sources, variables, inputLayout, reduction, precision, outputTypes);
+}
 
-    u8* code = memory;
-    memcpy(code, machineCode.code.data(), machineCode.code.size());
+Runtime::LoopFunction Runtime::placeFunction(
+    CompilationContext& context,
+    const MachineCode& machineCode,
+    std::span<const std::string_view> sources,
+    std::span<const Variable> variables,
+    InputLayout inputLayout,
+    Reduction reduction,
+    Precision precision,
+    std::span<const ElementType> outputTypes) {
+    std::optional<LoopFunction> function;
+    {
+        CompilationPhaseTimer timer(context.statsIfCollected(), CompilationStats::Phase::PLACEMENT);
+        function.emplace(codeHeap, machineCode, variables, inputLayout, i64(sources.size()), reduction, precision, outputTypes);
+        function->registerCode(sources);
+    }
+    context.recordStats();
+    return std::move(*function);
+}
 
-    // Use the same buffer for data so the rip relative operands are not outside the i32 range.
-    u8* data = roundAddressUpToMultiple(memory + machineCode.code.size(), alignment);
-    memcpy(data, machineCode.data.data(), machineCode.data.size());
-    machineCode.patchRipRelativeOperands(code, data);
-    function = reinterpret_cast<Function>(code);
+Runtime::LoopFunction::LoopFunction(CodeHeap& heap, const MachineCode& machineCode, std::span<const Variable> variables, InputLayout inputLayout, i64 outputCount, Reduction reduction, Precision precision, std::span<const ElementType> outputTypes)
+    : inputLayout(inputLayout)
+    , outputCount(outputCount)
+    , reduction(reduction)
+    , precision(precision)
+    , uniformCount(std::count_if(variables.begin(), variables.end(), [](const Variable& v) { return v.isUniform; }))
+    , inputVariableCount(i64(variables.size()) - uniformCount)
+    , outputTypes(outputTypes.begin(), outputTypes.end())
+    , heap(&heap)
+    , size(machineCode.sizeWithData()) {
+    for (const auto& variable : variables) {
+        if (!variable.isUniform) {
+            inputTypes.push_back(variable.elementType);
+        }
+    }
+    this->outputTypes.resize(outputCount, ElementType::F32);
+    const auto allocation = heap.allocate(size);
+    ASSERT(allocation.memory != nullptr);
+    // The rip relative operands only depend on the distance between the code and the data so they are the same in both views.
+    machineCode.copyWithData(allocation.writable);
+    flushInstructionCache(allocation.memory, size);
+    function = reinterpret_cast<Function>(allocation.memory);
+    debuggerEntry = nullptr;
 }
 
 Runtime::LoopFunction::LoopFunction(LoopFunction&& other) noexcept
-    : function(other.function) {
+    : function(other.function)
+    , inputLayout(other.inputLayout)
+    , outputCount(other.outputCount)
+    , reduction(other.reduction)
+    , precision(other.precision)
+    , uniformCount(other.uniformCount)
+    , inputVariableCount(other.inputVariableCount)
+    , inputTypes(std::move(other.inputTypes))
+    , outputTypes(std::move(other.outputTypes))
+    , heap(other.heap)
+    , size(other.size)
+    , profile(std::move(other.profile))
+    , debuggerEntry(other.debuggerEntry) {
     other.function = nullptr;
+    other.debuggerEntry = nullptr;
 }
 
 Runtime::LoopFunction& Runtime::LoopFunction::operator=(LoopFunction&& other) noexcept {
+    if (this == &other) {
+        return *this;
+    }
+    if (function != nullptr) {
+        jitCodeRegistry().unregisterCode(debuggerEntry);
+        heap->free(reinterpret_cast<u8*>(function));
+    }
     function = other.function;
+    inputLayout = other.inputLayout;
+    outputCount = other.outputCount;
+    reduction = other.reduction;
+    precision = other.precision;
+    uniformCount = other.uniformCount;
+    inputVariableCount = other.inputVariableCount;
+    inputTypes = std::move(other.inputTypes);
+    outputTypes = std::move(other.outputTypes);
+    heap = other.heap;
+    size = other.size;
+    profile = std::move(other.profile);
+    debuggerEntry = other.debuggerEntry;
     other.function = nullptr;
+    other.debuggerEntry = nullptr;
     return *this;
 }
 
@@ -97,23 +217,356 @@ Runtime::LoopFunction::~LoopFunction() {
     if (function == nullptr) {
         return;
     }
-    freeExecutableMemory(function);
+    jitCodeRegistry().unregisterCode(debuggerEntry);
+    heap->free(reinterpret_cast<u8*>(function));
+}
+
+void Runtime::LoopFunction::registerCode(std::span<const std::string_view> sources) {
+    auto& registry = jitCodeRegistry();
+    if (!registry.isEnabled() || debuggerEntry != nullptr) {
+        return;
+    }
+    debuggerEntry = registry.registerCode(JitCodeRegistry::symbolName(sources), reinterpret_cast<const u8*>(function), size);
+}
+
+void Runtime::LoopFunction::operator()(const float* input, float* output, i64 elementCount, std::span<const float> uniforms) const {
+    ASSERT(inputLayout == InputLayout::BLOCKS);
+    ASSERT(reduction == Reduction::NONE);
+    ASSERT(precision == Precision::F32);
+    const KernelProfile::Scope scope(profile.get(), elementCount, elementCount * bytesPerElement());
+    function(input, output, elementCount, uniforms.data());
+}
+
+void Runtime::LoopFunction::operator()(const double* input, double* output, i64 elementCount, std::span<const double> uniforms) const {
+    ASSERT(inputLayout == InputLayout::BLOCKS);
+    ASSERT(precision == Precision::F64);
+    const KernelProfile::Scope scope(profile.get(), elementCount, elementCount * bytesPerElement());
+    // The code doesn't depend on the pointer types.
+    function(reinterpret_cast<const float*>(input), reinterpret_cast<float*>(output), elementCount, reinterpret_cast<const float*>(uniforms.data()));
+}
+
+void Runtime::LoopFunction::operator()(std::span<const float* const> columns, std::span<float* const> outputs, i64 elementCount, std::span<const float> uniforms) const {
+    ASSERT(inputLayout == InputLayout::COLUMNS);
+    ASSERT(reduction == Reduction::NONE);
+    ASSERT(precision == Precision::F32);
+    ASSERT(!hasTypedColumns());
+    ASSERT(i64(outputs.size()) == outputCount);
+    const KernelProfile::Scope scope(profile.get(), elementCount, elementCount * bytesPerElement());
+    reinterpret_cast<ColumnsFunction>(function)(columns.data(), outputs.data(), elementCount, uniforms.data());
+}
+
+void Runtime::LoopFunction::operator()(std::span<const void* const> columns, std::span<void* const> outputs, i64 elementCount, std::span<const float> uniforms) const {
+    ASSERT(inputLayout == InputLayout::COLUMNS);
+    ASSERT(reduction == Reduction::NONE);
+    ASSERT(precision == Precision::F32);
+    ASSERT(i64(columns.size()) == inputVariableCount);
+    ASSERT(i64(outputs.size()) == outputCount);
+    const KernelProfile::Scope scope(profile.get(), elementCount, elementCount * bytesPerElement());
+    const auto columnsFunction = reinterpret_cast<TypedColumnsFunction>(function);
+    if (!hasTypedColumns()) {
+        columnsFunction(columns.data(), outputs.data(), elementCount, uniforms.data());
+        return;
+    }
+
+    static constexpr i64 VECTOR_ELEMENT_COUNT = 8;
+    const auto remainingCount = elementCount % VECTOR_ELEMENT_COUNT;
+    const auto vectorElementCount = elementCount - remainingCount;
+    columnsFunction(columns.data(), outputs.data(), vectorElementCount, uniforms.data());
+    if (remainingCount == 0) {
+        return;
+    }
+
+    // The tail buffers are reused by the later calls on the same thread so the calls with a tail don't allocate. The padding is zeroed so the conversions of the unused elements don't read uninitialized memory.
+    static constexpr i64 BUFFER_SIZE = VECTOR_ELEMENT_COUNT * sizeof(double);
+    struct TailBuffers {
+        std::vector<u8> data;
+        std::vector<const void*> columns;
+        std::vector<void*> outputs;
+    };
+    thread_local TailBuffers tail;
+    tail.data.assign((columns.size() + outputs.size()) * BUFFER_SIZE, 0);
+    tail.columns.clear();
+    tail.outputs.clear();
+    auto buffer = tail.data.data();
+    for (usize i = 0; i < columns.size(); i++) {
+        const auto elementSize = elementTypeSize(inputTypes[i]);
+        std::memcpy(buffer, reinterpret_cast<const u8*>(columns[i]) + vectorElementCount * elementSize, remainingCount * elementSize);
+        tail.columns.push_back(buffer);
+        buffer += BUFFER_SIZE;
+    }
+    for (usize i = 0; i < outputs.size(); i++) {
+        tail.outputs.push_back(buffer);
+        buffer += BUFFER_SIZE;
+    }
+    columnsFunction(tail.columns.data(), tail.outputs.data(), VECTOR_ELEMENT_COUNT, uniforms.data());
+    for (usize i = 0; i < outputs.size(); i++) {
+        const auto elementSize = elementTypeSize(outputTypes[i]);
+        std::memcpy(reinterpret_cast<u8*>(outputs[i]) + vectorElementCount * elementSize, tail.outputs[i], remainingCount * elementSize);
+    }
+}
+
+bool Runtime::LoopFunction::hasTypedColumns() const {
+    const auto isTyped = [](ElementType type) { return type != ElementType::F32; };
+    return std::ranges::any_of(inputTypes, isTyped) || std::ranges::any_of(outputTypes, isTyped);
+}
+
+void Runtime::LoopFunction::operator()(std::span<const double* const> columns, std::span<double* const> outputs, i64 elementCount, std::span<const double> uniforms) const {
+    ASSERT(inputLayout == InputLayout::COLUMNS);
+    ASSERT(precision == Precision::F64);
+    ASSERT(i64(outputs.size()) == outputCount);
+    const KernelProfile::Scope scope(profile.get(), elementCount, elementCount * bytesPerElement());
+    reinterpret_cast<ColumnsFunction>(function)(
+        reinterpret_cast<const float* const*>(columns.data()),
+        reinterpret_cast<float* const*>(outputs.data()),
+        elementCount,
+        reinterpret_cast<const float*>(uniforms.data()));
+}
+
+void Runtime::LoopFunction::operator()(const LoopFunctionArrayF64& input, LoopFunctionArrayF64& output, std::span<const double> uniforms) const {
+    if (input.blockCount() != output.blockCount() || output.valuesPerBlock_ != outputCount) {
+        ASSERT_NOT_REACHED();
+        return;
+    }
+    operator()(reinterpret_cast<const double*>(input.data()), reinterpret_cast<double*>(output.data()), input.blockCount_, uniforms);
+}
+
+void Runtime::LoopFunction::operator()(const Grid& grid, std::span<float* const> outputs, std::span<const float> uniforms) const {
+    ASSERT(inputLayout == InputLayout::GRID);
+    ASSERT(i64(outputs.size()) == outputCount);
+    ASSERT(i64(uniforms.size()) == uniformCount);
+    if (grid.dimensionCount < 1 || grid.dimensionCount > 3 || grid.dimensionCount != inputVariableCount) {
+        ASSERT_NOT_REACHED();
+        return;
+    }
+
+    // The coordinates are generated so only the outputs are accessed.
+    const KernelProfile::Scope scope(profile.get(), grid.elementCount(), grid.elementCount() * bytesPerElement());
+
+    if (grid.elementCount() == 0) {
+        return;
+    }
+
+    // The uniforms are followed by the origin, step, size and increment of each dimension and then the indices of the first 8 elements along each dimension. The calls on the same thread reuse the buffer. The increments are the digits of the element count of an iteration in the mixed radix number system with the sizes as the bases.
+    static constexpr i64 VECTOR_ELEMENT_COUNT = 8;
+    const auto gridUniformsIndex = uniforms.size();
+    const auto laneIndicesIndex = gridUniformsIndex + grid.dimensionCount * GRID_UNIFORMS_PER_DIMENSION;
+    thread_local std::vector<float> callUniforms;
+    callUniforms.assign(uniforms.begin(), uniforms.end());
+    callUniforms.resize(laneIndicesIndex + grid.dimensionCount * VECTOR_ELEMENT_COUNT);
+    i64 increment = VECTOR_ELEMENT_COUNT;
+    for (i64 d = 0; d < grid.dimensionCount; d++) {
+        const auto isLast = d == grid.dimensionCount - 1;
+        const auto dimension = gridUniformsIndex + d * GRID_UNIFORMS_PER_DIMENSION;
+        callUniforms[dimension] = grid.origin[d];
+        callUniforms[dimension + 1] = grid.step[d];
+        callUniforms[dimension + 2] = float(grid.size[d]);
+        callUniforms[dimension + 3] = float(isLast ? increment : increment % grid.size[d]);
+        increment /= grid.size[d];
+    }
+    for (i64 lane = 0; lane < VECTOR_ELEMENT_COUNT; lane++) {
+        i64 index = lane;
+        for (i64 d = 0; d < grid.dimensionCount; d++) {
+            const auto isLast = d == grid.dimensionCount - 1;
+            callUniforms[laneIndicesIndex + d * VECTOR_ELEMENT_COUNT + lane] = float(isLast ? index : index % grid.size[d]);
+            index /= grid.size[d];
+        }
+    }
+
+    const auto columnsFunction = reinterpret_cast<ColumnsFunction>(function);
+    columnsFunction(nullptr, outputs.data(), grid.elementCount(), callUniforms.data());
+}
+
+i64 Runtime::LoopFunction::bytesPerElement() const {
+    if (precision == Precision::F64) {
+        return (inputVariableCount + outputCount) * i64(sizeof(double));
+    }
+    i64 bytes = 0;
+    if (inputLayout != InputLayout::GRID) {
+        for (const auto type : inputTypes) {
+            bytes += elementTypeSize(type);
+        }
+    }
+    if (reduction == Reduction::NONE) {
+        for (const auto type : outputTypes) {
+            bytes += elementTypeSize(type);
+        }
+    }
+    return bytes;
+}
+
+void Runtime::LoopFunction::enableProfiling() {
+    if (profile == nullptr) {
+        profile = std::make_unique<KernelProfile>();
+    }
+}
+
+void Runtime::LoopFunction::disableProfiling() {
+    profile.reset();
+}
+
+std::optional<KernelProfile::Report> Runtime::LoopFunction::profileReport() const {
+    if (profile == nullptr) {
+        return std::nullopt;
+    }
+    return profile->report();
 }
 
-void Runtime::LoopFunction::operator()(const __m256* input, __m256* output, i64 count) const {
-    function(input, output, count);
+i64 Grid::elementCount() const {
+    i64 count = 1;
+    for (i64 i = 0; i < dimensionCount; i++) {
+        count *= size[i];
+    }
+    return count;
 }
 
-void Runtime::LoopFunction::operator()(const LoopFunctionArray& input, LoopFunctionArray& output) const {
-    if (input.blockCount() != output.blockCount()) {
+void Runtime::LoopFunction::operator()(const LoopFunctionArray& input, LoopFunctionArray& output, std::span<const float> uniforms) const {
+    if (input.blockCount() != output.blockCount() || output.valuesPerBlock_ != outputCount) {
         ASSERT_NOT_REACHED();
         return;
     }
-    i64 dataCount = input.blockCount_ / LoopFunctionArray::ITEMS_PER_DATA;
-    if (input.blockCount_ % LoopFunctionArray::ITEMS_PER_DATA != 0) {
-        dataCount += 1;
+    operator()(reinterpret_cast<const float*>(input.data()), reinterpret_cast<float*>(output.data()), input.blockCount_, uniforms);
+}
+
+void Runtime::LoopFunction::operator()(const LoopFunctionArray& input, LoopFunctionArray& output, ThreadPool& pool, std::span<const float> uniforms) const {
+    if (input.blockCount() != output.blockCount() || output.valuesPerBlock_ != outputCount) {
+        ASSERT_NOT_REACHED();
+        return;
+    }
+    const auto dataCount = roundUpToMultiple(input.blockCount_, LoopFunctionArray::ITEMS_PER_DATA) / LoopFunctionArray::ITEMS_PER_DATA;
+    // Each 8 elements take valuesPerBlock data units of the input and outputCount data units of the output.
+    const auto bytesPerDataUnit = (input.valuesPerBlock_ + outputCount) * i64(sizeof(__m256));
+    const auto dataUnitsPerChunk = std::max(PARALLEL_CHUNK_BYTE_SIZE / bytesPerDataUnit, i64(1));
+    const auto chunkCount = roundUpToMultiple(dataCount, dataUnitsPerChunk) / dataUnitsPerChunk;
+
+    pool.parallelFor(chunkCount, [&](i64 chunkIndex) {
+        const auto start = chunkIndex * dataUnitsPerChunk;
+        const auto elementCount = std::min(
+            dataUnitsPerChunk * LoopFunctionArray::ITEMS_PER_DATA, 
+            input.blockCount_ - start * LoopFunctionArray::ITEMS_PER_DATA);
+        operator()(
+            reinterpret_cast<const float*>(input.data() + start * input.valuesPerBlock_),
+            reinterpret_cast<float*>(output.data() + start * outputCount),
+            elementCount,
+            uniforms);
+    });
+}
+
+Runtime::LoopFunction::ReductionResult Runtime::LoopFunction::reduce(const float* input, i64 elementCount, std::span<const float> uniforms) const {
+    ASSERT(inputLayout == InputLayout::BLOCKS);
+    return finishReduction(reduceCall(input, elementCount, uniforms.data()), elementCount);
+}
+
+Runtime::LoopFunction::ReductionResult Runtime::LoopFunction::reduce(std::span<const float* const> columns, i64 elementCount, std::span<const float> uniforms) const {
+    ASSERT(inputLayout == InputLayout::COLUMNS);
+    return finishReduction(reduceCall(columns.data(), elementCount, uniforms.data()), elementCount);
+}
+
+Runtime::LoopFunction::ReductionResult Runtime::LoopFunction::reduce(const LoopFunctionArray& input, std::span<const float> uniforms) const {
+    return reduce(reinterpret_cast<const float*>(input.data()), input.blockCount_, uniforms);
+}
+
+Runtime::LoopFunction::ReductionResult Runtime::LoopFunction::reduce(const LoopFunctionArray& input, ThreadPool& pool, std::span<const float> uniforms) const {
+    ASSERT(inputLayout == InputLayout::BLOCKS);
+    const auto dataCount = roundUpToMultiple(input.blockCount_, LoopFunctionArray::ITEMS_PER_DATA) / LoopFunctionArray::ITEMS_PER_DATA;
+    const auto bytesPerDataUnit = std::max(input.valuesPerBlock_, i64(1)) * i64(sizeof(__m256));
+    const auto dataUnitsPerChunk = std::max(PARALLEL_CHUNK_BYTE_SIZE / bytesPerDataUnit, i64(1));
+    const auto chunkCount = roundUpToMultiple(dataCount, dataUnitsPerChunk) / dataUnitsPerChunk;
+
+    std::vector<ReductionResult> chunkResults(chunkCount);
+    pool.parallelFor(chunkCount, [&](i64 chunkIndex) {
+        const auto start = chunkIndex * dataUnitsPerChunk;
+        const auto elementCount = std::min(
+            dataUnitsPerChunk * LoopFunctionArray::ITEMS_PER_DATA,
+            input.blockCount_ - start * LoopFunctionArray::ITEMS_PER_DATA);
+        chunkResults[chunkIndex] = reduceCall(input.data() + start * input.valuesPerBlock_, elementCount, uniforms.data());
+    });
+
+    auto result = reduceCall(nullptr, 0, uniforms.data());
+    for (i64 i = 0; i < chunkCount; i++) {
+        combineReductionResults(result, chunkResults[i], i * dataUnitsPerChunk * LoopFunctionArray::ITEMS_PER_DATA);
+    }
+    return finishReduction(result, input.blockCount_);
+}
+
+Runtime::LoopFunction::ReductionResult Runtime::LoopFunction::reduceCall(const void* input, i64 elementCount, const float* uniforms) const {
+    const auto selectsElement = reduction == Reduction::ARGMIN || reduction == Reduction::ARGMAX;
+    if (!selectsElement || elementCount <= MAX_ARG_REDUCTION_CALL_ELEMENT_COUNT) {
+        return reduceCallInIndexRange(input, elementCount, uniforms);
+    }
+
+    auto result = reduceCallInIndexRange(nullptr, 0, uniforms);
+    std::vector<const float*> columns;
+    for (i64 offset = 0; offset < elementCount; offset += MAX_ARG_REDUCTION_CALL_ELEMENT_COUNT) {
+        const auto count = std::min(MAX_ARG_REDUCTION_CALL_ELEMENT_COUNT, elementCount - offset);
+        const void* callInput = nullptr;
+        if (inputLayout == InputLayout::BLOCKS) {
+            callInput = reinterpret_cast<const float*>(input) + offset * inputVariableCount;
+        } else {
+            const auto inputColumns = reinterpret_cast<const float* const*>(input);
+            columns.clear();
+            for (i64 i = 0; i < inputVariableCount; i++) {
+                columns.push_back(inputColumns[i] + offset);
+            }
+            callInput = columns.data();
+        }
+        combineReductionResults(result, reduceCallInIndexRange(callInput, count, uniforms), offset);
     }
-    operator()(input.data(), output.data(), dataCount);
+    return result;
+}
+
+Runtime::LoopFunction::ReductionResult Runtime::LoopFunction::reduceCallInIndexRange(const void* input, i64 elementCount, const float* uniforms) const {
+    ASSERT(reduction != Reduction::NONE);
+    ASSERT(elementCount <= MAX_ARG_REDUCTION_CALL_ELEMENT_COUNT || (reduction != Reduction::ARGMIN && reduction != Reduction::ARGMAX));
+    ReductionPartials partials;
+    const KernelProfile::Scope scope(profile.get(), elementCount, elementCount * bytesPerElement());
+    function(reinterpret_cast<const float*>(input), reinterpret_cast<float*>(&partials), elementCount, uniforms);
+
+    // The lanes are combined in a fixed order so the result is deterministic.
+    const auto selectsElement = reduction == Reduction::ARGMIN || reduction == Reduction::ARGMAX;
+    ReductionResult result{ .value = partials.values[0], .index = selectsElement ? partials.indices[0] : -1 };
+    for (i64 i = 1; i < i64(std::size(partials.values)); i++) {
+        const ReductionResult lane{ .value = partials.values[i], .index = selectsElement ? partials.indices[i] : -1 };
+        combineReductionResults(result, lane, 0);
+    }
+    return result;
+}
+
+void Runtime::LoopFunction::combineReductionResults(ReductionResult& result, const ReductionResult& other, i64 indexOffset) const {
+    switch (reduction) {
+        using enum Reduction;
+    case NONE:
+        ASSERT_NOT_REACHED();
+        break;
+    case SUM:
+    case MEAN:
+        result.value += other.value;
+        break;
+    case MIN:
+        result.value = std::min(result.value, other.value);
+        break;
+    case MAX:
+        result.value = std::max(result.value, other.value);
+        break;
+    case ARGMIN:
+    case ARGMAX: {
+        if (other.index == -1) {
+            break;
+        }
+        const auto otherIndex = other.index + indexOffset;
+        const auto better = reduction == ARGMIN ? other.value < result.value : other.value > result.value;
+        if (result.index == -1 || better || (other.value == result.value && otherIndex < result.index)) {
+            result = ReductionResult{ .value = other.value, .index = otherIndex };
+        }
+        break;
+    }
+    }
+}
+
+Runtime::LoopFunction::ReductionResult Runtime::LoopFunction::finishReduction(ReductionResult result, i64 elementCount) const {
+    if (reduction == Reduction::MEAN) {
+        result.value /= float(elementCount);
+    }
+    return result;
 }
 
 LoopFunctionArray::LoopFunctionArray()
@@ -121,56 +574,151 @@ LoopFunctionArray::LoopFunctionArray()
 
 LoopFunctionArray::LoopFunctionArray(i64 valuesPerBlock)
     : valuesPerBlock_(valuesPerBlock)
-    , dataCapacity(0)
     , blockCount_(0)
-    , data_(nullptr) {}
+    , data_(nullptr)
+    , dataCapacity(0)
+    , mapping(nullptr)
+    , mappingSize(0)
+    , mappingWritable(false) {}
 
 LoopFunctionArray::~LoopFunctionArray() {
-    delete data_;
+    freeStorage();
 }
 
-void LoopFunctionArray::append(std::span<const float> block) {
-    const auto dataIndex = blockCount_ / ITEMS_PER_DATA * valuesPerBlock_;
+LoopFunctionArray::LoopFunctionArray(LoopFunctionArray&& other) noexcept
+    : valuesPerBlock_(other.valuesPerBlock_)
+    , blockCount_(other.blockCount_)
+    , data_(other.data_)
+    , dataCapacity(other.dataCapacity)
+    , mapping(other.mapping)
+    , mappingSize(other.mappingSize)
+    , mappingWritable(other.mappingWritable) {
+    other.blockCount_ = 0;
+    other.data_ = nullptr;
+    other.dataCapacity = 0;
+    other.mapping = nullptr;
+}
 
-    const auto requiredSize = dataIndex + valuesPerBlock_;
-    if (requiredSize > dataCapacity) {
-        const auto newDataCapacity = std::max(requiredSize, dataCapacity * 2);
-        const auto newData = new __m256[newDataCapacity];
-        // TODO: Don't need to copy this much data.
-        memcpy(newData, data_, dataCapacity * sizeof(__m256));
-        delete data_;
-        data_ = newData;
-        dataCapacity = newDataCapacity;
+LoopFunctionArray& LoopFunctionArray::operator=(LoopFunctionArray&& other) noexcept {
+    if (this == &other) {
+        return *this;
+    }
+    freeStorage();
+    valuesPerBlock_ = other.valuesPerBlock_;
+    blockCount_ = other.blockCount_;
+    data_ = other.data_;
+    dataCapacity = other.dataCapacity;
+    mapping = other.mapping;
+    mappingSize = other.mappingSize;
+    mappingWritable = other.mappingWritable;
+    other.blockCount_ = 0;
+    other.data_ = nullptr;
+    other.dataCapacity = 0;
+    other.mapping = nullptr;
+    return *this;
+}
+
+void LoopFunctionArray::append(std::span<const float> block) {
+    if (i64(block.size()) != valuesPerBlock_) {
+        ASSERT_NOT_REACHED();
+        return;
     }
+    appendRows(block);
+}
 
-    const auto offsetInData = blockCount_ % ITEMS_PER_DATA;
+void LoopFunctionArray::appendRows(std::span<const float> rows) {
+    if (valuesPerBlock_ == 0 || i64(rows.size()) % valuesPerBlock_ != 0) {
+        ASSERT_NOT_REACHED();
+        return;
+    }
+    const auto rowCount = i64(rows.size()) / valuesPerBlock_;
+    const auto firstBlock = blockCount_;
+    growTo(dataUnitsOccupiedBy(blockCount_ + rowCount));
+    blockCount_ += rowCount;
+
+    i64 row = 0;
+    // Fill the partially filled data unit one value at a time.
+    for (; row < rowCount && (firstBlock + row) % ITEMS_PER_DATA != 0; row++) {
+        for (i64 i = 0; i < valuesPerBlock_; i++) {
+            operator()(firstBlock + row, i) = rows[row * valuesPerBlock_ + i];
+        }
+    }
+    // Then whole data units at a time.
+    for (; row + ITEMS_PER_DATA <= rowCount; row += ITEMS_PER_DATA) {
+        const auto dataIndex = (firstBlock + row) / ITEMS_PER_DATA * valuesPerBlock_;
+        transposeRowsToBlocks(&rows[row * valuesPerBlock_], valuesPerBlock_, &data_[dataIndex]);
+    }
+    for (; row < rowCount; row++) {
+        for (i64 i = 0; i < valuesPerBlock_; i++) {
+            operator()(firstBlock + row, i) = rows[row * valuesPerBlock_ + i];
+        }
+    }
+}
 
-    if (block.size() != valuesPerBlock_) {
+void LoopFunctionArray::appendColumns(std::span<const float* const> columns, i64 rowCount) {
+    if (i64(columns.size()) != valuesPerBlock_) {
         ASSERT_NOT_REACHED();
         return;
     }
+    const auto firstBlock = blockCount_;
+    growTo(dataUnitsOccupiedBy(blockCount_ + rowCount));
+    blockCount_ += rowCount;
+
+    i64 row = 0;
+    for (; row < rowCount && (firstBlock + row) % ITEMS_PER_DATA != 0; row++) {
+        for (i64 i = 0; i < valuesPerBlock_; i++) {
+            operator()(firstBlock + row, i) = columns[i][row];
+        }
+    }
+    // A data unit contains 8 consecutive values of a column.
+    for (; row + ITEMS_PER_DATA <= rowCount; row += ITEMS_PER_DATA) {
+        const auto dataIndex = (firstBlock + row) / ITEMS_PER_DATA * valuesPerBlock_;
+        for (i64 i = 0; i < valuesPerBlock_; i++) {
+            data_[dataIndex + i] = _mm256_loadu_ps(&columns[i][row]);
+        }
+    }
+    for (; row < rowCount; row++) {
+        for (i64 i = 0; i < valuesPerBlock_; i++) {
+            operator()(firstBlock + row, i) = columns[i][row];
+        }
+    }
+}
 
-    for (usize i = 0; i < block.size(); i++) {
-        data_[dataIndex + i].m256_f32[offsetInData] = block[i];
+void LoopFunctionArray::readRows(std::span<float> rows) const {
+    if (i64(rows.size()) != blockCount_ * valuesPerBlock_) {
+        ASSERT_NOT_REACHED();
+        return;
+    }
+    i64 row = 0;
+    for (; row + ITEMS_PER_DATA <= blockCount_; row += ITEMS_PER_DATA) {
+        transposeBlocksToRows(&data_[row / ITEMS_PER_DATA * valuesPerBlock_], valuesPerBlock_, &rows[row * valuesPerBlock_]);
+    }
+    for (; row < blockCount_; row++) {
+        for (i64 i = 0; i < valuesPerBlock_; i++) {
+            rows[row * valuesPerBlock_ + i] = operator()(row, i);
+        }
     }
-    blockCount_++;
 }
 
 void LoopFunctionArray::clear() {
     blockCount_ = 0;
 }
 
+void LoopFunctionArray::reserve(i64 blockCount) {
+    growTo(dataUnitsOccupiedBy(blockCount));
+}
+
 void LoopFunctionArray::resizeWithoutCopy(i64 newBlockCount) {
     const auto requiredSize = dataUnitsOccupiedBy(newBlockCount);
-    if (requiredSize <= dataCapacity) {
-        blockCount_ = newBlockCount;
-        return; 
+    if (requiredSize > dataCapacity) {
+        if (isMapped()) {
+            ASSERT_NOT_REACHED();
+            return;
+        }
+        freeData(data_);
+        data_ = allocateData(requiredSize);
+        dataCapacity = requiredSize;
     }
-
-    delete data_;
-    const auto newData = new __m256[requiredSize];
-    data_ = newData;
-    dataCapacity = requiredSize;
     blockCount_ = newBlockCount;
 }
 
@@ -182,15 +730,224 @@ void LoopFunctionArray::reset(i64 valuesPerBlock) {
 void LoopFunctionArray::copyIntoItself(const LoopFunctionArray& other) {
     valuesPerBlock_ = other.valuesPerBlock_;
     resizeWithoutCopy(other.blockCount_);
-    for (i32 i = 0; i < other.dataUnitsOccupiedBy(other.blockCount_); i++) {
-        data_[i] = other.data()[i];
+    const auto dataCount = other.dataUnitsOccupiedByBlocks();
+    if (dataCount > 0) {
+        memcpy(data_, other.data_, dataCount * sizeof(__m256));
     }
 }
 
-i32 LoopFunctionArray::dataUnitsOccupiedBy(i32 blockCount) const {
-    return blockCount / ITEMS_PER_DATA * valuesPerBlock_ + valuesPerBlock_;
+i64 LoopFunctionArray::dataUnitsOccupiedBy(i64 blockCount) const {
+    return roundUpToMultiple(blockCount, ITEMS_PER_DATA) / ITEMS_PER_DATA * valuesPerBlock_;
 }
 
-i32 LoopFunctionArray::dataUnitsOccupiedByBlocks() const {
+i64 LoopFunctionArray::dataUnitsOccupiedByBlocks() const {
     return dataUnitsOccupiedBy(blockCount_);
-}
\ No newline at end of file
+}
+
+__m256* LoopFunctionArray::allocateData(i64 dataCount) {
+    return static_cast<__m256*>(::operator new[](dataCount * sizeof(__m256), std::align_val_t(CACHE_LINE_SIZE)));
+}
+
+void LoopFunctionArray::freeData(__m256* data) {
+    if (data == nullptr) {
+        return;
+    }
+    ::operator delete[](data, std::align_val_t(CACHE_LINE_SIZE));
+}
+
+void LoopFunctionArray::freeStorage() {
+    if (mapping == nullptr) {
+        freeData(data_);
+        return;
+    }
+    if (mappingWritable) {
+        writeMappedFileHeader();
+    }
+    unmapFile(mapping, mappingSize);
+    mapping = nullptr;
+}
+
+std::optional<LoopFunctionArray> LoopFunctionArray::openMapped(const char* path) {
+    i64 size = 0;
+    const auto memory = mapFile(path, size, false);
+    if (memory == nullptr) {
+        return std::nullopt;
+    }
+
+    LoopFunctionArray array;
+    array.mapping = memory;
+    array.mappingSize = size;
+    array.mappingWritable = false;
+
+    MappedFileHeader header;
+    if (size < MAPPED_FILE_HEADER_SIZE) {
+        return std::nullopt;
+    }
+    // The version is a part of the magic.
+    memcpy(&header, memory, sizeof(header));
+    if (header.magic != MAPPED_FILE_MAGIC || header.valuesPerBlock < 0 || header.blockCount < 0) {
+        return std::nullopt;
+    }
+    // The counts come from the file so they are checked against its size before multiplying them.
+    const auto dataCountInFile = (size - MAPPED_FILE_HEADER_SIZE) / i64(sizeof(__m256));
+    const auto dataRowCount = header.blockCount / ITEMS_PER_DATA + (header.blockCount % ITEMS_PER_DATA != 0);
+    if (header.valuesPerBlock != 0 && dataRowCount > dataCountInFile / header.valuesPerBlock) {
+        return std::nullopt;
+    }
+    array.valuesPerBlock_ = header.valuesPerBlock;
+    array.blockCount_ = header.blockCount;
+    const auto dataCount = array.dataUnitsOccupiedBy(header.blockCount);
+    array.data_ = reinterpret_cast<__m256*>(reinterpret_cast<u8*>(memory) + MAPPED_FILE_HEADER_SIZE);
+    array.dataCapacity = dataCount;
+    adviseSequentialAccess(memory, size);
+    return array;
+}
+
+std::optional<LoopFunctionArray> LoopFunctionArray::createMapped(const char* path, i64 valuesPerBlock, i64 blockCount) {
+    LoopFunctionArray array(valuesPerBlock);
+    const auto dataCount = array.dataUnitsOccupiedBy(blockCount);
+    i64 size = MAPPED_FILE_HEADER_SIZE + dataCount * i64(sizeof(__m256));
+    const auto memory = mapFile(path, size, true);
+    if (memory == nullptr) {
+        return std::nullopt;
+    }
+    array.mapping = memory;
+    array.mappingSize = size;
+    array.mappingWritable = true;
+    array.blockCount_ = blockCount;
+    array.data_ = reinterpret_cast<__m256*>(reinterpret_cast<u8*>(memory) + MAPPED_FILE_HEADER_SIZE);
+    array.dataCapacity = dataCount;
+    array.writeMappedFileHeader();
+    adviseSequentialAccess(memory, size);
+    return array;
+}
+
+bool LoopFunctionArray::flush() {
+    if (!isMapped() || !mappingWritable) {
+        return true;
+    }
+    writeMappedFileHeader();
+    return flushMappedFile(mapping, mappingSize);
+}
+
+bool LoopFunctionArray::isMapped() const {
+    return mapping != nullptr;
+}
+
+void LoopFunctionArray::writeMappedFileHeader() {
+    const MappedFileHeader header{
+        .magic = MAPPED_FILE_MAGIC,
+        .valuesPerBlock = valuesPerBlock_,
+        .blockCount = blockCount_,
+    };
+    memcpy(mapping, &header, sizeof(header));
+}
+
+void LoopFunctionArray::growTo(i64 requiredDataCount) {
+    if (requiredDataCount <= dataCapacity) {
+        return;
+    }
+    if (isMapped()) {
+        ASSERT_NOT_REACHED();
+        return;
+    }
+    const auto newDataCapacity = std::max(requiredDataCount, dataCapacity * 2);
+    const auto newData = allocateData(newDataCapacity);
+    // Only the occupied part contains values.
+    const auto dataCount = dataUnitsOccupiedByBlocks();
+    if (dataCount > 0) {
+        memcpy(newData, data_, dataCount * sizeof(__m256));
+    }
+    freeData(data_);
+    data_ = newData;
+    dataCapacity = newDataCapacity;
+}
+
+LoopFunctionArrayF64::LoopFunctionArrayF64(i64 valuesPerBlock)
+    : valuesPerBlock_(valuesPerBlock)
+    , blockCount_(0) {}
+
+void LoopFunctionArrayF64::append(std::span<const double> block) {
+    if (i64(block.size()) != valuesPerBlock_) {
+        ASSERT_NOT_REACHED();
+        return;
+    }
+    appendRows(block);
+}
+
+void LoopFunctionArrayF64::appendRows(std::span<const double> rows) {
+    if (valuesPerBlock_ == 0 || i64(rows.size()) % valuesPerBlock_ != 0) {
+        ASSERT_NOT_REACHED();
+        return;
+    }
+    const auto rowCount = i64(rows.size()) / valuesPerBlock_;
+    const auto firstBlock = blockCount_;
+    resize(blockCount_ + rowCount);
+    for (i64 row = 0; row < rowCount; row++) {
+        for (i64 i = 0; i < valuesPerBlock_; i++) {
+            operator()(firstBlock + row, i) = rows[row * valuesPerBlock_ + i];
+        }
+    }
+}
+
+void LoopFunctionArrayF64::readRows(std::span<double> rows) const {
+    if (i64(rows.size()) != blockCount_ * valuesPerBlock_) {
+        ASSERT_NOT_REACHED();
+        return;
+    }
+    for (i64 row = 0; row < blockCount_; row++) {
+        for (i64 i = 0; i < valuesPerBlock_; i++) {
+            rows[row * valuesPerBlock_ + i] = operator()(row, i);
+        }
+    }
+}
+
+void LoopFunctionArrayF64::clear() {
+    blockCount_ = 0;
+}
+
+void LoopFunctionArrayF64::resize(i64 newBlockCount) {
+    data_.resize(dataUnitsOccupiedBy(newBlockCount) * ITEMS_PER_DATA);
+    blockCount_ = newBlockCount;
+}
+
+i64 LoopFunctionArrayF64::dataUnitsOccupiedBy(i64 blockCount) const {
+    return roundUpToMultiple(blockCount, ITEMS_PER_DATA) / ITEMS_PER_DATA * valuesPerBlock_;
+}
+
+LoopFunctionArray LoopFunctionArrayPool::acquire(i64 valuesPerBlock, i64 blockCount) {
+    LoopFunctionArray array(valuesPerBlock);
+    {
+        std::lock_guard lock(mutex);
+        const auto requiredDataCount = array.dataUnitsOccupiedBy(blockCount);
+        // Take the smallest array that is big enough so the big ones are left for big requests.
+        auto best = freeArrays.end();
+        for (auto it = freeArrays.begin(); it != freeArrays.end(); ++it) {
+            if (it->dataCapacity >= requiredDataCount && (best == freeArrays.end() || it->dataCapacity < best->dataCapacity)) {
+                best = it;
+            }
+        }
+        if (best != freeArrays.end()) {
+            array = std::move(*best);
+            freeArrays.erase(best);
+        }
+    }
+    array.reset(valuesPerBlock);
+    array.resizeWithoutCopy(blockCount);
+    return array;
+}
+
+void LoopFunctionArrayPool::release(LoopFunctionArray&& array) {
+    // The mapped arrays can't be resized so they are destroyed.
+    if (array.data_ == nullptr || array.isMapped()) {
+        LoopFunctionArray destroyed(std::move(array));
+        return;
+    }
+    std::lock_guard lock(mutex);
+    freeArrays.push_back(std::move(array));
+}
+
+void LoopFunctionArrayPool::clear() {
+    std::lock_guard lock(mutex);
+    freeArrays.clear();
+}
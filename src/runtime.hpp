@@ -3,20 +3,37 @@
 #include <string_view>
 #include <immintrin.h>
 #include "utils/ints.hpp"
-#include "scanner.hpp"
-#include "parser.hpp"
-#include "irCompiler.hpp"
-#include "codeGenerator.hpp"
-#include "valueNumbering.hpp"
-#include "deadCodeElimination.hpp"
+#include "compilationContext.hpp"
+#include "codeHeap.hpp"
+#include "threadPool.hpp"
+#include "blockTranspose.hpp"
+#include "kernelProfile.hpp"
+#include "jitCodeRegistry.hpp"
+#include "utils/alignedAllocator.hpp"
+#include <mutex>
+#include <memory>
 //#include "machineCode.hpp"
 
+// Stores blocks of valuesPerBlock values in the layout used by the functions compiled with InputLayout::BLOCKS. The values of 8 consecutive blocks are stored together, first the 8 values of the variable 0, then the 8 values of the variable 1 and so on.
+// The data is aligned to CACHE_LINE_SIZE bytes. Only the data units occupied by the blocks are allocated, the values after the last block in the last data unit are unspecified.
 struct LoopFunctionArray {
 	LoopFunctionArray();
 	LoopFunctionArray(i64 valuesPerBlock);
 	~LoopFunctionArray();
+	LoopFunctionArray(LoopFunctionArray&& other) noexcept;
+	LoopFunctionArray& operator=(LoopFunctionArray&& other) noexcept;
+	LoopFunctionArray(const LoopFunctionArray&) = delete;
+	LoopFunctionArray& operator=(const LoopFunctionArray&) = delete;
+
 	void append(std::span<const float> block);
+	// rows contains rows.size() / valuesPerBlock blocks stored one after another.
+	void appendRows(std::span<const float> rows);
+	// columns[i] points to rowCount values of the value i of the blocks.
+	void appendColumns(std::span<const float* const> columns, i64 rowCount);
+	// Writes the blocks one after another into rows. rows.size() has to be equal to blockCount * valuesPerBlock.
+	void readRows(std::span<float> rows) const;
 	void clear();
+	void reserve(i64 blockCount);
 	void resizeWithoutCopy(i64 newBlockCount);
 	void reset(i64 valuesPerBlock);
 
@@ -24,36 +41,182 @@ struct LoopFunctionArray {
 
 	float operator()(i64 block, i64 indexInBlock) const;
 	float& operator()(i64 block, i64 indexInBlock);
-	//std::span<const float> operator[](i64 blockIndex) const;
 
-	i32 dataUnitsOccupiedBy(i32 blockCount) const;
-	i32 dataUnitsOccupiedByBlocks() const;
+	i64 dataUnitsOccupiedBy(i64 blockCount) const;
+	i64 dataUnitsOccupiedByBlocks() const;
 
 	i64 valuesPerBlock_;
-	i32 valuesPerBlock() { return valuesPerBlock_; };
+	i64 valuesPerBlock() const { return valuesPerBlock_; };
 	i64 blockCount_;
 	i64 blockCount() const { return blockCount_; };
 
 	static constexpr i32 ITEMS_PER_DATA = 8;
+	static constexpr i64 CACHE_LINE_SIZE = 64;
 	__m256* data_;
 	__m256* data() const { return data_; };
 	i64 dataCapacity;
+
+	// The file contains a header followed by the data units so the functions can be evaluated directly on the mapped memory. The pages are read ahead sequentially so the files can be bigger than the physical memory.
+	// Maps a file created by createMapped read only. Writing to the array is not allowed. Returns std::nullopt if the file can't be mapped or isn't valid.
+	static std::optional<LoopFunctionArray> openMapped(const char* path);
+	// Creates or overwrites the file and maps it. The array has blockCount blocks with unspecified values and it can't grow past that. The block count is written to the file when the array is flushed or destroyed.
+	static std::optional<LoopFunctionArray> createMapped(const char* path, i64 valuesPerBlock, i64 blockCount);
+	// Returns false if writing a writable mapping to the file failed.
+	bool flush();
+	bool isMapped() const;
+
+	struct MappedFileHeader {
+		u64 magic;
+		i64 valuesPerBlock;
+		i64 blockCount;
+	};
+	static constexpr u64 MAPPED_FILE_MAGIC = 0x3179617272414C46; // "FLArray1"
+	// Keeps the data aligned to a cache line.
+	static constexpr i64 MAPPED_FILE_HEADER_SIZE = CACHE_LINE_SIZE;
+	// nullptr if the data is allocated on the heap.
+	void* mapping;
+	i64 mappingSize;
+	bool mappingWritable;
+	void writeMappedFileHeader();
+
+	static __m256* allocateData(i64 dataCount);
+	static void freeData(__m256* data);
+	void freeStorage();
+	void growTo(i64 requiredDataCount);
+};
+
+// The layout of LoopFunctionArray for the functions compiled with Precision::F64. A data unit holds 4 values so the values of 4 consecutive blocks are stored together.
+// Only holds the values on the heap, it can't be mapped to a file or pooled.
+struct LoopFunctionArrayF64 {
+	LoopFunctionArrayF64(i64 valuesPerBlock);
+
+	void append(std::span<const double> block);
+	// rows contains rows.size() / valuesPerBlock blocks stored one after another.
+	void appendRows(std::span<const double> rows);
+	// Writes the blocks one after another into rows. rows.size() has to be equal to blockCount * valuesPerBlock.
+	void readRows(std::span<double> rows) const;
+	void clear();
+	// The values of the new blocks are unspecified.
+	void resize(i64 newBlockCount);
+
+	double operator()(i64 block, i64 indexInBlock) const;
+	double& operator()(i64 block, i64 indexInBlock);
+
+	i64 dataUnitsOccupiedBy(i64 blockCount) const;
+
+	i64 valuesPerBlock_;
+	i64 valuesPerBlock() const { return valuesPerBlock_; };
+	i64 blockCount_;
+	i64 blockCount() const { return blockCount_; };
+
+	static constexpr i32 ITEMS_PER_DATA = 4;
+	// A data unit is ITEMS_PER_DATA doubles.
+	std::vector<double, AlignedAllocator<double, LoopFunctionArray::CACHE_LINE_SIZE>> data_;
+	const __m256d* data() const { return reinterpret_cast<const __m256d*>(data_.data()); };
+	__m256d* data() { return reinterpret_cast<__m256d*>(data_.data()); };
+};
+
+// Keeps the arrays that are no longer used so their memory can be reused. Repeatedly evaluating functions on arrays of similar sizes doesn't touch the heap after the first evaluation.
+// Thread safe.
+struct LoopFunctionArrayPool {
+	// Returns an array with blockCount blocks. The values are unspecified.
+	LoopFunctionArray acquire(i64 valuesPerBlock, i64 blockCount);
+	void release(LoopFunctionArray&& array);
+	void clear();
+
+	std::mutex mutex;
+	std::vector<LoopFunctionArray> freeArrays;
+};
+
+// Describes the grid evaluated by a function compiled with InputLayout::GRID. The coordinate along the dimension i of the element with the index j is origin[i] + j * step[i].
+struct Grid {
+	i64 dimensionCount;
+	float origin[3];
+	float step[3];
+	i64 size[3];
+
+	i64 elementCount() const;
 };
 
 struct Runtime {
 	struct LoopFunction {
-		LoopFunction(const MachineCode& machineCode);
+		// The function is placed in heap so it can't outlive it.
+		LoopFunction(CodeHeap& heap, const MachineCode& machineCode, std::span<const Variable> variables, InputLayout inputLayout, i64 outputCount, Reduction reduction = Reduction::NONE, Precision precision = Precision::F32, std::span<const ElementType> outputTypes = {});
 		LoopFunction(LoopFunction&& other) noexcept;
 		LoopFunction(const LoopFunction&) = delete;
 		LoopFunction& operator=(const LoopFunction&) = delete;
 		LoopFunction& operator=(LoopFunction&& other) noexcept;
 		~LoopFunction();
-		void operator()(const __m256* input, __m256* output, i64 count) const;
-		void operator()(const LoopFunctionArray& input, LoopFunctionArray& output) const;
+		// The input is in the block layout (8 values of the first variable, then 8 values of the second variable and so on). The output uses the same layout with a value for each output. Only the elementCount elements are read and written so the arrays don't need any padding and don't need to be aligned.
+		// uniforms holds the values of the uniform variables in the order they appear in the variable list.
+		void operator()(const float* input, float* output, i64 elementCount, std::span<const float> uniforms = {}) const;
+		// Only for functions compiled with InputLayout::COLUMNS. columns[i] points to elementCount values of the variable i and outputs[i] to elementCount values of the output i.
+		void operator()(std::span<const float* const> columns, std::span<float* const> outputs, i64 elementCount, std::span<const float> uniforms = {}) const;
+		// The same as above for functions with typed columns. columns[i] and outputs[i] point to elementCount values of the types the function was compiled with.
+		// The code only processes whole vectors so the remaining elements are copied into buffers padded to 8 elements and computed with a separate call.
+		void operator()(std::span<const void* const> columns, std::span<void* const> outputs, i64 elementCount, std::span<const float> uniforms = {}) const;
+		// Only for functions compiled with InputLayout::GRID. The non uniform variables are the coordinates in the order x, y, z and their count has to be equal to the dimension count. The whole grid is evaluated by a single call of the kernel. outputs[i] points to an image of grid.elementCount() values stored in row major order.
+		void operator()(const Grid& grid, std::span<float* const> outputs, std::span<const float> uniforms = {}) const;
+		void operator()(const LoopFunctionArray& input, LoopFunctionArray& output, std::span<const float> uniforms = {}) const;
+		// Splits the array into chunks that fit into the L2 cache and evaluates them on the pool. The results are placed in the same positions as in the single threaded version.
+		void operator()(const LoopFunctionArray& input, LoopFunctionArray& output, ThreadPool& pool, std::span<const float> uniforms = {}) const;
+		static constexpr i64 PARALLEL_CHUNK_BYTE_SIZE = 256 * 1024;
+
+		// The versions for the functions compiled with Precision::F64. The arguments have the same meaning as above.
+		void operator()(const double* input, double* output, i64 elementCount, std::span<const double> uniforms = {}) const;
+		void operator()(std::span<const double* const> columns, std::span<double* const> outputs, i64 elementCount, std::span<const double> uniforms = {}) const;
+		void operator()(const LoopFunctionArrayF64& input, LoopFunctionArrayF64& output, std::span<const double> uniforms = {}) const;
+
+		struct ReductionResult {
+			float value;
+			// The index of the selected element for ARGMIN and ARGMAX. If there are multiple equal values the first one is selected. -1 if there are no elements that aren't NaN or the reduction doesn't select an element.
+			i64 index;
+		};
+		// Only for functions compiled with a reduction. The arguments are the same as the ones of the functions that write the outputs.
+		ReductionResult reduce(const float* input, i64 elementCount, std::span<const float> uniforms = {}) const;
+		ReductionResult reduce(std::span<const float* const> columns, i64 elementCount, std::span<const float> uniforms = {}) const;
+		ReductionResult reduce(const LoopFunctionArray& input, std::span<const float> uniforms = {}) const;
+		// The partial results of the chunks are combined in order so the result doesn't depend on the number of threads.
+		ReductionResult reduce(const LoopFunctionArray& input, ThreadPool& pool, std::span<const float> uniforms = {}) const;
+		ReductionResult reduceCall(const void* input, i64 elementCount, const float* uniforms) const;
+		// The ARGMIN and ARGMAX kernels track the indices as i32 so longer inputs are split into calls of at most this many elements. A multiple of 8 so the calls start at a block.
+		static constexpr i64 MAX_ARG_REDUCTION_CALL_ELEMENT_COUNT = (i64(1) << 31) - 8;
+		ReductionResult reduceCallInIndexRange(const void* input, i64 elementCount, const float* uniforms) const;
+		void combineReductionResults(ReductionResult& result, const ReductionResult& other, i64 indexOffset) const;
+		ReductionResult finishReduction(ReductionResult result, i64 elementCount) const;
+
+		// While profiling is enabled the calls record the time and the hardware counters (see KernelProfile). Can't be called while the function is being called from other threads.
+		void enableProfiling();
+		// Discards the recorded profile.
+		void disableProfiling();
+		// std::nullopt if profiling is disabled.
+		std::optional<KernelProfile::Report> profileReport() const;
+		// The input and output bytes accessed for each element.
+		i64 bytesPerElement() const;
 
-		using Function = void (*)(const __m256*, __m256*, i64);
+		// Registers the code with the outputs enabled in jitCodeRegistry(). The name of the symbol is made from the sources. Does nothing if no outputs are enabled. Called by the functions of Runtime that compile functions.
+		void registerCode(std::span<const std::string_view> sources);
+
+		using Function = void (*)(const float*, float*, i64, const float*);
+		using ColumnsFunction = void (*)(const float* const*, float* const*, i64, const float*);
+		using TypedColumnsFunction = void (*)(const void* const*, void* const*, i64, const float*);
 		Function function;
-		// TODO: Maybe store capacity so the function can be reallocated.
+		InputLayout inputLayout;
+		i64 outputCount;
+		Reduction reduction;
+		Precision precision;
+		i64 uniformCount;
+		i64 inputVariableCount;
+		// The element types of the non uniform variables and of the outputs.
+		std::vector<ElementType> inputTypes;
+		std::vector<ElementType> outputTypes;
+		bool hasTypedColumns() const;
+		CodeHeap* heap;
+		// Size of the code and data.
+		i64 size;
+		// nullptr if profiling is disabled.
+		std::unique_ptr<KernelProfile> profile;
+		JitCodeRegistry::DebuggerEntry* debuggerEntry;
 	};
 
 	using SingleFunction = void (*)(float*);
@@ -63,18 +226,66 @@ struct Runtime {
 		ParserMessageReporter& parserReporter,
 		IrCompilerMessageReporter& irCompilerReporter);
 
+	// F64 functions can only use the BLOCKS and COLUMNS layouts and can't do reductions.
+	// outputTypes[i] is the element type of the output i, the missing ones are F32. The columns with types other than F32 (including the ones of the variables) require the COLUMNS layout, F32 precision and no reduction.
 	std::optional<LoopFunction> compileFunction(
 		std::string_view source, 
-		std::span<const Variable> variables);
+		std::span<const Variable> variables,
+		InputLayout inputLayout = InputLayout::BLOCKS,
+		Reduction reduction = Reduction::NONE,
+		Precision precision = Precision::F32,
+		std::span<const ElementType> outputTypes = {});
+
+	// Compiles a function with an output for each source. The outputs are optimized together so common subexpressions are only computed once.
+	std::optional<LoopFunction> compileFunction(
+		std::span<const std::string_view> sources,
+		std::span<const Variable> variables,
+		InputLayout inputLayout = InputLayout::BLOCKS,
+		Reduction reduction = Reduction::NONE,
+		Precision precision = Precision::F32,
+		std::span<const ElementType> outputTypes = {});
 
 	std::optional<std::vector<IrOp>> compileToIr(
 		std::string_view source,
-		std::span<const Variable> variables);
-	
-	Scanner scanner;
-	Parser parser;
-	IrCompiler compiler;
-	CodeGenerator codeGenerator;
+		std::span<const Variable> variables,
+		Precision precision = Precision::F32);
+	std::optional<std::vector<IrOp>> compileToIr(
+		std::span<const std::string_view> sources,
+		std::span<const Variable> variables,
+		Precision precision = Precision::F32);
+
+	// The functions above use the context and the reporters of the runtime so they can only be called from one thread at a time.
+	// The overloads below can be called concurrently as long as each thread uses a different context. The errors are written to the reporters of the context. The functions and the code heap are shared, and the functions can't be added while compiling.
+	std::optional<MachineCode> compileToMachineCode(
+		CompilationContext& context,
+		std::span<const std::string_view> sources,
+		std::span<const Variable> variables,
+		InputLayout inputLayout = InputLayout::BLOCKS,
+		Reduction reduction = Reduction::NONE,
+		Precision precision = Precision::F32,
+		std::span<const ElementType> outputTypes = {});
+	std::optional<LoopFunction> compileFunction(
+		CompilationContext& context,
+		std::span<const std::string_view> sources,
+		std::span<const Variable> variables,
+		InputLayout inputLayout = InputLayout::BLOCKS,
+		Reduction reduction = Reduction::NONE,
+		Precision precision = Precision::F32,
+		std::span<const ElementType> outputTypes = {});
+
+	// Places the function into the code heap, registers it with the enabled tools and records the stats of the context.
+	LoopFunction placeFunction(
+		CompilationContext& context,
+		const MachineCode& machineCode,
+		std::span<const std::string_view> sources,
+		std::span<const Variable> variables,
+		InputLayout inputLayout,
+		Reduction reduction,
+		Precision precision = Precision::F32,
+		std::span<const ElementType> outputTypes = {});
+
+	// Set context.collectStats to measure the compilations. The stats of the last compilation are in context.stats.
+	CompilationContext context;
 
 	/*using LoopFunction = __m256 (*)(__m256* input, __m256* output, i64 count);
 
@@ -84,6 +295,8 @@ struct Runtime {
 
 	std::vector<FunctionInfo> functions;
 
+	CodeHeap codeHeap;
+
 	//struct Function {
 	//	void* function;
 	//	// TODO: This could probably be moved to a common data allocator. One issue is that then the pointers shouldn't change.
@@ -93,9 +306,6 @@ struct Runtime {
 	//	//std::vector<IrOp> irCode;
 	//};
 
-	LocalValueNumbering valueNumbering;
-	DeadCodeElimination deadCodeElimination;
-
 	ScannerMessageReporter& scannerReporter;
 	ParserMessageReporter& parserReporter;
 	IrCompilerMessageReporter& irCompilerReporter;
@@ -109,5 +319,14 @@ inline float LoopFunctionArray::operator()(i64 block, i64 indexInBlock) const {
 inline float& LoopFunctionArray::operator()(i64 block, i64 indexInBlock) {
 	const auto dataIndex = block / ITEMS_PER_DATA * valuesPerBlock_;
 	const auto offsetInData = block % ITEMS_PER_DATA;
-	return data_[dataIndex + indexInBlock].m256_f32[offsetInData];
+	return reinterpret_cast<float*>(&data_[dataIndex + indexInBlock])[offsetInData];
+}
+inline double LoopFunctionArrayF64::operator()(i64 block, i64 indexInBlock) const {
+	return const_cast<LoopFunctionArrayF64*>(this)->operator()(block, indexInBlock);
+}
+
+inline double& LoopFunctionArrayF64::operator()(i64 block, i64 indexInBlock) {
+	const auto dataIndex = block / ITEMS_PER_DATA * valuesPerBlock_;
+	const auto offsetInData = block % ITEMS_PER_DATA;
+	return data_[(dataIndex + indexInBlock) * ITEMS_PER_DATA + offsetInData];
 }
\ No newline at end of file
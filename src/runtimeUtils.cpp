@@ -1,5 +1,6 @@
 #include "runtimeUtils.hpp"
 #include "utils/asserts.hpp"
+#include <algorithm>
 
 std::unordered_map<AddressLabel, void*> mapFunctionLabelsToAddresses(
 	const std::unordered_map<std::string, AddressLabel>& functionNameToLabel, 
@@ -0,0 +1,26 @@
+#include "simdFunctions.hpp"
+
+// The built in functions called by the code in the objects written by machineCodeToElfObject. The names have to match functionSymbolName.
+extern "C" {
+
+__m256 SIMD_CALL mathCompiler_exp(__m256 x) {
+	return expSimd(x);
+}
+
+__m256 SIMD_CALL mathCompiler_ln(__m256 x) {
+	return lnSimd(x);
+}
+
+__m256 SIMD_CALL mathCompiler_sin(__m256 x) {
+	return sinSimd(x);
+}
+
+__m256 SIMD_CALL mathCompiler_cos(__m256 x) {
+	return cosSimd(x);
+}
+
+__m256 SIMD_CALL mathCompiler_sqrt(__m256 x) {
+	return sqrtSimd(x);
+}
+
+}
@@ -2,6 +2,10 @@
 
 #include <immintrin.h>
 #include "floatingPoint.hpp"
+#include "callingConvention.hpp"
+#include <cmath>
+#include <limits>
+#include <iterator>
 
 /*
 Range reduction:
@@ -17,7 +21,7 @@ e^(k * ln(2) + r) =
 e^(k * ln(2)) * e^r =
 2^k * e^r
 */
-inline __m256 __vectorcall expSimd(__m256 x) {
+inline __m256 SIMD_CALL expSimd(__m256 x) {
 	const auto minusLn2 = _mm256_set1_ps(-0.6931471805599453f);
 	const auto ln2Inv = _mm256_set1_ps(1.4426950408889634f);
 
@@ -68,12 +72,12 @@ k/log2(e) + ln(f + 1)
 
 TODO: Apparently there is a way to range reduce further into (sqrt(2)/2, sqrt(2)). Used for example in fdlibm and also mentionted here https://math.stackexchange.com/questions/3619158/most-efficient-way-to-calculate-logarithm-numerically.
 */
-inline __m256 __vectorcall lnSimd(__m256 x) {
+inline __m256 SIMD_CALL lnSimd(__m256 x) {
 	x = _mm256_max_ps(x, _mm256_set1_ps(0.0f));
 	const auto xBytes = _mm256_castps_si256(x);
 	// k is the exponent of x.
 	// Calculate 2^k by just making away the mantissa and sign bits of x.
-	const auto twoToKBytes = _mm256_and_epi32(xBytes, _mm256_set1_epi32(F32_EXPONENT_MASK));
+	const auto twoToKBytes = _mm256_and_si256(xBytes, _mm256_set1_epi32(F32_EXPONENT_MASK));
 	const auto twoToK = _mm256_castsi256_ps(twoToKBytes);
 	// Bitshift k and debias to get the integer value of it.
 	const auto kInt = _mm256_sub_epi32(_mm256_srli_epi32(twoToKBytes, F32_EXPONENT_SHIFT), _mm256_set1_epi32(F32_EXPONENT_BIAS));
@@ -122,7 +126,7 @@ inline __m256 __vectorcall lnSimd(__m256 x) {
 // https://stackoverflow.com/questions/8627331/what-does-ordered-unordered-comparison-mean
 
 
-inline __m256 __vectorcall powSimd(__m256 x, __m256 y) {
+inline __m256 SIMD_CALL powSimd(__m256 x, __m256 y) {
 	//const auto yRounded = _mm256_round_ps(x, _MM_FROUND_NO_EXC);
 	//const auto yInt = _mm256_castsi256_ps(x);
 	//const auto isYIntMask = _mm256_cmp_ps(y, yRounded, _CMP_EQ_OQ);
@@ -130,18 +134,156 @@ inline __m256 __vectorcall powSimd(__m256 x, __m256 y) {
 	//const auto yFirstBit
 }
 
-inline __m256 __vectorcall sinSimd(__m256 x) {
+inline __m256 SIMD_CALL sinSimd(__m256 x) {
+#ifdef _MSC_VER
 	return _mm256_sin_ps(x);
+#else
+	// _mm256_sin_ps is part of SVML, which is only available on MSVC.
+	alignas(32) float lanes[8];
+	_mm256_store_ps(lanes, x);
+	for (auto& lane : lanes) {
+		lane = std::sin(lane);
+	}
+	return _mm256_load_ps(lanes);
+#endif
 }
 
-inline __m256 __vectorcall cosSimd(__m256 x) {
+inline __m256 SIMD_CALL cosSimd(__m256 x) {
+#ifdef _MSC_VER
 	return _mm256_cos_ps(x);
+#else
+	// _mm256_cos_ps is part of SVML, which is only available on MSVC.
+	alignas(32) float lanes[8];
+	_mm256_store_ps(lanes, x);
+	for (auto& lane : lanes) {
+		lane = std::cos(lane);
+	}
+	return _mm256_load_ps(lanes);
+#endif
 }
 
-inline __m256 __vectorcall sqrtSimd(__m256 x) {
+inline __m256 SIMD_CALL sqrtSimd(__m256 x) {
 	return _mm256_sqrt_ps(x);
 }
 
+// The versions used by the code compiled with Precision::F64. Same range reductions as above, but the polynomials are long enough for double precision and ln(2) is split into 2 parts so that k * ln(2) doesn't lose bits (Cody and Waite).
+static constexpr double LN_2_HI = 6.93147180369123816490e-01;
+static constexpr double LN_2_LO = 1.90821492927058770002e-10;
+
+// Converts integers in the range [0, 2^51) stored in the lanes into doubles.
+inline __m256d smallU64ToDoubleSimd(__m256i x) {
+	const auto twoTo52 = _mm256_set1_pd(0x1p52);
+	return _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(x, _mm256_castpd_si256(twoTo52))), twoTo52);
+}
+
+// k has to be an integer in the range [-1022, 1023].
+inline __m256d twoToKSimd(__m256d k) {
+	const auto kInt = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(k));
+	const auto exponent = _mm256_add_epi64(kInt, _mm256_set1_epi64x(F64_EXPONENT_BIAS));
+	return _mm256_castsi256_pd(_mm256_slli_epi64(exponent, F64_EXPONENT_SHIFT));
+}
+
+inline __m256d SIMD_CALL expSimdF64(__m256d x) {
+	// exp(709.8) overflows and exp(-745.2) underflows to zero. The max and min return the second argument if one of the arguments is NaN so NaN is kept.
+	x = _mm256_min_pd(_mm256_set1_pd(710.0), _mm256_max_pd(_mm256_set1_pd(-746.0), x));
+
+	const auto k = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(1.4426950408889634)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	auto r = _mm256_fnmadd_pd(k, _mm256_set1_pd(LN_2_HI), x);
+	r = _mm256_fnmadd_pd(k, _mm256_set1_pd(LN_2_LO), r);
+
+	// Taylor series of exp(r). |r| <= ln(2)/2 so the error of the degree 13 polynomial is below 2^-56.
+	static constexpr double coefficients[] = {
+		1.0 / 6227020800.0, 1.0 / 479001600.0, 1.0 / 39916800.0, 1.0 / 3628800.0, 1.0 / 362880.0, 1.0 / 40320.0,
+		1.0 / 5040.0, 1.0 / 720.0, 1.0 / 120.0, 1.0 / 24.0, 1.0 / 6.0, 1.0 / 2.0, 1.0, 1.0,
+	};
+	auto m = _mm256_set1_pd(coefficients[0]);
+	for (int i = 1; i < int(std::size(coefficients)); i++) {
+		m = _mm256_fmadd_pd(r, m, _mm256_set1_pd(coefficients[i]));
+	}
+
+	// k is in [-1077, 1025], which doesn't fit into the exponent, so 2^k is applied in 2 steps. This also makes the results that underflow denormal.
+	const auto k0 = _mm256_floor_pd(_mm256_mul_pd(k, _mm256_set1_pd(0.5)));
+	const auto k1 = _mm256_sub_pd(k, k0);
+	return _mm256_mul_pd(_mm256_mul_pd(m, twoToKSimd(k0)), twoToKSimd(k1));
+}
+
+/*
+Same as lnSimd, but the mantissa is reduced into [sqrt(2)/2, sqrt(2)] and
+ln(m) = 2 * atanh(s) = 2 * (s + s^3/3 + s^5/5 + ...), where s = (m - 1) / (m + 1).
+|s| <= 0.172 so the terms after s^23/23 are too small to change the result.
+*/
+inline __m256d SIMD_CALL lnSimdF64(__m256d x) {
+	const auto zero = _mm256_setzero_pd();
+	// The denormals are scaled into normal numbers.
+	const auto isDenormal = _mm256_cmp_pd(x, _mm256_set1_pd(0x1p-1022), _CMP_LT_OQ);
+	const auto scaled = _mm256_blendv_pd(x, _mm256_mul_pd(x, _mm256_set1_pd(0x1p54)), isDenormal);
+	const auto bits = _mm256_castpd_si256(scaled);
+
+	const auto biasedExponent = smallU64ToDoubleSimd(_mm256_srli_epi64(_mm256_and_si256(bits, _mm256_set1_epi64x(F64_EXPONENT_MASK)), F64_EXPONENT_SHIFT));
+	auto k = _mm256_sub_pd(biasedExponent, _mm256_set1_pd(double(F64_EXPONENT_BIAS)));
+	k = _mm256_sub_pd(k, _mm256_and_pd(isDenormal, _mm256_set1_pd(54.0)));
+
+	auto m = _mm256_castsi256_pd(_mm256_or_si256(
+		_mm256_and_si256(bits, _mm256_set1_epi64x(F64_SIGNIFICAND_MASK)),
+		_mm256_castpd_si256(_mm256_set1_pd(1.0))));
+	const auto isAboveSqrt2 = _mm256_cmp_pd(m, _mm256_set1_pd(1.4142135623730951), _CMP_GT_OQ);
+	m = _mm256_blendv_pd(m, _mm256_mul_pd(m, _mm256_set1_pd(0.5)), isAboveSqrt2);
+	k = _mm256_add_pd(k, _mm256_and_pd(isAboveSqrt2, _mm256_set1_pd(1.0)));
+
+	const auto f = _mm256_sub_pd(m, _mm256_set1_pd(1.0));
+	const auto s = _mm256_div_pd(f, _mm256_add_pd(f, _mm256_set1_pd(2.0)));
+	const auto z = _mm256_mul_pd(s, s);
+	static constexpr double coefficients[] = {
+		1.0 / 23.0, 1.0 / 21.0, 1.0 / 19.0, 1.0 / 17.0, 1.0 / 15.0, 1.0 / 13.0,
+		1.0 / 11.0, 1.0 / 9.0, 1.0 / 7.0, 1.0 / 5.0, 1.0 / 3.0,
+	};
+	auto p = _mm256_set1_pd(coefficients[0]);
+	for (int i = 1; i < int(std::size(coefficients)); i++) {
+		p = _mm256_fmadd_pd(z, p, _mm256_set1_pd(coefficients[i]));
+	}
+	const auto twoS = _mm256_add_pd(s, s);
+	// 2s + 2s * z * p
+	const auto lnM = _mm256_fmadd_pd(_mm256_mul_pd(twoS, z), p, twoS);
+
+	auto result = _mm256_fmadd_pd(k, _mm256_set1_pd(LN_2_HI), _mm256_fmadd_pd(k, _mm256_set1_pd(LN_2_LO), lnM));
+
+	const auto infinity = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+	result = _mm256_blendv_pd(result, _mm256_sub_pd(zero, infinity), _mm256_cmp_pd(x, zero, _CMP_EQ_OQ));
+	result = _mm256_blendv_pd(result, _mm256_set1_pd(std::numeric_limits<double>::quiet_NaN()), _mm256_cmp_pd(x, zero, _CMP_NGE_UQ));
+	result = _mm256_blendv_pd(result, infinity, _mm256_cmp_pd(x, infinity, _CMP_EQ_OQ));
+	return result;
+}
+
+inline __m256d SIMD_CALL sinSimdF64(__m256d x) {
+#ifdef _MSC_VER
+	return _mm256_sin_pd(x);
+#else
+	alignas(32) double lanes[4];
+	_mm256_store_pd(lanes, x);
+	for (auto& lane : lanes) {
+		lane = std::sin(lane);
+	}
+	return _mm256_load_pd(lanes);
+#endif
+}
+
+inline __m256d SIMD_CALL cosSimdF64(__m256d x) {
+#ifdef _MSC_VER
+	return _mm256_cos_pd(x);
+#else
+	alignas(32) double lanes[4];
+	_mm256_store_pd(lanes, x);
+	for (auto& lane : lanes) {
+		lane = std::cos(lane);
+	}
+	return _mm256_load_pd(lanes);
+#endif
+}
+
+inline __m256d SIMD_CALL sqrtSimdF64(__m256d x) {
+	return _mm256_sqrt_pd(x);
+}
+
 /*
 
 lnTest lower degree with calculated coefficients
@@ -0,0 +1,94 @@
+#include "streamingEvaluator.hpp"
+#include "utils/asserts.hpp"
+#include "utils/rounding.hpp"
+#include <thread>
+
+StreamingEvaluator::StreamingEvaluator(const Runtime::LoopFunction& function, i64 chunkRowCount)
+	: function(function)
+	, chunkRowCount(chunkRowCount) {
+	ASSERT(function.inputLayout == InputLayout::BLOCKS);
+	ASSERT(function.reduction == Reduction::NONE);
+
+	if (this->chunkRowCount <= 0) {
+		const auto bytesPerRow = (function.inputVariableCount + function.outputCount) * i64(sizeof(float));
+		const auto rowCount = Runtime::LoopFunction::PARALLEL_CHUNK_BYTE_SIZE / std::max(bytesPerRow, i64(1));
+		this->chunkRowCount = std::max(roundUpToMultiple(rowCount, LoopFunctionArray::ITEMS_PER_DATA), i64(LoopFunctionArray::ITEMS_PER_DATA));
+	}
+
+	for (auto& buffer : buffers) {
+		buffer.rows.resize(this->chunkRowCount * function.inputVariableCount);
+		buffer.blocks.reset(function.inputVariableCount);
+	}
+	outputBlocks.reset(function.outputCount);
+	outputRows.resize(this->chunkRowCount * function.outputCount);
+}
+
+i64 StreamingEvaluator::run(const Source& source, const Sink& sink, std::span<const float> uniforms) {
+	for (auto& buffer : buffers) {
+		buffer.filled = false;
+	}
+
+	std::thread loader([&] {
+		for (i64 i = 0;; i = (i + 1) % std::size(buffers)) {
+			auto& buffer = buffers[i];
+			{
+				std::unique_lock lock(mutex);
+				bufferStateChanged.wait(lock, [&] { return !buffer.filled; });
+			}
+
+			buffer.rowCount = source(buffer.rows, chunkRowCount);
+			if (buffer.rowCount < 0 || buffer.rowCount > chunkRowCount) {
+				ASSERT_NOT_REACHED();
+				buffer.rowCount = 0;
+			}
+			transposeRowsToBlocks(buffer);
+
+			{
+				std::lock_guard lock(mutex);
+				buffer.filled = true;
+			}
+			bufferStateChanged.notify_all();
+			if (buffer.rowCount == 0) {
+				return;
+			}
+		}
+	});
+
+	i64 evaluatedRowCount = 0;
+	for (i64 i = 0;; i = (i + 1) % std::size(buffers)) {
+		auto& buffer = buffers[i];
+		{
+			std::unique_lock lock(mutex);
+			bufferStateChanged.wait(lock, [&] { return buffer.filled; });
+		}
+		if (buffer.rowCount == 0) {
+			break;
+		}
+
+		outputBlocks.resizeWithoutCopy(buffer.rowCount);
+		function(buffer.blocks, outputBlocks, uniforms);
+		// The input buffer can be refilled while the sink is running.
+		const auto rowCount = buffer.rowCount;
+		{
+			std::lock_guard lock(mutex);
+			buffer.filled = false;
+		}
+		bufferStateChanged.notify_all();
+
+		transposeBlocksToRows(rowCount);
+		sink(std::span<const float>(outputRows.data(), rowCount * function.outputCount), rowCount);
+		evaluatedRowCount += rowCount;
+	}
+
+	loader.join();
+	return evaluatedRowCount;
+}
+
+void StreamingEvaluator::transposeRowsToBlocks(Buffer& buffer) {
+	buffer.blocks.clear();
+	buffer.blocks.appendRows(std::span<const float>(buffer.rows.data(), buffer.rowCount * function.inputVariableCount));
+}
+
+void StreamingEvaluator::transposeBlocksToRows(i64 rowCount) {
+	outputBlocks.readRows(std::span<float>(outputRows.data(), rowCount * function.outputCount));
+}
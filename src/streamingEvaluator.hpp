@@ -0,0 +1,43 @@
+#pragma once
+
+#include "runtime.hpp"
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+
+// Evaluates a function compiled with InputLayout::BLOCKS on data that doesn't fit into memory at once, for example data read from a file.
+// The data is passed in rows. A row contains the values of the non uniform variables of a single element. The rows are read in chunks and transposed into the block layout on a separate thread while the previous chunk is being evaluated. There are only 2 chunk buffers so the source is blocked until the sink has consumed the older chunk.
+// The buffers are reused between the calls to run.
+struct StreamingEvaluator {
+	// Writes at most maxRowCount rows into rows and returns the number of rows written. Returning 0 ends the stream.
+	using Source = std::function<i64(std::span<float> rows, i64 maxRowCount)>;
+	// Receives the outputs of rowCount rows. Each row contains the values of all the outputs. The chunks are received in the order they were read.
+	using Sink = std::function<void(std::span<const float> outputRows, i64 rowCount)>;
+
+	// If chunkRowCount is 0 then the chunk size is chosen so both the input and the output of a chunk fit into the L2 cache.
+	StreamingEvaluator(const Runtime::LoopFunction& function, i64 chunkRowCount = 0);
+	StreamingEvaluator(const StreamingEvaluator&) = delete;
+	StreamingEvaluator& operator=(const StreamingEvaluator&) = delete;
+
+	// The source is called from a separate thread and the sink from the calling thread. Returns the number of evaluated rows.
+	i64 run(const Source& source, const Sink& sink, std::span<const float> uniforms = {});
+
+	struct Buffer {
+		std::vector<float> rows;
+		LoopFunctionArray blocks;
+		i64 rowCount = 0;
+		// Set by the loading thread and cleared after the chunk is evaluated.
+		bool filled = false;
+	};
+	void transposeRowsToBlocks(Buffer& buffer);
+	void transposeBlocksToRows(i64 rowCount);
+
+	const Runtime::LoopFunction& function;
+	i64 chunkRowCount;
+	Buffer buffers[2];
+	LoopFunctionArray outputBlocks;
+	std::vector<float> outputRows;
+
+	std::mutex mutex;
+	std::condition_variable bufferStateChanged;
+};
@@ -0,0 +1,109 @@
+#include "threadPool.hpp"
+#include "os/os.hpp"
+#include "utils/asserts.hpp"
+
+ThreadPool::ThreadPool(i64 threadCount, bool pinThreads)
+	: generation(0)
+	, stopping(false)
+	, remainingTasks(0) {
+	if (threadCount <= 0) {
+		threadCount = std::max(i64(std::thread::hardware_concurrency()), i64(1));
+	}
+	for (i64 i = 0; i < threadCount; i++) {
+		workers.push_back(std::make_unique<Worker>());
+	}
+	// The threads are started after all the workers exist, because they steal from each other.
+	for (i64 i = 0; i < threadCount; i++) {
+		workers[i]->thread = std::thread(&ThreadPool::workerLoop, this, i, pinThreads);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard lock(mutex);
+		stopping = true;
+	}
+	workAvailable.notify_all();
+	for (auto& worker : workers) {
+		worker->thread.join();
+	}
+}
+
+void ThreadPool::parallelFor(i64 taskCount, const std::function<void(i64)>& task) {
+	if (taskCount <= 0) {
+		return;
+	}
+
+	std::lock_guard parallelForLock(parallelForMutex);
+	const auto workerCount = i64(workers.size());
+	// Set before the tasks become visible to the workers.
+	remainingTasks = taskCount;
+	for (i64 i = 0; i < workerCount; i++) {
+		const auto start = taskCount * i / workerCount;
+		const auto end = taskCount * (i + 1) / workerCount;
+		std::lock_guard lock(workers[i]->mutex);
+		for (i64 taskIndex = start; taskIndex < end; taskIndex++) {
+			workers[i]->tasks.push_back(Task{ .function = &task, .index = taskIndex });
+		}
+	}
+
+	std::unique_lock lock(mutex);
+	generation++;
+	workAvailable.notify_all();
+	workFinished.wait(lock, [this] { return remainingTasks == 0; });
+}
+
+i64 ThreadPool::threadCount() const {
+	return i64(workers.size());
+}
+
+void ThreadPool::workerLoop(i64 workerIndex, bool pinThread) {
+	if (pinThread) {
+		pinCurrentThreadToCore(workerIndex);
+	}
+
+	i64 seenGeneration = 0;
+	for (;;) {
+		{
+			std::unique_lock lock(mutex);
+			workAvailable.wait(lock, [&] { return stopping || generation != seenGeneration; });
+			if (stopping) {
+				return;
+			}
+			seenGeneration = generation;
+		}
+
+		while (const auto task = popTask(workerIndex)) {
+			(*task->function)(task->index);
+			if (remainingTasks.fetch_sub(1) == 1) {
+				// Taking the lock prevents the notification from happening between the check and the wait in parallelFor.
+				std::lock_guard lock(mutex);
+				workFinished.notify_all();
+			}
+		}
+	}
+}
+
+std::optional<ThreadPool::Task> ThreadPool::popTask(i64 workerIndex) {
+	{
+		auto& worker = *workers[workerIndex];
+		std::lock_guard lock(worker.mutex);
+		if (!worker.tasks.empty()) {
+			const auto task = worker.tasks.front();
+			worker.tasks.pop_front();
+			return task;
+		}
+	}
+
+	const auto workerCount = i64(workers.size());
+	for (i64 i = 1; i < workerCount; i++) {
+		auto& victim = *workers[(workerIndex + i) % workerCount];
+		std::lock_guard lock(victim.mutex);
+		if (!victim.tasks.empty()) {
+			const auto task = victim.tasks.back();
+			victim.tasks.pop_back();
+			return task;
+		}
+	}
+	return std::nullopt;
+}
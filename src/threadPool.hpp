@@ -0,0 +1,51 @@
+#pragma once
+
+#include "utils/ints.hpp"
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <optional>
+
+// Persistent pool of threads used for evaluating functions in parallel.
+// parallelFor splits the task indices into contiguous ranges, one for each worker. A worker that runs out of tasks steals from the end of the range of another worker. Contiguous ranges mean that neighbouring chunks of an array are usually processed by the same thread.
+struct ThreadPool {
+	// If threadCount is 0 then std::thread::hardware_concurrency() threads are created.
+	// If pinThreads is true then the worker i is pinned to the core i.
+	ThreadPool(i64 threadCount = 0, bool pinThreads = false);
+	~ThreadPool();
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// Calls task(i) for every i in [0, taskCount) and waits until all of them are finished. Only one parallelFor runs at a time.
+	void parallelFor(i64 taskCount, const std::function<void(i64)>& task);
+	i64 threadCount() const;
+
+	// The function is stored with each index, because a worker might still be looking for tasks when the next parallelFor starts.
+	struct Task {
+		const std::function<void(i64)>* function;
+		i64 index;
+	};
+	struct Worker {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+		std::thread thread;
+	};
+	void workerLoop(i64 workerIndex, bool pinThread);
+	std::optional<Task> popTask(i64 workerIndex);
+
+	std::vector<std::unique_ptr<Worker>> workers;
+
+	std::mutex parallelForMutex;
+	std::mutex mutex;
+	std::condition_variable workAvailable;
+	std::condition_variable workFinished;
+	// Incremented each time parallelFor adds tasks.
+	i64 generation;
+	bool stopping;
+	std::atomic<i64> remainingTasks;
+};
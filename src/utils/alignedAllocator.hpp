@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+// Allocates the elements of containers like std::vector aligned to ALIGNMENT bytes. Used instead of containers of the intrinsic types, whose alignment attributes are ignored by templates.
+template<typename T, std::size_t ALIGNMENT>
+struct AlignedAllocator {
+	using value_type = T;
+
+	template<typename U>
+	struct rebind {
+		using other = AlignedAllocator<U, ALIGNMENT>;
+	};
+
+	AlignedAllocator() = default;
+	template<typename U>
+	AlignedAllocator(const AlignedAllocator<U, ALIGNMENT>&) {}
+
+	T* allocate(std::size_t count) {
+		return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(ALIGNMENT)));
+	}
+	void deallocate(T* data, std::size_t) {
+		::operator delete(data, std::align_val_t(ALIGNMENT));
+	}
+
+	template<typename U>
+	bool operator==(const AlignedAllocator<U, ALIGNMENT>&) const { return true; }
+};
@@ -1,7 +1,26 @@
 #include "fileIo.hpp"
 #include <fstream>
 
-void outputToFile(const char* filename, const std::vector<u8>& buffer) {
+bool outputToFile(const char* filename, const std::vector<u8>& buffer) {
 	std::ofstream bin(filename, std::ios::out | std::ios::binary);
 	bin.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+	return bin.good();
+}
+
+std::optional<std::vector<u8>> readFile(const char* filename) {
+	std::ifstream file(filename, std::ios::in | std::ios::binary | std::ios::ate);
+	if (!file.is_open()) {
+		return std::nullopt;
+	}
+	const auto size = std::streamoff(file.tellg());
+	if (size < 0) {
+		return std::nullopt;
+	}
+	std::vector<u8> buffer(size);
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(buffer.data()), size);
+	if (!file.good()) {
+		return std::nullopt;
+	}
+	return buffer;
 }
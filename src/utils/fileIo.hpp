@@ -2,5 +2,9 @@
 
 #include "ints.hpp"
 #include <vector>
+#include <optional>
 
-void outputToFile(const char* filename, const std::vector<u8>& buffer);
\ No newline at end of file
+// Returns false if the file couldn't be written.
+bool outputToFile(const char* filename, const std::vector<u8>& buffer);
+// Returns std::nullopt if the file couldn't be read.
+std::optional<std::vector<u8>> readFile(const char* filename);
@@ -2,6 +2,7 @@
 #include "floatingPoint.hpp"
 #include "utils/asserts.hpp"
 #include <bit>
+#include <cmath>
 
 using namespace Lvn;
 
@@ -12,7 +13,7 @@ void LocalValueNumbering::initialize(std::span<const Variable> parameters) {
 	valueNumberToVal.clear();
 }
 
-static bool isFloatInteger(float x) {
+static bool isFloatInteger(RealConstant x) {
 	return x == std::floor(x);
 }
 
@@ -25,8 +26,9 @@ https://people.eecs.berkeley.edu/~wkahan/ieee754status/IEEE754.PDF
 Look at the output of compilers
 */
 
-std::vector<IrOp> LocalValueNumbering::run(const std::vector<IrOp>& irCode, std::span<const Variable> parameters, std::vector<IrOp>& output) {
+std::vector<IrOp> LocalValueNumbering::run(const std::vector<IrOp>& irCode, std::span<const Variable> parameters, std::vector<IrOp>& output, Precision precision) {
 	initialize(parameters);
+	this->precision = precision;
 	output.clear();
 
 	bool performUnsafeOptimizations = false;
@@ -40,7 +42,7 @@ std::vector<IrOp> LocalValueNumbering::run(const std::vector<IrOp>& irCode, std:
 				return Computed{
 					.destinationRegister = op.destination,
 					.destinationValueNumber = regToValueNumber(op.destination),
-					.value = ConstantVal{ op.constant }
+					.value = ConstantVal{ roundToPrecision(op.constant) }
 				};
 			},
 			[this, &output](const LoadVariableOp& op) -> std::optional<Computed> {
@@ -55,7 +57,7 @@ std::vector<IrOp> LocalValueNumbering::run(const std::vector<IrOp>& irCode, std:
 				const auto d = getBinaryOpData(op.destination, op.lhs, op.rhs);
 
 				if (d.lhsConst != nullptr && d.rhsConst != nullptr) {
-					const auto value = d.lhsConst->value + d.rhsConst->value;
+					const auto value = roundToPrecision(d.lhsConst->value + d.rhsConst->value);
 					return Computed{
 						.destinationRegister = op.destination,
 						.destinationValueNumber = d.destinationVn,
@@ -75,10 +77,10 @@ std::vector<IrOp> LocalValueNumbering::run(const std::vector<IrOp>& irCode, std:
 					return computed;
 				}
 
-				if (ignoreNegativeZero && f32BitwiseEquals(e->b, 0.0f)) {
+				if (ignoreNegativeZero && f64BitwiseEquals(e->b, 0.0)) {
 					// -0 + 0 = 0 not -0
 					return computeIdentity(op.destination, e->a);
-				} else if (f32BitwiseEquals(e->b, -0.0f)) {
+				} else if (f64BitwiseEquals(e->b, -0.0)) {
 					return computeIdentity(op.destination, e->a);
 				}
 
@@ -97,10 +99,10 @@ std::vector<IrOp> LocalValueNumbering::run(const std::vector<IrOp>& irCode, std:
 					return Computed{
 						.destinationRegister = op.destination,
 						.destinationValueNumber = d.destinationVn,
-						.value = ConstantVal{ d.lhsConst->value - d.rhsConst->value }
+						.value = ConstantVal{ roundToPrecision(d.lhsConst->value - d.rhsConst->value) }
 					};
 				} 
-				if (d.rhsConst != nullptr && f32BitwiseEquals(d.rhsConst->value, 0.0f)) {
+				if (d.rhsConst != nullptr && f64BitwiseEquals(d.rhsConst->value, 0.0)) {
 					// -0 - -0 = 0 not -0
 					regToValueNumberMap[op.destination] = d.lhsVn;
 					return std::nullopt;
@@ -130,7 +132,7 @@ std::vector<IrOp> LocalValueNumbering::run(const std::vector<IrOp>& irCode, std:
 					return Computed{
 						.destinationRegister = op.destination,
 						.destinationValueNumber = d.destinationVn,
-						.value = ConstantVal{ d.lhsConst->value * d.rhsConst->value }
+						.value = ConstantVal{ roundToPrecision(d.lhsConst->value * d.rhsConst->value) }
 					};
 				} 
 
@@ -175,7 +177,7 @@ std::vector<IrOp> LocalValueNumbering::run(const std::vector<IrOp>& irCode, std:
 					return Computed{
 						.destinationRegister = op.destination,
 						.destinationValueNumber = d.destinationVn,
-						.value = ConstantVal{ d.lhsConst->value / d.rhsConst->value }
+						.value = ConstantVal{ roundToPrecision(d.lhsConst->value / d.rhsConst->value) }
 					};
 				}
 
@@ -250,10 +252,16 @@ std::vector<IrOp> LocalValueNumbering::run(const std::vector<IrOp>& irCode, std:
 				const auto d = getBinaryOpData(op.destination, op.lhs, op.rhs);
 
 				if (d.lhsConst != nullptr && d.rhsConst != nullptr) {
-					const u32 a = std::bit_cast<u32>(d.lhsConst->value);
-					const u32 b = std::bit_cast<u32>(d.rhsConst->value);
-					const u32 result = a xor b;
-					const auto value = std::bit_cast<float>(result);
+					RealConstant value;
+					if (this->precision == Precision::F32) {
+						const u32 a = std::bit_cast<u32>(float(d.lhsConst->value));
+						const u32 b = std::bit_cast<u32>(float(d.rhsConst->value));
+						value = std::bit_cast<float>(a xor b);
+					} else {
+						const u64 a = std::bit_cast<u64>(d.lhsConst->value);
+						const u64 b = std::bit_cast<u64>(d.rhsConst->value);
+						value = std::bit_cast<double>(a xor b);
+					}
 					return Computed{
 						.destinationRegister = op.destination,
 						.destinationValueNumber = d.destinationVn,
@@ -301,7 +309,7 @@ std::vector<IrOp> LocalValueNumbering::run(const std::vector<IrOp>& irCode, std:
 				return std::nullopt;
 			},
 			[this, &output](const ReturnOp& op) -> std::optional<Computed> {
-				const ReturnOp newOp{ .returnedRegister = regToValueNumber(op.returnedRegister) };
+				const ReturnOp newOp{ .returnedRegister = regToValueNumber(op.returnedRegister), .outputIndex = op.outputIndex };
 				output.push_back(newOp);
 				return std::nullopt;
 			}
@@ -414,7 +422,7 @@ std::optional<LocalValueNumbering::CommutativeOpWithOneConstantData> LocalValueN
 
 	Register aRegister;
 	ValueNumber a;
-	float b;
+	RealConstant b;
 
 	if (d.lhsConst != nullptr) {
 		aRegister = rhsReg;
@@ -435,7 +443,8 @@ std::optional<LocalValueNumbering::CommutativeOpWithOneConstantData> LocalValueN
 }
 
 LocalValueNumbering::Computed LocalValueNumbering::computeNegation(std::vector<IrOp>& output, ValueNumber operand, ValueNumber destinationVn, Register destinationRegister) {
-	const auto maskConstant = std::bit_cast<float>(F32_SIGN_MASK);
+	// Only the sign bit of -0 is set in both precisions.
+	const RealConstant maskConstant = -0.0;
 	const auto maskVn = getConstantValueNumber(output, maskConstant);
 	return Computed{
 		.destinationRegister = destinationRegister,
@@ -444,7 +453,7 @@ LocalValueNumbering::Computed LocalValueNumbering::computeNegation(std::vector<I
 	};
 }
 
-Lvn::ValueNumber LocalValueNumbering::getConstantValueNumber(std::vector<IrOp>& output, float constant) {
+Lvn::ValueNumber LocalValueNumbering::getConstantValueNumber(std::vector<IrOp>& output, RealConstant constant) {
 	const auto val = ConstantVal{ .value = constant };
 	const auto valIt = valToValueNumber.find(val);
 	if (valIt != valToValueNumber.end()) {
@@ -458,6 +467,11 @@ Lvn::ValueNumber LocalValueNumbering::getConstantValueNumber(std::vector<IrOp>&
 	return vn;
 }
 
+RealConstant LocalValueNumbering::roundToPrecision(RealConstant value) const {
+	// Rounding the exact result of an operation on floats computed in double to float gives the same result as computing it in float, because double has more than 2 * 24 + 2 bits of precision.
+	return precision == Precision::F32 ? RealConstant(float(value)) : value;
+}
+
 std::nullopt_t LocalValueNumbering::computeIdentity(Register destinationRegister, Lvn::ValueNumber value) {
 	// If you refer to destinationRegister then you will be refering to value.
 	regToValueNumberMap[destinationRegister] = value;
@@ -504,5 +518,5 @@ Lvn::XorVal::XorVal(ValueNumber lhs, ValueNumber rhs) {
 }
 
 bool Lvn::ConstantVal::operator==(const ConstantVal& other) const {
-	return f32BitwiseEquals(value, other.value);
+	return f64BitwiseEquals(value, other.value);
 }
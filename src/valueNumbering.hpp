@@ -49,7 +49,7 @@ namespace Lvn {
 	};
 
 	struct ConstantVal {
-		Real value;
+		RealConstant value;
 
 		/*bool operator==(const ConstantVal&) const = default;*/
 		bool operator==(const ConstantVal& other) const;
@@ -89,7 +89,7 @@ namespace std {
 				HASH_BINARY_OP(DivideVal, DIVIDE),
 				HASH_BINARY_OP(XorVal, XOR),
 				[](const ConstantVal& e) -> usize {
-					return hash<Real>()(e.value);
+					return hash<RealConstant>()(e.value);
 				},
 				[](const VariableVal& e) -> usize {
 					return hash<i64>()(e.variableIndex);
@@ -108,7 +108,10 @@ struct LocalValueNumbering {
 
 	void initialize(std::span<const Variable> parameters);
 
-	std::vector<IrOp> run(const std::vector<IrOp>& irCode, std::span<const Variable> parameters, std::vector<IrOp>& output);
+	// The constants are folded with the precision the code will be compiled with.
+	std::vector<IrOp> run(const std::vector<IrOp>& irCode, std::span<const Variable> parameters, std::vector<IrOp>& output, Precision precision = Precision::F32);
+	Precision precision = Precision::F32;
+	RealConstant roundToPrecision(RealConstant value) const;
 
 	Lvn::ValueNumber regToValueNumber(Register reg);
 	const Lvn::ConstantVal* tryGetConstant(Lvn::ValueNumber vn) const;
@@ -126,7 +129,7 @@ struct LocalValueNumbering {
 	struct CommutativeOpWithOneConstantData {
 		Register aRegister;
 		Lvn::ValueNumber a;
-		float b;
+		RealConstant b;
 	};
 	std::optional<CommutativeOpWithOneConstantData> getCommutativeOpWithOneConstantData(const BinaryOpData& d, Register lhsReg, Register rhsReg);
 
@@ -135,7 +138,7 @@ struct LocalValueNumbering {
 		Lvn::ValueNumber destinationValueNumber;
 		Lvn::Val value;
 	};
-	Lvn::ValueNumber getConstantValueNumber(std::vector<IrOp>& output, float constant);
+	Lvn::ValueNumber getConstantValueNumber(std::vector<IrOp>& output, RealConstant constant);
 	Computed computeNegation(std::vector<IrOp>& output, Lvn::ValueNumber operand, Lvn::ValueNumber destinationVn, Register destinationRegister);
 	std::nullopt_t computeIdentity(Register destinationRegister, Lvn::ValueNumber value);
 
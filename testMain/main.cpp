@@ -25,7 +25,7 @@ void test() {
 	std::ostream& outputStream = std::cerr;
 
 	const FunctionInfo functionArray[] = {
-		{.name = "exp", .arity = 1, .address = expSimd, }
+		{.name = "exp", .arity = 1, .address = reinterpret_cast<void*>(expSimd), }
 	};
 
 	std::span<const FunctionInfo> functions = functionArray;
@@ -66,7 +66,8 @@ void test() {
 	}
 
 	LocalValueNumbering valueNumbering;
-	auto optimizedCode = valueNumbering.run(*irCode, parameters);
+	std::vector<IrOp> optimizedCode;
+	valueNumbering.run(*irCode, parameters, optimizedCode);
 	const auto copy = optimizedCode;
 	DeadCodeElimination deadCodeElimination;
 	deadCodeElimination.run(copy, parameters, optimizedCode);
@@ -24,7 +24,7 @@ void allocatorTest() {
 	Variable parameters[]{ { "x_0" }, { "x_1" }, { "x_2" }, { "x_3" }, { "x_4" } };
 	float arguments[] = { 1.0f, 2.0f, 3.0f, 4.0f, 5.0f };
 	const FunctionInfo functions[] = {
-		{.name = "exp", .arity = 1, .address = expSimd, }
+		{.name = "exp", .arity = 1, .address = reinterpret_cast<void*>(expSimd), }
 	};
 
 	for (i64 i = 0; i < 1000000; i++) {
@@ -0,0 +1,41 @@
+#include "batchCompilationBenchmark.hpp"
+#include "batchCompiler.hpp"
+#include "utils/put.hpp"
+#include <chrono>
+#include <string>
+
+void batchCompilationBenchmark() {
+	ListScannerMessageReporter scannerReporter;
+	ListParserMessageReporter parserReporter;
+	ListIrCompilerMessageReporter irCompilerReporter;
+	Runtime runtime(scannerReporter, parserReporter, irCompilerReporter);
+	const Variable variables[] = { { "x" }, { "y" } };
+
+	const i64 sourceCount = 5000;
+	std::vector<std::string> sourceStrings;
+	for (i64 i = 0; i < sourceCount; i++) {
+		sourceStrings.push_back("sqrt(xx + yy) / (x + " + std::to_string(i) + ") - exp(y * " + std::to_string(i % 17) + ")");
+	}
+	const std::vector<std::string_view> sources(sourceStrings.begin(), sourceStrings.end());
+
+	{
+		const auto start = std::chrono::steady_clock::now();
+		std::vector<Runtime::LoopFunction> functions;
+		for (const auto& source : sources) {
+			functions.push_back(std::move(*runtime.compileFunction(source, variables)));
+		}
+		const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		put("single runtime: % functions/s", double(sourceCount) / seconds);
+	}
+
+	const auto maxThreadCount = std::max(i64(std::thread::hardware_concurrency()), i64(1));
+	for (i64 threadCount = 1; ; threadCount = std::min(threadCount * 2, maxThreadCount)) {
+		ThreadPool pool(threadCount);
+		BatchCompiler compiler(runtime, pool);
+		const auto results = compiler.compile(sources, variables);
+		put("batch with % threads: % functions/s, % code bytes", threadCount, compiler.stats.functionsPerSecond(), compiler.stats.codeBytes);
+		if (threadCount == maxThreadCount) {
+			break;
+		}
+	}
+}
@@ -0,0 +1,9 @@
+#include "parallelEvaluationBenchmark.hpp"
+#include "transposeBenchmark.hpp"
+#include "batchCompilationBenchmark.hpp"
+
+int main() {
+	parallelEvaluationBenchmark();
+	transposeBenchmark();
+	batchCompilationBenchmark();
+}
@@ -0,0 +1,63 @@
+#include "parallelEvaluationBenchmark.hpp"
+#include "runtime.hpp"
+#include "listScannerMessageReporter.hpp"
+#include "listParserMessageReporter.hpp"
+#include "listIrCompilerMessageReporter.hpp"
+#include "utils/put.hpp"
+#include <chrono>
+
+template<typename Function>
+static double measureSeconds(Function f) {
+	const auto start = std::chrono::steady_clock::now();
+	f();
+	const auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double>(end - start).count();
+}
+
+void parallelEvaluationBenchmark() {
+	ListScannerMessageReporter scannerReporter;
+	ListParserMessageReporter parserReporter;
+	ListIrCompilerMessageReporter irCompilerReporter;
+	Runtime runtime(scannerReporter, parserReporter, irCompilerReporter);
+
+	const Variable variables[] = { { "x" }, { "y" } };
+	const auto function = runtime.compileFunction("sqrt(xx + yy) / (x + 2) - exp(y)", variables);
+	if (!function.has_value()) {
+		put("failed to compile");
+		return;
+	}
+
+	const i64 pointCount = 1 << 23;
+	LoopFunctionArray input(2);
+	for (i64 i = 0; i < pointCount; i++) {
+		const float block[] = { float(i % 1000) / 1000.0f, float(i % 777) / 777.0f };
+		input.append(block);
+	}
+	LoopFunctionArray output(1);
+	output.resizeWithoutCopy(input.blockCount());
+
+	const auto repetitions = 5;
+	const auto singleThreadedSeconds = measureSeconds([&] {
+		for (i64 i = 0; i < repetitions; i++) {
+			(*function)(input, output);
+		}
+	});
+	const auto pointsPerSecond = [&](double seconds) {
+		return double(pointCount) * repetitions / seconds;
+	};
+	put("single threaded: % points/s", pointsPerSecond(singleThreadedSeconds));
+
+	const auto maxThreadCount = std::max(i64(std::thread::hardware_concurrency()), i64(1));
+	for (i64 threadCount = 1; ; threadCount = std::min(threadCount * 2, maxThreadCount)) {
+		ThreadPool pool(threadCount);
+		const auto seconds = measureSeconds([&] {
+			for (i64 i = 0; i < repetitions; i++) {
+				(*function)(input, output, pool);
+			}
+		});
+		put("% threads: % points/s, speedup %", threadCount, pointsPerSecond(seconds), singleThreadedSeconds / seconds);
+		if (threadCount == maxThreadCount) {
+			break;
+		}
+	}
+}
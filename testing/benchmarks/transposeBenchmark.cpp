@@ -0,0 +1,64 @@
+#include "transposeBenchmark.hpp"
+#include "runtime.hpp"
+#include "utils/put.hpp"
+#include <chrono>
+
+template<typename Function>
+static double measureSeconds(Function f) {
+	const auto start = std::chrono::steady_clock::now();
+	f();
+	const auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double>(end - start).count();
+}
+
+void transposeBenchmark() {
+	const i64 rowCount = 1 << 20;
+	const auto repetitions = 10;
+	for (const i64 valuesPerRow : { 1, 3, 8, 11 }) {
+		std::vector<float> rows(rowCount * valuesPerRow);
+		for (i64 i = 0; i < i64(rows.size()); i++) {
+			rows[i] = float(i % 1000);
+		}
+		LoopFunctionArray array(valuesPerRow);
+		array.reserve(rowCount);
+		const auto rowsPerSecond = [&](double seconds) {
+			return double(rowCount) * repetitions / seconds;
+		};
+
+		const auto appendSeconds = measureSeconds([&] {
+			for (i64 i = 0; i < repetitions; i++) {
+				array.clear();
+				for (i64 row = 0; row < rowCount; row++) {
+					array.append(std::span(&rows[row * valuesPerRow], valuesPerRow));
+				}
+			}
+		});
+		const auto appendRowsSeconds = measureSeconds([&] {
+			for (i64 i = 0; i < repetitions; i++) {
+				array.clear();
+				array.appendRows(rows);
+			}
+		});
+
+		const auto readScalarSeconds = measureSeconds([&] {
+			for (i64 i = 0; i < repetitions; i++) {
+				for (i64 row = 0; row < rowCount; row++) {
+					for (i64 j = 0; j < valuesPerRow; j++) {
+						rows[row * valuesPerRow + j] = array(row, j);
+					}
+				}
+			}
+		});
+		const auto readRowsSeconds = measureSeconds([&] {
+			for (i64 i = 0; i < repetitions; i++) {
+				array.readRows(rows);
+			}
+		});
+
+		put("% values per row", valuesPerRow);
+		put("  append: % rows/s", rowsPerSecond(appendSeconds));
+		put("  appendRows: % rows/s, speedup %", rowsPerSecond(appendRowsSeconds), appendSeconds / appendRowsSeconds);
+		put("  scalar read: % rows/s", rowsPerSecond(readScalarSeconds));
+		put("  readRows: % rows/s, speedup %", rowsPerSecond(readRowsSeconds), readScalarSeconds / readRowsSeconds);
+	}
+}
@@ -2,6 +2,7 @@
 #include "floatingPoint.hpp"
 #include "utils/put.hpp"
 #include <limits>
+#include <cmath>
 #include <vector>
 #include <span>
 
@@ -62,7 +63,7 @@ void compare(Function1 f1, Function2 f2, i32 argumentCount, bool bitwiseEquality
 			const float x1 = f1(arguments);
 			const float x2 = f2(arguments);
 
-			const auto normalEquality = (x1 == x2) || (isnan(x1) && isnan(x2));
+			const auto normalEquality = (x1 == x2) || (std::isnan(x1) && std::isnan(x2));
 			const auto bitwiseEquality = f32BitwiseEquals(x1, x2) || bitwiseEqualityDisabled;
 
 			if (!normalEquality) {
@@ -20,6 +20,7 @@
 #include "utils/stringStream.hpp"
 #include "utils/pritningUtils.hpp"
 #include "utils/fileIo.hpp"
+#include <cmath>
 
 struct FuzzTester {
 	FuzzTester();
@@ -49,7 +50,7 @@ struct FuzzTester {
 		std::span<const float> arguments;
 	};
 	FunctionInfo functions[1]{
-		{ .name = "exp", .arity = 1, .address = expSimd }
+		{ .name = "exp", .arity = 1, .address = reinterpret_cast<void*>(expSimd) }
 	};
 
 	RunResult runValidInput(const ValidInput& in); 
@@ -175,7 +176,8 @@ FuzzTester::RunResult FuzzTester::runValidInput(const ValidInput& in) {
 
 	auto irCode = &*optIrCode;
 
-	auto optmizedIrCode = valueNumbering.run(*irCode, in.parameters);
+	std::vector<IrOp> optmizedIrCode;
+	valueNumbering.run(*irCode, in.parameters, optmizedIrCode);
 	irCode = &optmizedIrCode;
 	const auto copy = optmizedIrCode;
 	deadCodeElimination.run(copy, in.parameters, optmizedIrCode);
@@ -187,7 +189,7 @@ FuzzTester::RunResult FuzzTester::runValidInput(const ValidInput& in) {
 	const float expected = evaluateAstOutput.ok();
 	const float found = machineCodeOutput;
 
-	if (f32BitwiseEquals(expected, found) || (isnan(expected) && isnan(found))) {
+	if (f32BitwiseEquals(expected, found) || (std::isnan(expected) && std::isnan(found))) {
 		return RunResult::SUCCESS;
 	}
 
@@ -6,6 +6,8 @@
 #include <span>
 #include <random>
 
+using Calc::StringStream;
+
 struct RandomInputGenerator {
 	RandomInputGenerator();
 
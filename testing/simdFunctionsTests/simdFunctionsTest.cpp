@@ -6,11 +6,11 @@
 #include <iomanip>
 
 float expTest(float x) {
-	return expSimd(_mm256_set1_ps(x)).m256_f32[0];
+	return _mm256_cvtss_f32(expSimd(_mm256_set1_ps(x)));
 }
 
 float lnTest(float x) {
-	return lnSimd(_mm256_set1_ps(x)).m256_f32[0];
+	return _mm256_cvtss_f32(lnSimd(_mm256_set1_ps(x)));
 }
 
 template<typename T>
@@ -25,7 +25,7 @@ long double f32UlpError(float approximation, long double correct) {
 }
 
 std::optional<i32> f32NumbersBetween(float a, float b) {
-	if (!isfinite(a) || !isfinite(b)) {
+	if (!std::isfinite(a) || !std::isfinite(b)) {
 		return std::nullopt;
 	}
 
@@ -77,7 +77,7 @@ void testFunction(
 			continue;
 		}
 
-		const long double absoluteError = std::fabsl(correct - approximation);
+		const long double absoluteError = fabsl(correct - approximation);
 		if (absoluteError > maxAbsoluteError) {
 			maxAbsoluteError = absoluteError;
 			maxAbsoluteErrorInput = x;
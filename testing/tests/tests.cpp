@@ -7,17 +7,43 @@
 #include "codeGenerator.hpp"
 #include "evaluateAst.hpp"
 #include "executeFunction.hpp"
+#include "streamingEvaluator.hpp"
+#include "asyncCompiler.hpp"
+#include "batchCompiler.hpp"
+#include "diskKernelCache.hpp"
+#include "elfObjectExport.hpp"
+#include "elfWriter.hpp"
+#include "cppCodeGenerator.hpp"
+#include "compilationContext.hpp"
+#include "utils/rounding.hpp"
 #include "valueNumbering.hpp"
 #include "deadCodeElimination.hpp"
+#include "simdFunctions.hpp"
+#include "codeHeap.hpp"
+#include "kernelCache.hpp"
+#include "listScannerMessageReporter.hpp"
+#include "listParserMessageReporter.hpp"
+#include "listIrCompilerMessageReporter.hpp"
 #include "testingParserMessageReporter.hpp"
 #include "testingScannerMessageReporter.hpp"
 #include "testingIrCompilerMessageReporter.hpp"
 #include <sstream>
+#include <algorithm>
+#include <limits>
+#include <thread>
+#include <atomic>
 #include "utils/pritningUtils.hpp"
 #include "utils/put.hpp"
 #include "utils/setDifference.hpp"
 #include "utils/fileIo.hpp"
 #include <filesystem>
+#include <fstream>
+#include <cstring>
+#include "os/os.hpp"
+
+// Generated by aotCompiler --cpp from "sin(x) * t + y / 3" and "-x" with the variables t (uniform), x and y. See CMakeLists.txt.
+extern "C" void generatedBlocksKernel(const float* input, float* output, int64_t elementCount, const float* uniforms);
+extern "C" void generatedColumnsKernel(const float* const* columns, float* const* outputs, int64_t elementCount, const float* uniforms);
 
 std::string generateExpression(i64 depth, i64 maxDepth) {
 	if (depth == maxDepth) {
@@ -25,6 +51,15 @@ std::string generateExpression(i64 depth, i64 maxDepth) {
 	}
 	return ::format("(x_% + %)", depth, generateExpression(depth + 1, maxDepth));
 }
+
+// A runtime with its own reporters that collect the errors.
+struct TestRuntime {
+	ListScannerMessageReporter scannerReporter;
+	ListParserMessageReporter parserReporter;
+	ListIrCompilerMessageReporter irCompilerReporter;
+	Runtime runtime{ scannerReporter, parserReporter, irCompilerReporter };
+};
+
 struct TestRunner {
 	TestRunner();
 
@@ -142,12 +177,1168 @@ void runTests() {
 		t.expected("a lot of variables", source.str(), 128.0f, parameters, arguments);
 	}
 
+	{
+		const std::vector<FunctionInfo> functions{
+			{ .name = "sqrt", .arity = 1, .address = reinterpret_cast<void*>(sqrtSimd) },
+		};
+		// The values of x and y have to survive the call.
+		t.expected("function call", "sqrt(x) + y", 6.0f, { { "x" }, { "y" } }, { { 16.0f, 2.0f } }, functions);
+		t.expected("nested function calls", "sqrt(sqrt(x)) * y", 4.0f, { { "x" }, { "y" } }, { { 16.0f, 2.0f } }, functions);
+	}
+
 	// Value numbering
 	t.expected("duplicate expression", "(a + b) + (a + b)", 6.0f, { { "a" }, { "b" } }, { { 1.0f }, { 2.0f } });
 	t.expected("multiplication by 1", "x * 1", 5.0f, { { "x" } }, { { 5.0f } });
 	t.expected("multiplication by 2", "x * 2", 10.0f, { { "x" } }, { { 5.0f } });
 	t.expected("division by 1", "x / 1", 5.0f, { { "x" } }, { { 5.0f } });
 
+	{
+		CodeHeap heap;
+		const auto a = heap.allocate(100).memory;
+		const auto b = heap.allocate(100);
+		heap.free(a);
+		const auto c = heap.allocate(90);
+		const auto stats = heap.stats();
+		// Both views of the block are the same memory.
+		c.writable[0] = 0xC3;
+		if (a == c.memory && a != b.memory && c.memory[0] == 0xC3 && stats.regionCount == 1 && stats.liveAllocationCount == 2) {
+			t.printPassed("code heap reuses freed blocks");
+		} else {
+			t.printFailed("code heap reuses freed blocks");
+		}
+	}
+
+	{
+		ListScannerMessageReporter scannerReporter;
+		ListParserMessageReporter parserReporter;
+		ListIrCompilerMessageReporter irCompilerReporter;
+		Runtime runtime(scannerReporter, parserReporter, irCompilerReporter);
+		KernelCache cache(runtime);
+		const Variable xy[] = { { "x" }, { "y" } };
+		const Variable ab[] = { { "a" }, { "b" } };
+		const auto first = cache.compileFunction("x*y + 2", xy);
+		const auto second = cache.compileFunction("a * b+2", ab);
+		const auto third = cache.compileFunction("a * b + 3", ab);
+		if (first.has_value() && second.has_value() && third.has_value()
+			&& *first == *second && *first != *third
+			&& cache.stats.hits == 1 && cache.stats.misses == 2) {
+			t.printPassed("kernel cache normalizes source");
+		} else {
+			t.printFailed("kernel cache normalizes source");
+		}
+	}
+
+	{
+		TestRuntime testRuntime;
+		auto& runtime = testRuntime.runtime;
+		const Variable variables[] = { { "x" } };
+		const auto function = runtime.compileFunction("x * x + 1", variables);
+		LoopFunctionArray input(1);
+		for (i64 i = 0; i < 100000; i++) {
+			const float block[] = { float(i) };
+			input.append(block);
+		}
+		LoopFunctionArray output(1);
+		output.resizeWithoutCopy(input.blockCount());
+		ThreadPool pool(3);
+		(*function)(input, output, pool);
+		bool correct = true;
+		for (i64 i = 0; i < input.blockCount(); i++) {
+			// Rounded separately like the kernel does, the compiler could contract the expression into a fused multiply add.
+			const volatile float square = float(i) * float(i);
+			correct &= output(i, 0) == square + 1.0f;
+		}
+		if (correct) {
+			t.printPassed("parallel evaluation");
+		} else {
+			t.printFailed("parallel evaluation");
+		}
+	}
+
+	{
+		TestRuntime testRuntime;
+		auto& runtime = testRuntime.runtime;
+		const Variable variables[] = { { "x" } };
+		bool correct = true;
+		// The second source calls a function so the mask has to be reloaded after the call.
+		for (const auto source : { "x * x + 1", "sqrt(x * x) * x + 1" }) {
+			const auto function = runtime.compileFunction(source, variables);
+			// The arrays are offset by one float so they aren't aligned and the tail doesn't fill a whole register.
+			const i64 elementCount = 19;
+			std::vector<float> input(elementCount + 1);
+			std::vector<float> output(elementCount + 2, -1.0f);
+			for (i64 i = 0; i < elementCount; i++) {
+				input[i + 1] = float(i);
+			}
+			(*function)(input.data() + 1, output.data() + 1, elementCount);
+			for (i64 i = 0; i < elementCount; i++) {
+				correct &= output[i + 1] == float(i) * float(i) + 1.0f;
+			}
+			correct &= output[0] == -1.0f && output[elementCount + 1] == -1.0f;
+		}
+		if (correct) {
+			t.printPassed("masked tail");
+		} else {
+			t.printFailed("masked tail");
+		}
+	}
+
+	{
+		TestRuntime testRuntime;
+		auto& runtime = testRuntime.runtime;
+		const Variable variables[] = { { "x" }, { "y" } };
+		bool correct = true;
+		for (const auto source : { "x * 2 - y", "sqrt(x * x) * 2 - y" }) {
+			const auto function = runtime.compileFunction(source, variables, InputLayout::COLUMNS);
+			const i64 elementCount = 21;
+			std::vector<float> x(elementCount);
+			std::vector<float> y(elementCount);
+			for (i64 i = 0; i < elementCount; i++) {
+				x[i] = float(i);
+				y[i] = float(i * 3);
+			}
+			const float* columns[] = { x.data(), y.data() };
+			std::vector<float> output(elementCount);
+			float* const outputs[] = { output.data() };
+			(*function)(columns, outputs, elementCount);
+			for (i64 i = 0; i < elementCount; i++) {
+				correct &= output[i] == -float(i);
+			}
+		}
+		if (correct) {
+			t.printPassed("column input layout");
+		} else {
+			t.printFailed("column input layout");
+		}
+	}
+
+	{
+		TestRuntime testRuntime;
+		auto& runtime = testRuntime.runtime;
+		const Variable variables[] = { { "x" }, { "t", true }, { "y" }, { "s", true } };
+		const auto function = runtime.compileFunction("x * t + y + sqrt(s)", variables);
+		LoopFunctionArray input(2);
+		for (i64 i = 0; i < 11; i++) {
+			const float block[] = { float(i), float(i * 2) };
+			input.append(block);
+		}
+		LoopFunctionArray output(1);
+		output.resizeWithoutCopy(input.blockCount());
+		const float uniforms[] = { 3.0f, 9.0f };
+		(*function)(input, output, uniforms);
+		bool correct = true;
+		for (i64 i = 0; i < input.blockCount(); i++) {
+			correct &= output(i, 0) == float(i) * 3.0f + float(i * 2) + 3.0f;
+		}
+		if (correct) {
+			t.printPassed("uniform variables");
+		} else {
+			t.printFailed("uniform variables");
+		}
+	}
+
+	{
+		TestRuntime testRuntime;
+		auto& runtime = testRuntime.runtime;
+		const Variable variables[] = { { "x" }, { "y" } };
+		const std::string_view sources[] = { "sqrt(x * x + y * y)", "x * x + y * y", "x - y" };
+		bool correct = true;
+		{
+			// The common subexpression should be computed only once.
+			const auto ir = runtime.compileToIr(sources, variables);
+			const auto multiplyCount = std::count_if(ir->begin(), ir->end(), [](const IrOp& op) { return std::holds_alternative<MultiplyOp>(op); });
+			correct &= multiplyCount == 2;
+		}
+		const auto function = runtime.compileFunction(sources, variables);
+		LoopFunctionArray input(2);
+		for (i64 i = 0; i < 13; i++) {
+			const float block[] = { float(i * 3), float(i * 4) };
+			input.append(block);
+		}
+		LoopFunctionArray output(3);
+		output.resizeWithoutCopy(input.blockCount());
+		(*function)(input, output);
+		for (i64 i = 0; i < input.blockCount(); i++) {
+			correct &= output(i, 0) == float(i * 5);
+			correct &= output(i, 1) == float(i * i * 25);
+			correct &= output(i, 2) == -float(i);
+		}
+		if (correct) {
+			t.printPassed("multiple outputs");
+		} else {
+			t.printFailed("multiple outputs");
+		}
+	}
+
+	{
+		TestRuntime testRuntime;
+		auto& runtime = testRuntime.runtime;
+		const Variable variables[] = { { "t", true }, { "x" }, { "y" } };
+		const auto function = runtime.compileFunction("x * 10 + y + sqrt(t)", variables, InputLayout::GRID);
+		const Grid grid{
+			.dimensionCount = 2,
+			.origin = { 1.0f, 2.0f },
+			.step = { 0.5f, 1.0f },
+			.size = { 11, 3 },
+		};
+		std::vector<float> image(grid.elementCount());
+		float* const outputs[] = { image.data() };
+		const float uniforms[] = { 4.0f };
+		(*function)(grid, outputs, uniforms);
+		bool correct = true;
+		for (i64 y = 0; y < grid.size[1]; y++) {
+			for (i64 x = 0; x < grid.size[0]; x++) {
+				const auto expected = (1.0f + float(x) * 0.5f) * 10.0f + (2.0f + float(y)) + 2.0f;
+				correct &= image[y * grid.size[0] + x] == expected;
+			}
+		}
+
+		// The rows are shorter than a vector so the lanes wrap into the next rows and layers.
+		const Variable variables3d[] = { { "x" }, { "y" }, { "z" } };
+		const auto function3d = runtime.compileFunction("x * 100 + y * 10 + z", variables3d, InputLayout::GRID);
+		const Grid grid3d{
+			.dimensionCount = 3,
+			.origin = { 0.0f, 1.0f, 2.0f },
+			.step = { 1.0f, 1.0f, 1.0f },
+			.size = { 3, 2, 5 },
+		};
+		std::vector<float> volume(grid3d.elementCount());
+		float* const volumeOutputs[] = { volume.data() };
+		(*function3d)(grid3d, volumeOutputs, {});
+		for (i64 z = 0; z < grid3d.size[2]; z++) {
+			for (i64 y = 0; y < grid3d.size[1]; y++) {
+				for (i64 x = 0; x < grid3d.size[0]; x++) {
+					const auto expected = float(x) * 100.0f + float(y + 1) * 10.0f + float(z + 2);
+					correct &= volume[(z * grid3d.size[1] + y) * grid3d.size[0] + x] == expected;
+				}
+			}
+		}
+		if (correct) {
+			t.printPassed("grid evaluation");
+		} else {
+			t.printFailed("grid evaluation");
+		}
+	}
+
+	{
+		TestRuntime testRuntime;
+		auto& runtime = testRuntime.runtime;
+		const Variable variables[] = { { "x" } };
+		// Enough elements for multiple parallel chunks. The values are small integers so the sums are exact in any order.
+		const i64 elementCount = 200003;
+		LoopFunctionArray input(1);
+		std::vector<float> x(elementCount);
+		for (i64 i = 0; i < elementCount; i++) {
+			x[i] = float((i * 7 + 5) % 23);
+			input.append(std::span(&x[i], 1));
+		}
+		ThreadPool pool(4);
+
+		bool correct = true;
+		for (const auto source : { "x - 11", "sqrt(x * x) - 11" }) {
+			for (const auto count : { i64(5), i64(1003), elementCount }) {
+				float sum = 0.0f;
+				float min = std::numeric_limits<float>::infinity();
+				float max = -std::numeric_limits<float>::infinity();
+				i64 argmin = -1;
+				i64 argmax = -1;
+				for (i64 i = 0; i < count; i++) {
+					const auto value = x[i] - 11.0f;
+					sum += value;
+					if (value < min) {
+						min = value;
+						argmin = i;
+					}
+					if (value > max) {
+						max = value;
+						argmax = i;
+					}
+				}
+
+				auto check = [&](Reduction reduction, float expectedValue, i64 expectedIndex) {
+					const auto function = runtime.compileFunction(source, variables, InputLayout::BLOCKS, reduction);
+					const auto result = function->reduce(x.data(), count);
+					correct &= result.value == expectedValue && result.index == expectedIndex;
+					if (count == elementCount) {
+						const auto parallelResult = function->reduce(input, pool);
+						correct &= parallelResult.value == expectedValue && parallelResult.index == expectedIndex;
+					}
+				};
+				check(Reduction::SUM, sum, -1);
+				check(Reduction::MEAN, sum / float(count), -1);
+				check(Reduction::MIN, min, -1);
+				check(Reduction::MAX, max, -1);
+				check(Reduction::ARGMIN, min, argmin);
+				check(Reduction::ARGMAX, max, argmax);
+			}
+		}
+		if (correct) {
+			t.printPassed("reductions");
+		} else {
+			t.printFailed("reductions");
+		}
+	}
+
+	{
+		TestRuntime testRuntime;
+		auto& runtime = testRuntime.runtime;
+		const Variable variables[] = { { "x" }, { "t", true }, { "y" } };
+		const std::string_view sources[] = { "x * t + y", "x - y" };
+		const auto function = runtime.compileFunction(sources, variables);
+		StreamingEvaluator evaluator(*function, 1000);
+
+		const i64 rowCount = 10007;
+		i64 nextRow = 0;
+		auto source = [&](std::span<float> rows, i64 maxRowCount) {
+			// Return partially filled chunks too.
+			const auto count = std::min({ maxRowCount, rowCount - nextRow, i64(777) });
+			for (i64 i = 0; i < count; i++) {
+				rows[i * 2] = float(nextRow + i);
+				rows[i * 2 + 1] = 1.0f;
+			}
+			nextRow += count;
+			return count;
+		};
+		i64 receivedRowCount = 0;
+		bool correct = true;
+		auto sink = [&](std::span<const float> outputRows, i64 count) {
+			for (i64 i = 0; i < count; i++) {
+				const auto x = float(receivedRowCount + i);
+				correct &= outputRows[i * 2] == x * 2.0f + 1.0f;
+				correct &= outputRows[i * 2 + 1] == x - 1.0f;
+			}
+			receivedRowCount += count;
+		};
+		const float uniforms[] = { 2.0f };
+		correct &= evaluator.run(source, sink, uniforms) == rowCount;
+		correct &= receivedRowCount == rowCount;
+		if (correct) {
+			t.printPassed("streaming evaluation");
+		} else {
+			t.printFailed("streaming evaluation");
+		}
+	}
+
+	{
+		bool correct = true;
+		const i64 rowCount = 37;
+		std::vector<float> rows;
+		std::vector<float> columns[3];
+		for (i64 i = 0; i < rowCount; i++) {
+			for (i64 j = 0; j < 3; j++) {
+				rows.push_back(float(i * 3 + j));
+				columns[j].push_back(float(i * 3 + j));
+			}
+		}
+		const float* columnPointers[] = { columns[0].data(), columns[1].data(), columns[2].data() };
+
+		LoopFunctionArrayPool pool;
+		auto fromRows = pool.acquire(3, 0);
+		LoopFunctionArray fromColumns(3);
+		// Start from a partially filled data unit.
+		fromRows.append(std::span(rows).subspan(0, 3));
+		fromRows.appendRows(std::span(rows).subspan(3));
+		fromColumns.appendColumns(columnPointers, 5);
+		const float* remainingColumnPointers[] = { columns[0].data() + 5, columns[1].data() + 5, columns[2].data() + 5 };
+		fromColumns.appendColumns(remainingColumnPointers, rowCount - 5);
+
+		correct &= fromRows.blockCount() == rowCount && fromColumns.blockCount() == rowCount;
+		correct &= reinterpret_cast<uintptr_t>(fromRows.data()) % LoopFunctionArray::CACHE_LINE_SIZE == 0;
+		for (i64 i = 0; i < rowCount; i++) {
+			for (i64 j = 0; j < 3; j++) {
+				correct &= fromRows(i, j) == float(i * 3 + j);
+				correct &= fromColumns(i, j) == float(i * 3 + j);
+			}
+		}
+
+		// The memory of a released array is reused.
+		const auto data = fromRows.data();
+		pool.release(std::move(fromRows));
+		const auto reused = pool.acquire(2, 40);
+		correct &= reused.data() == data && reused.blockCount() == 40 && reused.valuesPerBlock() == 2;
+
+		if (correct) {
+			t.printPassed("loop function array");
+		} else {
+			t.printFailed("loop function array");
+		}
+	}
+
+	{
+		bool correct = true;
+		static constexpr i64 MAX_VALUES_PER_ROW = 17;
+		for (i64 valuesPerRow = 1; valuesPerRow <= MAX_VALUES_PER_ROW; valuesPerRow++) {
+			std::vector<float> rows(8 * valuesPerRow);
+			for (i64 i = 0; i < i64(rows.size()); i++) {
+				rows[i] = float(i);
+			}
+			// One more block than needed to check that nothing is written after the end.
+			alignas(__m256) float blockValues[8 * (MAX_VALUES_PER_ROW + 1)];
+			std::fill(std::begin(blockValues), std::end(blockValues), -1.0f);
+			const auto blocks = reinterpret_cast<__m256*>(blockValues);
+			transposeRowsToBlocks(rows.data(), valuesPerRow, blocks);
+			for (i64 i = 0; i < valuesPerRow; i++) {
+				for (i64 row = 0; row < 8; row++) {
+					correct &= blockValues[i * 8 + row] == rows[row * valuesPerRow + i];
+				}
+			}
+			correct &= blockValues[valuesPerRow * 8] == -1.0f;
+
+			std::vector<float> result(rows.size() + 1, -1.0f);
+			transposeBlocksToRows(blocks, valuesPerRow, result.data());
+			correct &= std::equal(rows.begin(), rows.end(), result.begin()) && result.back() == -1.0f;
+		}
+		if (correct) {
+			t.printPassed("block transpose");
+		} else {
+			t.printFailed("block transpose");
+		}
+	}
+
+	{
+		TestRuntime testRuntime;
+		auto& runtime = testRuntime.runtime;
+		const Variable variables[] = { { "x" }, { "y" } };
+		const auto function = runtime.compileFunction("x * y - 1", variables);
+		const auto inputPath = (std::filesystem::temp_directory_path() / "mathCompilerTestInput.bin").string();
+		const auto outputPath = (std::filesystem::temp_directory_path() / "mathCompilerTestOutput.bin").string();
+		const i64 blockCount = 1001;
+
+		bool correct = true;
+		{
+			auto input = LoopFunctionArray::createMapped(inputPath.c_str(), 2, blockCount);
+			correct &= input.has_value();
+			if (input.has_value()) {
+				input->clear();
+				for (i64 i = 0; i < blockCount; i++) {
+					const float block[] = { float(i), 2.0f };
+					input->append(block);
+				}
+			}
+		}
+		{
+			const auto input = LoopFunctionArray::openMapped(inputPath.c_str());
+			auto output = LoopFunctionArray::createMapped(outputPath.c_str(), 1, blockCount);
+			correct &= input.has_value() && output.has_value();
+			if (input.has_value() && output.has_value()) {
+				correct &= input->blockCount() == blockCount && input->valuesPerBlock() == 2;
+				(*function)(*input, *output);
+				correct &= output->flush();
+			}
+		}
+		{
+			const auto output = LoopFunctionArray::openMapped(outputPath.c_str());
+			correct &= output.has_value();
+			if (output.has_value()) {
+				correct &= output->blockCount() == blockCount;
+				for (i64 i = 0; i < blockCount; i++) {
+					correct &= (*output)(i, 0) == float(i * 2 - 1);
+				}
+			}
+		}
+		correct &= !LoopFunctionArray::openMapped((inputPath + "nonexistent").c_str()).has_value();
+		// Headers with counts that overflow or don't fit into the file.
+		const auto writeHeader = [&](i64 valuesPerBlock, i64 headerBlockCount, i64 dataBytes) {
+			std::vector<u8> file(LoopFunctionArray::MAPPED_FILE_HEADER_SIZE + dataBytes);
+			const LoopFunctionArray::MappedFileHeader header{
+				.magic = LoopFunctionArray::MAPPED_FILE_MAGIC,
+				.valuesPerBlock = valuesPerBlock,
+				.blockCount = headerBlockCount,
+			};
+			memcpy(file.data(), &header, sizeof(header));
+			return outputToFile(inputPath.c_str(), file);
+		};
+		correct &= writeHeader(i64(1) << 40, i64(1) << 40, 32) && !LoopFunctionArray::openMapped(inputPath.c_str()).has_value();
+		correct &= writeHeader(2, 16, 2 * 32) && !LoopFunctionArray::openMapped(inputPath.c_str()).has_value();
+		correct &= writeHeader(2, 16, 4 * 32) && LoopFunctionArray::openMapped(inputPath.c_str()).has_value();
+		std::filesystem::remove(inputPath);
+		std::filesystem::remove(outputPath);
+		if (correct) {
+			t.printPassed("mapped loop function array");
+		} else {
+			t.printFailed("mapped loop function array");
+		}
+	}
+
+	{
+		TestRuntime testRuntime;
+		auto& runtime = testRuntime.runtime;
+		AsyncCompiler compiler(runtime);
+		const Variable variables[] = { { "x" }, { "t", true }, { "y" } };
+		const i64 elementCount = 21;
+		std::vector<float> input(roundUpToMultiple(elementCount, 8) * 2);
+		for (i64 i = 0; i < elementCount; i++) {
+			input[i / 8 * 16 + i % 8] = float(i);
+			input[i / 8 * 16 + 8 + i % 8] = float(i * 2);
+		}
+		const float uniforms[] = { 3.0f };
+		auto check = [&](const std::vector<float>& output) {
+			bool correct = true;
+			for (i64 i = 0; i < elementCount; i++) {
+				correct &= output[i / 8 * 8 + i % 8] == float(i) * 2.0f + float(i * 2) * 3.0f;
+			}
+			return correct;
+		};
+
+		bool correct = !compiler.compileFunction("x +", variables).has_value();
+		const auto function = compiler.compileFunction("sqrt(x * x) * 2 + y * t", variables);
+		correct &= function.has_value();
+		if (function.has_value()) {
+			// The result doesn't depend on whether the machine code is ready.
+			std::vector<float> output(roundUpToMultiple(elementCount, 8));
+			(**function)(input.data(), output.data(), elementCount, uniforms);
+			correct &= check(output);
+
+			std::vector<float> interpreted(output.size());
+			VectorIrVm vm;
+			vm.execute((*function)->irCode, variables, runtime.functions, input.data(), interpreted.data(), elementCount, uniforms);
+			correct &= check(interpreted);
+
+			correct &= (*function)->wait();
+			correct &= (*function)->isCompiled();
+			std::vector<float> compiled(output.size());
+			(**function)(input.data(), compiled.data(), elementCount, uniforms);
+			correct &= check(compiled);
+		}
+		// Functions destroyed before their code is generated are skipped.
+		for (i64 i = 0; i < 10; i++) {
+			correct &= compiler.compileFunction("x * y + t", variables).has_value();
+		}
+
+		// Destroying the compiler wakes up the waiters of the functions that weren't generated yet and they stay usable.
+		std::vector<std::shared_ptr<AsyncFunction>> pending;
+		{
+			AsyncCompiler shortLivedCompiler(runtime);
+			for (i64 i = 0; i < 20; i++) {
+				const auto pendingFunction = shortLivedCompiler.compileFunction("sqrt(x * x) * 2 + y * t", variables);
+				correct &= pendingFunction.has_value();
+				if (pendingFunction.has_value()) {
+					pending.push_back(*pendingFunction);
+				}
+			}
+		}
+		for (const auto& pendingFunction : pending) {
+			correct &= pendingFunction->wait() == pendingFunction->isCompiled();
+			std::vector<float> output(roundUpToMultiple(elementCount, 8));
+			(*pendingFunction)(input.data(), output.data(), elementCount, uniforms);
+			correct &= check(output);
+		}
+		if (correct) {
+			t.printPassed("async compilation");
+		} else {
+			t.printFailed("async compilation");
+		}
+	}
+
+	{
+		TestRuntime testRuntime;
+		auto& runtime = testRuntime.runtime;
+		ThreadPool pool(4);
+		BatchCompiler compiler(runtime, pool);
+		const Variable variables[] = { { "x" } };
+
+		const i64 sourceCount = 203;
+		std::vector<std::string> sourceStrings;
+		for (i64 i = 0; i < sourceCount; i++) {
+			if (i % 50 == 7) {
+				sourceStrings.push_back("x + y");
+			} else if (i % 50 == 8) {
+				sourceStrings.push_back("(x + 1");
+			} else {
+				sourceStrings.push_back("sqrt(x * x) * " + std::to_string(i) + " + 1");
+			}
+		}
+		const std::vector<std::string_view> sources(sourceStrings.begin(), sourceStrings.end());
+		auto& histograms = compilationStatsHistograms();
+		histograms.reset();
+		compiler.collectStats = true;
+		const auto results = compiler.compile(sources, variables);
+
+		bool correct = i64(results.size()) == sourceCount && compiler.stats.failedCount == 8;
+		const auto placedCount = sourceCount - 8;
+		correct &= histograms.totalNanoseconds.count() == placedCount;
+		correct &= histograms.phaseNanoseconds[i64(CompilationStats::Phase::PLACEMENT)].count() == placedCount;
+		const float input[] = { 1.0f, 2.0f, 3.0f };
+		float output[3];
+		for (i64 i = 0; i < i64(results.size()); i++) {
+			const auto& result = results[i];
+			if (i % 50 == 7) {
+				correct &= !result.function.has_value() && result.scannerErrors.size() == 1;
+			} else if (i % 50 == 8) {
+				correct &= !result.function.has_value() && result.parserErrors.size() == 1;
+			} else {
+				correct &= result.function.has_value();
+				if (result.function.has_value()) {
+					(*result.function)(input, output, 3);
+					correct &= output[0] == float(i + 1) && output[2] == float(i * 3 + 1);
+				}
+			}
+		}
+		correct &= compiler.stats.codeBytes > 0 && compiler.stats.functionsPerSecond() > 0.0;
+		if (correct) {
+			t.printPassed("batch compilation");
+		} else {
+			t.printFailed("batch compilation");
+		}
+	}
+
+	{
+		TestRuntime testRuntime;
+		auto& runtime = testRuntime.runtime;
+		CompilationContextPool contexts;
+		const Variable variables[] = { { "x" }, { "y" } };
+
+		// A single element in the block layout.
+		float input[16] = {};
+		input[0] = 2.0f;
+		input[8] = 3.0f;
+		const auto evaluatesTo = [&input](const std::optional<Runtime::LoopFunction>& function, float expected) {
+			float output;
+			if (!function.has_value()) {
+				return false;
+			}
+			(*function)(input, &output, 1);
+			return output == expected;
+		};
+
+		// The kernels compiled before and by the threads are called while the other threads are compiling.
+		const auto previousFunction = runtime.compileFunction("x - y", variables);
+		std::atomic<bool> compiling = true;
+		std::atomic<bool> previousCorrect = true;
+		std::thread caller([&] {
+			while (compiling.load()) {
+				if (!evaluatesTo(previousFunction, -1.0f)) {
+					previousCorrect = false;
+				}
+			}
+		});
+
+		const i64 threadCount = 4;
+		const i64 functionsPerThread = 25;
+		std::vector<std::vector<std::optional<Runtime::LoopFunction>>> functions(threadCount);
+		std::vector<i64> errorCounts(threadCount, 0);
+		std::vector<char> threadCorrect(threadCount, true);
+		std::vector<std::thread> threads;
+		for (i64 thread = 0; thread < threadCount; thread++) {
+			threads.emplace_back([&, thread] {
+				auto context = contexts.acquire();
+				for (i64 i = 0; i < functionsPerThread; i++) {
+					const auto source = "x * " + std::to_string(thread) + " + y * " + std::to_string(i);
+					const std::string_view sources[] = { source, "x +" };
+					functions[thread].push_back(runtime.compileFunction(*context, std::span(sources, 1), variables));
+					threadCorrect[thread] &= evaluatesTo(functions[thread].back(), float(2 * thread + 3 * i));
+					// Errors are only reported to the context of the thread.
+					runtime.compileFunction(*context, sources, variables);
+					errorCounts[thread] += i64(context->parserReporter.errors.size());
+				}
+			});
+		}
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		compiling = false;
+		caller.join();
+
+		bool correct = testRuntime.scannerReporter.errors.empty() && testRuntime.parserReporter.errors.empty() && testRuntime.irCompilerReporter.errors.empty();
+		correct &= previousCorrect;
+		for (i64 thread = 0; thread < threadCount; thread++) {
+			correct &= errorCounts[thread] == functionsPerThread && threadCorrect[thread];
+			for (i64 i = 0; i < functionsPerThread; i++) {
+				correct &= evaluatesTo(functions[thread][i], float(2 * thread + 3 * i));
+			}
+		}
+		if (correct) {
+			t.printPassed("thread-safe compilation");
+		} else {
+			t.printFailed("thread-safe compilation");
+		}
+	}
+
+	{
+		TestRuntime testRuntime;
+		auto& runtime = testRuntime.runtime;
+		runtime.context.collectStats = true;
+		auto& histograms = compilationStatsHistograms();
+		histograms.reset();
+		const Variable variables[] = { { "x" } };
+
+		// The left operands stay live until the innermost expression is evaluated so some of them have to be spilled.
+		std::string source = "x";
+		for (i64 i = 1; i <= 24; i++) {
+			source = "x * " + std::to_string(i) + " + (" + source + ")";
+		}
+		const auto function = runtime.compileFunction(source, variables);
+		const auto& stats = runtime.context.stats;
+
+		bool correct = function.has_value();
+		for (i64 i = 0; i < CompilationStats::PHASE_COUNT; i++) {
+			correct &= stats.phaseNanoseconds[i] > 0;
+		}
+		correct &= stats.irOpCountAfterIrGeneration >= stats.irOpCountAfterValueNumbering;
+		correct &= stats.irOpCountAfterValueNumbering >= stats.irOpCountAfterDeadCodeElimination;
+		correct &= stats.irOpCountAfterDeadCodeElimination > 0;
+		correct &= stats.spillCount > 0 && stats.spillBytes == stats.spillCount * 32;
+		correct &= stats.codeBytes > 0 && stats.dataBytes > 0 && stats.astArenaBytes > 0;
+
+		runtime.compileFunction("x + 1", variables);
+		correct &= runtime.context.stats.spillCount == 0;
+		// Failed compilations aren't recorded.
+		runtime.compileFunction("x +", variables);
+		correct &= histograms.totalNanoseconds.count() == 2;
+		correct &= histograms.totalNanoseconds.sum() >= stats.totalNanoseconds();
+		correct &= histograms.spillCount.percentile(1.0) >= stats.spillCount;
+		correct &= histograms.spillCount.percentile(0.5) == 0;
+
+		runtime.context.collectStats = false;
+		runtime.compileFunction("x + 2", variables);
+		correct &= histograms.totalNanoseconds.count() == 2 && runtime.context.stats.phaseNanoseconds[0] == 0;
+		if (correct) {
+			t.printPassed("compilation stats");
+		} else {
+			t.printFailed("compilation stats");
+		}
+	}
+
+	{
+		TestRuntime testRuntime;
+		auto& runtime = testRuntime.runtime;
+		const Variable variables[] = { { "x" } };
+		auto function = runtime.compileFunction("sqrt(x) * 2", variables);
+
+		bool correct = function.has_value();
+		if (function.has_value()) {
+			const i64 elementCount = 1000;
+			std::vector<float> input(elementCount, 4.0f);
+			std::vector<float> output(elementCount);
+			(*function)(input.data(), output.data(), elementCount);
+			correct &= !function->profileReport().has_value();
+
+			function->enableProfiling();
+			(*function)(input.data(), output.data(), elementCount);
+			(*function)(input.data(), output.data(), elementCount);
+			const auto report = function->profileReport();
+			correct &= report.has_value() && output[elementCount - 1] == 4.0f;
+			if (report.has_value()) {
+				correct &= report->callCount == 2 && report->elementCount == 2 * elementCount;
+				correct &= report->byteCount == 2 * elementCount * 8;
+				// The counters are often unavailable in containers.
+				if (report->countersAvailable) {
+					correct &= report->events[i64(HardwareEvent::CYCLES)] > 0 && report->cyclesPerElement() > 0.0 && report->bytesPerCycle() > 0.0;
+				}
+			}
+			function->disableProfiling();
+			correct &= !function->profileReport().has_value();
+		}
+		if (correct) {
+			t.printPassed("kernel profiling");
+		} else {
+			t.printFailed("kernel profiling");
+		}
+	}
+
+	{
+		TestRuntime testRuntime;
+		auto& runtime = testRuntime.runtime;
+		const Variable variables[] = { { "x" } };
+
+		auto& registry = jitCodeRegistry();
+		const auto enabled = registry.enable(JitCodeRegistry::PERF_MAP | JitCodeRegistry::JITDUMP | JitCodeRegistry::GDB);
+		auto function = runtime.compileFunction("x  *   x + 1", variables);
+		registry.disable();
+		const auto unregistered = runtime.compileFunction("x", variables);
+
+		const std::string_view sources[] = { "x  *   x + 1" };
+		const auto name = JitCodeRegistry::symbolName(sources);
+		bool correct = function.has_value() && unregistered.has_value() && name.ends_with(" x * x + 1");
+		if (enabled && function.has_value() && unregistered.has_value()) {
+			correct &= function->debuggerEntry != nullptr && unregistered->debuggerEntry == nullptr;
+
+			auto readFile = [](const std::string& path) {
+				std::ifstream file(path, std::ios::binary);
+				return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+			};
+			const auto pid = std::to_string(processId());
+			const auto perfMap = readFile("/tmp/perf-" + pid + ".map");
+			std::stringstream entry;
+			entry << std::hex << reinterpret_cast<uintptr_t>(function->function) << ' ' << function->size << ' ' << name << '\n';
+			correct &= perfMap.find(entry.str()) != std::string::npos;
+
+			const auto jitdump = readFile("/tmp/jit-" + pid + ".dump");
+			// The header is followed by the record, the name and the code.
+			correct &= i64(jitdump.size()) == 40 + 56 + i64(name.size()) + 1 + function->size;
+			if (jitdump.size() >= 4) {
+				u32 magic;
+				memcpy(&magic, jitdump.data(), sizeof(magic));
+				correct &= magic == 0x4A695444;
+			}
+			std::filesystem::remove("/tmp/perf-" + pid + ".map");
+			std::filesystem::remove("/tmp/jit-" + pid + ".dump");
+		}
+		if (correct) {
+			t.printPassed("jit code registration");
+		} else {
+			t.printFailed("jit code registration");
+		}
+	}
+
+	{
+		const auto directory = std::filesystem::temp_directory_path() / ("mathCompilerKernelCacheTest" + std::to_string(processId()));
+		std::filesystem::remove_all(directory);
+		const Variable variables[] = { { "x" }, { "y" } };
+		const auto source = "sin(x) * y + exp(x) / 2";
+		float input[16] = {};
+		input[0] = 0.5f;
+		input[8] = 3.0f;
+		float expected = 0.0f;
+
+		bool correct = true;
+		{
+			TestRuntime testRuntime;
+			auto& runtime = testRuntime.runtime;
+			DiskKernelCache cache(runtime, directory);
+			const auto function = cache.compileFunction(source, variables);
+			correct &= function.has_value() && cache.stats.misses == 1 && cache.stats.writeFailures == 0;
+			if (function.has_value()) {
+				(*function)(input, &expected, 1);
+			}
+			correct &= !cache.compileFunction("x +", variables).has_value();
+		}
+		{
+			// A new runtime simulates restarting the process. The function table is in a different order so the calls have to be relocated.
+			TestRuntime testRuntime;
+			auto& runtime = testRuntime.runtime;
+			std::reverse(runtime.functions.begin(), runtime.functions.end());
+			DiskKernelCache cache(runtime, directory);
+			const auto function = cache.compileFunction("sin(x)*y   + exp(x)/2", variables);
+			correct &= function.has_value() && cache.stats.hits == 1 && cache.stats.misses == 0;
+			if (function.has_value()) {
+				float output;
+				(*function)(input, &output, 1);
+				correct &= output == expected && std::abs(expected - (std::sin(0.5f) * 3.0f + std::exp(0.5f) / 2.0f)) < 0.001f;
+			}
+			correct &= cache.compileFunction(source, variables, InputLayout::COLUMNS).has_value() && cache.stats.misses == 1;
+
+			// Corrupted files are regenerated.
+			for (const auto& entry : std::filesystem::directory_iterator(cache.directory)) {
+				std::filesystem::resize_file(entry.path(), 100);
+			}
+			correct &= cache.compileFunction(source, variables).has_value() && cache.stats.invalidFiles == 1 && cache.stats.misses == 2;
+			correct &= cache.compileFunction(source, variables).has_value() && cache.stats.hits == 2;
+		}
+		std::filesystem::remove_all(directory);
+		if (correct) {
+			t.printPassed("disk kernel cache");
+		} else {
+			t.printFailed("disk kernel cache");
+		}
+	}
+
+	{
+		TestRuntime testRuntime;
+		auto& runtime = testRuntime.runtime;
+		const Variable variables[] = { { "x" }, { "t", true } };
+		const std::string_view sources[] = { "sin(x) * t + exp(x) / 3" };
+		const auto object = compileToElfObject(runtime, sources, variables, "kernel");
+
+		const auto irCode = runtime.compileToIr(sources, variables);
+		CodeGenerator codeGenerator(CallingConvention::SYSTEM_V);
+		const auto machineCode = codeGenerator.compile(*irCode, runtime.functions, variables);
+
+		const std::string_view invalidSources[] = { "x +" };
+		bool correct = object.has_value() && !compileToElfObject(runtime, invalidSources, variables, "kernel").has_value();
+		if (object.has_value()) {
+			const auto& bytes = *object;
+			correct &= bytes.size() > 64 && memcmp(bytes.data(), "\x7F" "ELF", 4) == 0;
+			// ET_REL, EM_X86_64
+			u16 type, machine;
+			memcpy(&type, &bytes[16], sizeof(type));
+			memcpy(&machine, &bytes[18], sizeof(machine));
+			correct &= type == 1 && machine == 62;
+
+			// Every rip relative data operand and function address needs a relocation and none of them can write to .text when loading.
+			u64 sectionHeadersOffset;
+			u16 sectionHeaderSize, sectionCount;
+			memcpy(&sectionHeadersOffset, &bytes[40], sizeof(sectionHeadersOffset));
+			memcpy(&sectionHeaderSize, &bytes[58], sizeof(sectionHeaderSize));
+			memcpy(&sectionCount, &bytes[60], sizeof(sectionCount));
+			i64 relocationCount = 0;
+			for (i64 i = 0; i < sectionCount; i++) {
+				const auto header = &bytes[sectionHeadersOffset + i * sectionHeaderSize];
+				u32 sectionType;
+				u64 offset, size;
+				memcpy(&sectionType, header + 4, sizeof(sectionType));
+				memcpy(&offset, header + 24, sizeof(offset));
+				memcpy(&size, header + 32, sizeof(size));
+				// SHT_RELA
+				if (sectionType != 4) {
+					continue;
+				}
+				for (u64 j = 0; j < size / 24; j++) {
+					u64 info;
+					memcpy(&info, &bytes[offset + j * 24 + 8], sizeof(info));
+					const auto relocationType = info & 0xFFFFFFFF;
+					correct &= relocationType == u64(ElfWriter::RelocationType::PC_RELATIVE_32) || relocationType == u64(ElfWriter::RelocationType::PLT_32);
+					relocationCount++;
+				}
+			}
+			correct &= !machineCode.functionAddressOperands.empty();
+			correct &= relocationCount == i64(machineCode.ripRelativeDataOperands.size() + machineCode.functionAddressOperands.size());
+		}
+		if (correct) {
+			t.printPassed("elf object export");
+		} else {
+			t.printFailed("elf object export");
+		}
+	}
+
+	{
+		TestRuntime testRuntime;
+		auto& runtime = testRuntime.runtime;
+		const Variable variables[] = { { "t", true }, { "x" }, { "y" } };
+		const std::string_view sources[] = { "sin(x) * t + y / 3", "-x" };
+		const auto irCode = runtime.compileToIr(sources, variables);
+
+		CppCodeGenerator codeGenerator;
+		std::stringstream blocks;
+		codeGenerator.compile(blocks, *irCode, runtime.functions, variables, "kernel");
+		std::stringstream columns;
+		codeGenerator.compile(columns, *irCode, runtime.functions, variables, "kernel", InputLayout::COLUMNS);
+
+		const auto contains = [](const std::stringstream& code, std::string_view text) {
+			return code.str().find(text) != std::string::npos;
+		};
+		bool correct = true;
+		correct &= contains(blocks, "extern \"C\" void kernel(const float* input, float* output, int64_t elementCount, const float* uniforms)");
+		correct &= contains(blocks, "const __m256 u0 = _mm256_set1_ps(uniforms[0]);");
+		correct &= contains(blocks, "_mm256_loadu_ps(input + 8)") && contains(blocks, "_mm256_maskload_ps(input + 8, mask)");
+		correct &= contains(blocks, "_mm256_storeu_ps(output + 8,") && contains(blocks, "_mm256_maskstore_ps(output + 8, mask,");
+		correct &= contains(blocks, "input += 16;") && contains(blocks, "output += 16;");
+		correct &= contains(blocks, "sinSimd(") && contains(blocks, "_mm256_set1_ps(0x1.8p+1f)") && contains(blocks, "_mm256_xor_ps(");
+		correct &= contains(columns, "_mm256_loadu_ps(columns[1] + offset)") && contains(columns, "_mm256_maskstore_ps(outputs[1] + offset, mask,");
+
+		// The compiled kernels have to give the same results as the JIT, including the masked tail.
+		const i64 elementCount = 19;
+		const i64 paddedCount = roundUpToMultiple(elementCount, 8);
+		const float uniforms[] = { 1.5f };
+		std::vector<float> x(paddedCount), y(paddedCount);
+		for (i64 i = 0; i < elementCount; i++) {
+			x[i] = float(i) * 0.37f - 2.0f;
+			y[i] = float(i * i) * 0.11f;
+		}
+		std::vector<float> blocksInput(paddedCount * 2);
+		for (i64 i = 0; i < paddedCount; i++) {
+			blocksInput[i / 8 * 16 + i % 8] = x[i];
+			blocksInput[i / 8 * 16 + 8 + i % 8] = y[i];
+		}
+		const auto jitBlocks = runtime.compileFunction(sources, variables);
+		const auto jitColumns = runtime.compileFunction(sources, variables, InputLayout::COLUMNS);
+		correct &= jitBlocks.has_value() && jitColumns.has_value();
+		if (jitBlocks.has_value() && jitColumns.has_value()) {
+			// The elements after elementCount are sentinels that have to stay untouched.
+			std::vector<float> expectedBlocks(paddedCount * 2, -7.0f), actualBlocks(paddedCount * 2, -7.0f);
+			(*jitBlocks)(blocksInput.data(), expectedBlocks.data(), elementCount, uniforms);
+			generatedBlocksKernel(blocksInput.data(), actualBlocks.data(), elementCount, uniforms);
+			correct &= expectedBlocks == actualBlocks;
+			correct &= actualBlocks[elementCount / 8 * 16 + elementCount % 8] == -7.0f;
+
+			const float* const inputColumns[] = { x.data(), y.data() };
+			std::vector<float> expected0(paddedCount, -7.0f), expected1(paddedCount, -7.0f), actual0(paddedCount, -7.0f), actual1(paddedCount, -7.0f);
+			float* const expectedColumns[] = { expected0.data(), expected1.data() };
+			float* const actualColumns[] = { actual0.data(), actual1.data() };
+			(*jitColumns)(std::span(inputColumns), std::span(expectedColumns), elementCount, uniforms);
+			generatedColumnsKernel(inputColumns, actualColumns, elementCount, uniforms);
+			correct &= expected0 == actual0 && expected1 == actual1;
+			correct &= actual0[elementCount] == -7.0f && actual1[elementCount] == -7.0f;
+		}
+		if (correct) {
+			t.printPassed("c++ code generation");
+		} else {
+			t.printFailed("c++ code generation");
+		}
+	}
+
+	{
+		TestRuntime testRuntime;
+		auto& runtime = testRuntime.runtime;
+		const Variable variables[] = { { "t", true }, { "x" }, { "y" } };
+		// The last output is folded and would be rounded to float in F32 code.
+		const std::string_view sources[] = { "exp(x) * t + ln(y)", "sqrt(y) - sin(x) * cos(x) + 0.1 * x", "0.1 + 0.2" };
+		auto blocksFunction = runtime.compileFunction(sources, variables, InputLayout::BLOCKS, Reduction::NONE, Precision::F64);
+		auto columnsFunction = runtime.compileFunction(sources, variables, InputLayout::COLUMNS, Reduction::NONE, Precision::F64);
+
+		const i64 elementCount = 11;
+		const double scale = 1.5;
+		std::vector<double> xs, ys;
+		for (i64 i = 0; i < elementCount; i++) {
+			xs.push_back(-3.0 + 0.7 * double(i));
+			ys.push_back(0.001 + 1.3 * double(i));
+		}
+		const auto isClose = [](double value, double expected) {
+			return std::abs(value - expected) <= 1e-13 * std::max(1.0, std::abs(expected));
+		};
+		const auto isCorrect = [&](i64 i, double a, double b, double c) {
+			return isClose(a, std::exp(xs[i]) * scale + std::log(ys[i]))
+				&& isClose(b, std::sqrt(ys[i]) - std::sin(xs[i]) * std::cos(xs[i]) + 0.1 * xs[i])
+				&& c == 0.1 + 0.2;
+		};
+
+		bool correct = blocksFunction.has_value() && columnsFunction.has_value();
+		const double uniforms[] = { scale };
+		if (blocksFunction.has_value()) {
+			LoopFunctionArrayF64 input(2);
+			for (i64 i = 0; i < elementCount; i++) {
+				const double row[] = { xs[i], ys[i] };
+				input.append(row);
+			}
+			LoopFunctionArrayF64 output(3);
+			output.resize(elementCount);
+			(*blocksFunction)(input, output, uniforms);
+			for (i64 i = 0; i < elementCount; i++) {
+				correct &= isCorrect(i, output(i, 0), output(i, 1), output(i, 2));
+			}
+		}
+		if (columnsFunction.has_value()) {
+			std::vector<double> outputs[3];
+			for (auto& output : outputs) {
+				output.resize(elementCount);
+			}
+			const double* columns[] = { xs.data(), ys.data() };
+			double* const outputPointers[] = { outputs[0].data(), outputs[1].data(), outputs[2].data() };
+			(*columnsFunction)(columns, outputPointers, elementCount, uniforms);
+			for (i64 i = 0; i < elementCount; i++) {
+				correct &= isCorrect(i, outputs[0][i], outputs[1][i], outputs[2][i]);
+			}
+		}
+
+		// The special values of the functions.
+		const Variable xVariable[] = { { "x" } };
+		const std::string_view specialSources[] = { "exp(x)", "ln(x)" };
+		auto specialFunction = runtime.compileFunction(specialSources, xVariable, InputLayout::BLOCKS, Reduction::NONE, Precision::F64);
+		correct &= specialFunction.has_value();
+		if (specialFunction.has_value()) {
+			const auto infinity = std::numeric_limits<double>::infinity();
+			const double inputs[] = { 0.0, -1.0, infinity, 1000.0, -1000.0, 1e-310, 1.0 };
+			LoopFunctionArrayF64 input(1);
+			input.appendRows(inputs);
+			LoopFunctionArrayF64 output(2);
+			output.resize(input.blockCount());
+			(*specialFunction)(input, output);
+			correct &= output(0, 0) == 1.0 && output(0, 1) == -infinity;
+			correct &= std::isnan(output(1, 1));
+			correct &= output(2, 0) == infinity && output(2, 1) == infinity;
+			correct &= output(3, 0) == infinity && output(4, 0) == 0.0;
+			correct &= isClose(output(5, 1), std::log(1e-310));
+			correct &= isClose(output(6, 0), std::exp(1.0)) && output(6, 1) == 0.0;
+		}
+
+		if (correct) {
+			t.printPassed("f64 compilation");
+		} else {
+			t.printFailed("f64 compilation");
+		}
+	}
+
+	{
+		TestRuntime testRuntime;
+		auto& runtime = testRuntime.runtime;
+		// 19 elements so the last 3 are computed from the padded copies.
+		const i64 elementCount = 19;
+		// Only exact for normal values that are representable as halfs.
+		const auto toHalf = [](float value) -> u16 {
+			const auto bits = std::bit_cast<u32>(value);
+			if ((bits & 0x7FFFFFFF) == 0) {
+				return u16(bits >> 16);
+			}
+			return u16(((bits >> 16) & 0x8000) | ((((bits >> 23) & 0xFF) - 127 + 15) << 10) | ((bits >> 13) & 0x3FF));
+		};
+		std::vector<i32> as;
+		std::vector<u16> bs;
+		std::vector<u8> cs;
+		std::vector<double> ds;
+		for (i64 i = 0; i < elementCount; i++) {
+			as.push_back(i32((i - 5) * 10));
+			bs.push_back(toHalf(float(i) * 0.5f));
+			cs.push_back(u8(i * 13));
+			ds.push_back(double(i) * 0.25 + 1e-9);
+		}
+		as[1] = 2000000000;
+		as[2] = -2000000000;
+		bs[18] = toHalf(30000.0f);
+
+		const Variable variables[] = {
+			{ .name = "a", .elementType = ElementType::I32 },
+			{ .name = "s", .isUniform = true },
+			{ .name = "b", .elementType = ElementType::F16 },
+			{ .name = "c", .elementType = ElementType::U8 },
+			{ .name = "d", .elementType = ElementType::F64 },
+		};
+		const std::string_view sources[] = { "a + c", "a * 2", "b * s", "sqrt(d) + b", "c / 2" };
+		// The last output is F32.
+		const ElementType outputTypes[] = { ElementType::U8, ElementType::I32, ElementType::F16, ElementType::F64 };
+		auto function = runtime.compileFunction(sources, variables, InputLayout::COLUMNS, Reduction::NONE, Precision::F32, outputTypes);
+
+		bool correct = function.has_value();
+		if (function.has_value()) {
+			std::vector<u8> sums(elementCount);
+			std::vector<i32> products(elementCount);
+			std::vector<u16> scaled(elementCount);
+			std::vector<double> roots(elementCount);
+			std::vector<float> halves(elementCount);
+			const void* columns[] = { as.data(), bs.data(), cs.data(), ds.data() };
+			void* const outputs[] = { sums.data(), products.data(), scaled.data(), roots.data(), halves.data() };
+			const float uniforms[] = { 3.0f };
+			(*function)(columns, outputs, elementCount, uniforms);
+
+			for (i64 i = 0; i < elementCount; i++) {
+				const auto sum = std::clamp(i64(as[i]) + cs[i], i64(0), i64(255));
+				correct &= sums[i] == sum;
+				const auto b = i == 18 ? 30000.0f : float(i) * 0.5f;
+				correct &= std::abs(roots[i] - double(std::sqrt(float(ds[i])) + b)) <= 1e-6;
+				correct &= halves[i] == float(cs[i]) / 2.0f;
+				if (i != 18) {
+					correct &= scaled[i] == toHalf(b * 3.0f);
+				}
+				if (i != 1 && i != 2) {
+					correct &= products[i] == as[i] * 2;
+				}
+			}
+			// Saturation.
+			correct &= products[1] == std::numeric_limits<i32>::max() && products[2] == std::numeric_limits<i32>::min();
+			correct &= scaled[18] == 0x7C00;
+			correct &= function->bytesPerElement() == 4 + 2 + 1 + 8 + 1 + 4 + 2 + 8 + 4;
+		}
+
+		// The I32 stores saturate and store NaN as 0 both in the vector loop and in the tail.
+		const Variable floatVariables[] = { { "x" } };
+		const ElementType intOutputTypes[] = { ElementType::I32 };
+		auto toInt = runtime.compileFunction("x", floatVariables, InputLayout::COLUMNS, Reduction::NONE, Precision::F32, intOutputTypes);
+		correct &= toInt.has_value();
+		if (toInt.has_value()) {
+			const auto nan = std::numeric_limits<float>::quiet_NaN();
+			const float xs[] = {
+				nan, 3e9f, -3e9f, 2147483648.0f, 2147483520.0f, -2147483648.0f, 1.5f, -2.5f,
+				0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f,
+				nan, 3e9f, -3e9f,
+			};
+			const i32 expected[] = {
+				0, std::numeric_limits<i32>::max(), std::numeric_limits<i32>::min(), std::numeric_limits<i32>::max(), 2147483520, std::numeric_limits<i32>::min(), 2, -2,
+				0, 1, 2, 3, 4, 5, 6, 7,
+				0, std::numeric_limits<i32>::max(), std::numeric_limits<i32>::min(),
+			};
+			i32 ints[std::size(xs)];
+			const void* xColumns[] = { xs };
+			void* const intOutputs[] = { ints };
+			(*toInt)(xColumns, intOutputs, std::size(xs), {});
+			correct &= std::ranges::equal(ints, expected);
+		}
+
+		if (correct) {
+			t.printPassed("typed columns");
+		} else {
+			t.printFailed("typed columns");
+		}
+	}
+
 	t.expectedErrors(
 		"illegal character",
 		"?2 + 2",
@@ -264,7 +1455,8 @@ void TestRunner::expectedHelper(std::string_view name, std::string_view source,
 		printIrCode(std::cout, *irCode);
 	}
 
-	auto optmizedIrCode = valueNumbering.run(*irCode, parameters);
+	std::vector<IrOp> optmizedIrCode;
+	valueNumbering.run(*irCode, parameters, optmizedIrCode);
 	irCode = &optmizedIrCode;
 
 	const auto copy = optmizedIrCode;
@@ -318,7 +1510,7 @@ void TestRunner::expectedHelper(std::string_view name, std::string_view source,
 
 void TestRunner::expected(std::string_view name, std::string_view source, Real expectedOutput, const std::vector<Variable>& parameters, const std::vector<float>& arguments, const std::vector<FunctionInfo>& functions) {
 
-	expectedHelper(name, source, expectedOutput, parameters, arguments);
+	expectedHelper(name, source, expectedOutput, parameters, arguments, functions);
 	reset();
 }
 